@@ -3,308 +3,379 @@
 #include <math.h>
 #include <stddef.h>
 
-#include <esp_log.h>
-
 #include "colors/ColorConverter.h"
-#include "colors/GammaCorrection.h"
 
-CarLight::CarLight(const double stepTime, const int ledCount, const ColorConverter::rgbcct lightColor)
-    : colors(new ColorConverter::rgbcct[ledCount])
-    , colorFilters(new RC[ledCount])
-    , whiteFilters(new RC[ledCount])
+CarLightBase::CarLightBase(const double stepTime, const size_t ledCount, const ColorConverter::rgbcct lightColor,
+                           ColorConverter::rgbcct* pixels, LowPass* colorPixelFilters, LowPass* whitePixelFilters)
+    : parallel(NULL)
+    , filtersSettled(false)
+    , changed(true)
+    , colors(pixels)
+    , colorFilters(colorPixelFilters)
+    , whiteFilters(whitePixelFilters)
     , STEP_SIZE(stepTime)
     , LED_COUNT(ledCount)
     , baseColor(lightColor)
     , on(false)
     , braking(false)
-    , emergencyBraking(false)
-    , blinker(OFF)
-    , policeOn(false)
     , colorBrightness(0.0)
     , whiteBrightness(0.0)
     , useFilter(true)
-    , turnFilterOnAfterChange(false)
-    , turnFilterOffAfterChange(false)
-    , changeColorBrightnessAfter(false)
-    , changeWhiteBrightnessAfter(false)
-    , emergencyBrakeCounter(0.0)
+    , bypassFilters(false)
+    , spanFill(false)
+    , stepsPerFrame(1)
+    , resetFilters(false)
     , position(0)
-    , positionFilter(stepTime, 200, 0.001)
+    , positionFilter(FilterDesigner::lowPass(DEFAULT_FILTER_RESPONSE, POSITION_TIME_CONSTANT, stepTime))
     , blinkerPosition(0)
-    , blinkerOffTime(0)
-    , turnOffBlinkerWhenDone(false)
-    , policeCounter(0)
+    , policeFlashOn(false)
+    , policeLeft(false)
+    , transition(*this)
+    , colorBrightnessAfter(*this, false)
+    , whiteBrightnessAfter(*this, true)
+    , emergencyBrake(*this)
+    , blinker(*this)
+    , police(*this)
+    , filterTolerance(DEFAULT_FILTER_TOLERANCE)
 {
+    const Biquad::Coefficients pixelFilter = FilterDesigner::lowPass(DEFAULT_FILTER_RESPONSE, PIXEL_TIME_CONSTANT, STEP_SIZE);
     for (size_t i = 0; i < ledCount; ++i)
     {
         colors[i] = ColorConverter::rgbcct(ColorConverter::rgb(0, 0, 0), 0, 0);
-        colorFilters[i] = RC(STEP_SIZE, 100, 0.001);
-        whiteFilters[i] = RC(STEP_SIZE, 100, 0.001);
+        colorFilters[i] = LowPass(pixelFilter);
+        whiteFilters[i] = LowPass(pixelFilter);
     }
 
     colorBrightness = normalColorBrightness;
     whiteBrightness = normalWhiteBrightness;
 }
 
-void CarLight::step()
+void CarLightBase::renderRange(void* context, size_t begin, size_t end, size_t part)
 {
-    double desiredPosition = on ? (LED_COUNT / 2.0) + 1 : 0;
-    position = positionFilter.step(desiredPosition);
-    if (changeColorBrightnessAfter && (position - desiredPosition) < 1)
-    {
-        normalColorBrightness = normalColorBrightnessAfter;
-        if (!braking)
-        {
-            colorBrightness = normalColorBrightness;
-        }
-        changeColorBrightnessAfter = false;
-    }
-    if (changeWhiteBrightnessAfter && (position - desiredPosition) < 1)
+    RenderJob* job = static_cast<RenderJob*>(context);
+    job->filtersSettled[part] = job->light->render(*job->frame, begin, end);
+}
+
+void CarLightBase::markChanged()
+{
+    changed.store(true, std::memory_order_release);
+}
+
+CarLightBase::Frame CarLightBase::beginStep()
+{
+    // Cleared before the state is read, a change in between is picked up again by the next step
+    changed.exchange(false, std::memory_order_acquire);
+    effects.step(stepsPerFrame * STEP_SIZE);
+
+    Frame frame;
+    frame.hsv = ColorConverter::rgb2hsv(baseColor);
+    frame.illuminateBelow = floor(position);
+    frame.illuminateAbove = LED_COUNT - ceil(position);
+    frame.colorBrightness = colorBrightness;
+    frame.whiteBrightness = whiteBrightness;
+    frame.useFilter = useFilter && !bypassFilters;
+    frame.resetFilters = frame.useFilter && resetFilters;
+    frame.spanFill = !frame.useFilter && spanFill;
+    if (frame.useFilter)
     {
-        normalWhiteBrightness = normalWhiteBrightnessAfter;
-        if (!braking)
-        {
-            whiteBrightness = normalWhiteBrightness;
-        }
-        changeWhiteBrightnessAfter = false;
+        resetFilters = false;
     }
-    if (blinkerOffTime > BLINKER_PAUSE)
+
+    frame.policeStart = 0;
+    frame.policeEnd = 0;
+    if (police.isActive() && policeFlashOn)
     {
-        blinkerPosition += BLINKER_SPEED * STEP_SIZE;
+        frame.policeStart = round((policeLeft ? 0.5 : 0.3) * LED_COUNT);
+        frame.policeEnd   = round((policeLeft ? 0.7 : 0.5) * LED_COUNT);
     }
-    else
+
+    frame.rightBlinkerStart = 0;
+    frame.rightBlinkerEnd = 0;
+    frame.leftBlinkerStart = 0;
+    frame.leftBlinkerEnd = 0;
+    const Blinker side = blinker.isActive() ? blinker.side : OFF;
+    if (side == RIGHT || side == HAZARD)
     {
-        blinkerOffTime += STEP_SIZE;
+        frame.rightBlinkerStart = round((BLINKER_WIDTH - blinkerPosition) * LED_COUNT);
+        frame.rightBlinkerEnd   = round(BLINKER_WIDTH * LED_COUNT);
     }
-    if (blinkerPosition > BLINKER_WIDTH)
+    if (side == LEFT || side == HAZARD)
     {
-        if (turnOffBlinkerWhenDone)
-        {
-            blinker = OFF;
-            turnOffBlinkerWhenDone = false;
-        }
-        blinkerPosition = 0;
-        blinkerOffTime = 0;
+        frame.leftBlinkerStart = round((1.0 - BLINKER_WIDTH) * LED_COUNT);
+        frame.leftBlinkerEnd   = round(((1.0 - BLINKER_WIDTH) + blinkerPosition) * LED_COUNT);
     }
 
-    ColorConverter::hsvcct hsv = ColorConverter::rgb2hsv(baseColor);
+    return frame;
+}
 
-    static const double emergencyBrakeHalfPeriod = 1.0 / (EMERGENCY_BRAKE_FREQUENCY * 2);
-    if (emergencyBraking)
+void CarLightBase::setRenderQuality(bool bypassFilters, bool spanFill, unsigned stepsPerFrame)
+{
+    if (this->bypassFilters && !bypassFilters)
     {
-        colorBrightness = emergencyBrakeCounter++ * STEP_SIZE > emergencyBrakeHalfPeriod ? normalColorBrightness : BRAKE_BRIGHTNESS;
-        whiteBrightness = 0.0;
+        resetFilters = true;
+    }
+    this->bypassFilters = bypassFilters;
+    this->spanFill = spanFill;
+    this->stepsPerFrame = stepsPerFrame;
+    markChanged();
+}
 
-        if (emergencyBrakeCounter * STEP_SIZE > 2 * emergencyBrakeHalfPeriod)
-        {
-            emergencyBrakeCounter = 0;
-        }
+double CarLightBase::getTimeUntilChange() const
+{
+    if (changed.load(std::memory_order_relaxed) || !filtersSettled)
+    {
+        return 0;
     }
+    return effects.getTimeUntilResume();
+}
 
-    policeCounter++;
+double CarLightBase::getStepTime() const
+{
+    return stepsPerFrame * STEP_SIZE;
+}
 
-    for (size_t i = 0; i < LED_COUNT; ++i)
+void CarLightBase::skip(double time)
+{
+    effects.skip(time);
+}
+
+double CarLightBase::getTargetPosition() const
+{
+    return on ? (LED_COUNT / 2.0) + 1 : 0;
+}
+
+bool CarLightBase::TransitionEffect::resume(double dt)
+{
+    EFFECT_BEGIN();
+    while (true)
     {
-        bool illuminate = i < floor(position) || i > LED_COUNT - ceil(position);
-        double localColorBrightness = illuminate ? colorBrightness : 0.0;
-        double localWhiteBrightness = illuminate ? whiteBrightness : 0.0;
-        double colorValue = useFilter ? colorFilters[i].step(localColorBrightness) : localColorBrightness;
-        double whiteValue = useFilter ? whiteFilters[i].step(localWhiteBrightness) : localWhiteBrightness;
-        hsv.color.v = colorValue;
-        hsv.whiteValue = whiteValue;
-        if (turnFilterOnAfterChange)
+        // The position filter runs at the step time, steps may cover several
+        for (long step = lround(dt / light.STEP_SIZE); step > 0; --step)
         {
-            useFilter = true;
-            turnFilterOnAfterChange = false;
+            light.position = light.positionFilter.step(light.getTargetPosition(), light.POSITION_TOLERANCE);
         }
-        if (abs(whiteValue - localWhiteBrightness) < std::numeric_limits<double>::epsilon() && abs(colorValue - localColorBrightness) < std::numeric_limits<double>::epsilon() && turnFilterOffAfterChange)
+        if (light.positionFilter.isSettled())
         {
-            useFilter = false;
-            turnFilterOffAfterChange = false;
+            break;
         }
+        EFFECT_YIELD();
+    }
+    EFFECT_END();
+}
 
-        ColorConverter::rgbcct rgb = ColorConverter::hsv2rgb(hsv);
+bool CarLightBase::BrightnessAfterEffect::resume(double /*dt*/)
+{
+    EFFECT_BEGIN();
+    // Signed on purpose, as before the effects: while turning on the position is below the target, so the new
+    // brightness applies right away. Only turning off waits until the light is (almost) dark.
+    EFFECT_WAIT_UNTIL(light.position - light.getTargetPosition() < 1);
+    if (white)
+    {
+        light.setWhiteBrightness(brightness);
+    }
+    else
+    {
+        light.setColorBrightness(brightness);
+    }
+    EFFECT_END();
+}
 
-        if (policeOn)
-        {
-            int millis = policeCounter * STEP_SIZE * 1000;
-
-            static bool on = false;
-            static bool left = false;
-
-            if (i == 0)
-            {
-                if (millis % 100 < STEP_SIZE)
-                {
-                    on = !on;
-                }
-                if (millis % 400 < STEP_SIZE)
-                {
-                    left = !left;
-                }
-            }
-
-            static const int rightStart = round(0.3 * LED_COUNT);
-            static const int rightEnd = round(0.5 * LED_COUNT);
-            static const int leftStart = round(0.5 * LED_COUNT);
-            static const int leftEnd = round(0.7 * LED_COUNT);
-
-            if ((left && on && (i >= leftStart && i < leftEnd)) || (!left && on && (i >= rightStart && i < rightEnd)))
-            {
-                rgb.color.r = 0.0;
-                rgb.color.g = 0.0;
-                rgb.color.b = 1.0;
-                rgb.cw = 0;
-                rgb.ww = 0;
-            }
-        }
+bool CarLightBase::EmergencyBrakeEffect::resume(double /*dt*/)
+{
+    EFFECT_BEGIN();
+    light.useFilter = false;
+    light.whiteBrightness = 0.0;
+    while (true)
+    {
+        light.colorBrightness = light.BRAKE_BRIGHTNESS;
+        EFFECT_SLEEP(0.5 / light.EMERGENCY_BRAKE_FREQUENCY);
+        light.colorBrightness = light.normalColorBrightness;
+        EFFECT_SLEEP(0.5 / light.EMERGENCY_BRAKE_FREQUENCY);
+    }
+    EFFECT_END();
+}
 
-        int rightStart = round((BLINKER_WIDTH - blinkerPosition) * LED_COUNT);
-        int rightEnd   = round(BLINKER_WIDTH * LED_COUNT);
-        int leftStart  = round((1.0 - BLINKER_WIDTH) * LED_COUNT);
-        int leftEnd    = round(((1.0 - BLINKER_WIDTH) + blinkerPosition) * LED_COUNT);
+void CarLightBase::EmergencyBrakeEffect::stopped()
+{
+    if (!light.braking)
+    {
+        light.colorBrightness = light.normalColorBrightness;
+        light.whiteBrightness = light.normalWhiteBrightness;
+        light.useFilter = true;
+    }
+}
 
-        if (((blinker == RIGHT || blinker == HAZARD) && i >= rightStart && i < rightEnd)
-        ||  ((blinker == LEFT  || blinker == HAZARD) && i >= leftStart  && i < leftEnd))
+bool CarLightBase::BlinkerEffect::resume(double dt)
+{
+    EFFECT_BEGIN();
+    while (true)
+    {
+        for (light.blinkerPosition = 0; light.blinkerPosition <= light.BLINKER_WIDTH; light.blinkerPosition += light.BLINKER_SPEED * dt)
         {
-            rgb.color.r = 1.0;
-            rgb.color.g = 1.0;
-            rgb.color.b = 0.0;
-            rgb.cw = 0;
-            rgb.ww = 0;
+            EFFECT_YIELD();
         }
+        light.blinkerPosition = 0;
+        if (finish)
+        {
+            break;
+        }
+        EFFECT_SLEEP(light.BLINKER_PAUSE);
+    }
+    EFFECT_END();
+}
 
-        static const double max = 0xFF;
-        uint8_t red = gamma8[static_cast<uint8_t>(rgb.color.r * max)];
-        uint8_t green = gamma8[static_cast<uint8_t>(rgb.color.g * max)];
-        uint8_t blue = gamma8[static_cast<uint8_t>(rgb.color.b * max)];
-        uint8_t warm = gamma8[static_cast<uint8_t>(rgb.ww * max)];
-        uint8_t cold = gamma8[static_cast<uint8_t>(rgb.cw * max)];
-
-        colors[i].color.r = red / max;
-        colors[i].color.g = green / max;
-        colors[i].color.b = blue / max;
-        colors[i].ww = warm / max;
-        colors[i].cw = cold / max;
+bool CarLightBase::PoliceEffect::resume(double /*dt*/)
+{
+    EFFECT_BEGIN();
+    while (true)
+    {
+        for (flashes = 0; flashes < POLICE_FLASHES_PER_SIDE; ++flashes)
+        {
+            light.policeFlashOn = !light.policeFlashOn;
+            EFFECT_SLEEP(light.POLICE_FLASH_TIME);
+        }
+        light.policeLeft = !light.policeLeft;
     }
+    EFFECT_END();
+}
+
+void CarLightBase::PoliceEffect::stopped()
+{
+    light.policeFlashOn = false;
 }
 
-ColorConverter::rgbcct* CarLight::getPixels() const
+ColorConverter::rgbcct* CarLightBase::getPixels() const
 {
     return colors;
 }
 
-size_t CarLight::getPixelCount() const
+void CarLightBase::setParallel(ParallelFor* newParallel)
+{
+    parallel = newParallel;
+}
+
+size_t CarLightBase::getPixelCount() const
 {
     return LED_COUNT;
 }
 
-void CarLight::turnOn()
+void CarLightBase::turnOn()
 {
     on = true;
+    effects.start(transition);
 }
 
-void CarLight::turnOff()
+void CarLightBase::turnOff()
 {
     on = false;
+    effects.start(transition);
 }
 
-bool CarLight::isOn() const
+bool CarLightBase::isOn() const
 {
     return on;
 }
 
-void CarLight::turnOnBrake()
+void CarLightBase::turnOnBrake()
 {
     braking = true;
     colorBrightness = BRAKE_BRIGHTNESS;
     whiteBrightness = 0;
     useFilter = false;
+    markChanged();
 }
 
-void CarLight::turnOffBrake()
+void CarLightBase::turnOffBrake()
 {
     braking = false;
     colorBrightness = normalColorBrightness;
     whiteBrightness = normalWhiteBrightness;
-    if (!emergencyBraking)
+    if (!isEmergencyBraking())
     {
-        turnFilterOnAfterChange = true;
+        useFilter = true;
     }
+    markChanged();
 }
 
-void CarLight::turnOnEmergencyBrake()
+bool CarLightBase::isBraking() const
 {
-    emergencyBraking = true;
-    useFilter = false;
-    emergencyBrakeCounter = 0;
+    return braking;
 }
 
-void CarLight::turnOffEmergencyBrake()
+void CarLightBase::turnOnEmergencyBrake()
 {
-    emergencyBraking = false;
-    if (!braking)
-    {
-        turnFilterOnAfterChange = true;
-    }
+    effects.start(emergencyBrake);
 }
 
-void CarLight::turnOnLeft()
+void CarLightBase::turnOffEmergencyBrake()
 {
-    if (blinker == OFF)
-    {
-        blinkerPosition = 0;
-    }
-    blinker = LEFT;
-    turnOffBlinkerWhenDone = false;
+    effects.stop(emergencyBrake);
 }
 
-void CarLight::turnOnRight()
+bool CarLightBase::isEmergencyBraking() const
 {
-    if (blinker == OFF)
-    {
-        blinkerPosition = 0;
-    }
-    blinker = RIGHT;
-    turnOffBlinkerWhenDone = false;
+    return emergencyBrake.isActive();
 }
 
-void CarLight::turnOnHazard()
+void CarLightBase::turnOnLeft()
 {
-    if (blinker == OFF)
-    {
-        blinkerPosition = 0;
-    }
-    blinker = HAZARD;
-    turnOffBlinkerWhenDone = false;
+    blinker.side = LEFT;
+    blinker.finish = false;
+    effects.start(blinker);
+}
+
+void CarLightBase::turnOnRight()
+{
+    blinker.side = RIGHT;
+    blinker.finish = false;
+    effects.start(blinker);
 }
 
-void CarLight::turnOffBlinker()
+void CarLightBase::turnOnHazard()
 {
-    turnOffBlinkerWhenDone = true;
+    blinker.side = HAZARD;
+    blinker.finish = false;
+    effects.start(blinker);
 }
 
-void CarLight::turnOnPolice()
+void CarLightBase::turnOffBlinker()
 {
-    policeOn = true;
+    blinker.finish = true;
+    markChanged();
 }
 
-void CarLight::turnOffPolice()
+bool CarLightBase::isBlinking() const
 {
-    policeOn = false;
+    return blinker.isActive();
 }
 
-void CarLight::setColor(float red, float green, float blue)
+void CarLightBase::turnOnPolice()
+{
+    effects.start(police);
+}
+
+void CarLightBase::turnOffPolice()
+{
+    effects.stop(police);
+}
+
+bool CarLightBase::isPoliceOn() const
+{
+    return police.isActive();
+}
+
+void CarLightBase::setColor(float red, float green, float blue)
 {
     baseColor.color = ColorConverter::rgb(red, green, blue);
+    markChanged();
 }
 
-ColorConverter::rgb CarLight::getColor() const
+ColorConverter::rgb CarLightBase::getColor() const
 {
     return baseColor.color;
 }
 
-void CarLight::setWhiteTemperature(float temperature)
+void CarLightBase::setWhiteTemperature(float temperature)
 {
     ColorConverter::hsvcct helperTemperature;
     helperTemperature.whiteTemp = temperature;
@@ -312,68 +383,80 @@ void CarLight::setWhiteTemperature(float temperature)
     ColorConverter::rgbcct helperValues = ColorConverter::hsv2rgb(helperTemperature);
     baseColor.cw = helperValues.cw;
     baseColor.ww = helperValues.ww;
+    markChanged();
 }
 
-float CarLight::getWhiteTemperature() const
+float CarLightBase::getWhiteTemperature() const
 {
     ColorConverter::hsvcct helper = ColorConverter::rgb2hsv(baseColor);
     return helper.whiteTemp;
 }
 
-void CarLight::setColorBrightness(float brightness)
+void CarLightBase::setColorBrightness(float brightness)
 {
     normalColorBrightness = brightness;
     if (!braking)
     {
         colorBrightness = brightness;
     }
+    markChanged();
 }
 
-float CarLight::getColorBrightness() const
+float CarLightBase::getColorBrightness() const
 {
     return normalColorBrightness;
 }
 
-void CarLight::setColorBrightnessAfter(float brightness)
+void CarLightBase::setColorBrightnessAfter(float brightness)
 {
-    normalColorBrightnessAfter = brightness;
-    changeColorBrightnessAfter = true;
+    colorBrightnessAfter.brightness = brightness;
+    effects.start(colorBrightnessAfter);
 }
 
-void CarLight::setWhiteBrightness(float brightness)
+void CarLightBase::setWhiteBrightness(float brightness)
 {
     normalWhiteBrightness = brightness;
     if (!braking)
     {
         whiteBrightness = brightness;
     }
+    markChanged();
 }
 
-void CarLight::setWhiteBrightnessAfter(float brightness)
+void CarLightBase::setWhiteBrightnessAfter(float brightness)
 {
-    normalWhiteBrightnessAfter = brightness;
-    changeWhiteBrightnessAfter = true;
+    whiteBrightnessAfter.brightness = brightness;
+    effects.start(whiteBrightnessAfter);
 }
 
-float CarLight::getWhiteBrightness() const
+float CarLightBase::getWhiteBrightness() const
 {
     return normalWhiteBrightness;
 }
 
-void CarLight::setFilterValues(float capacitance, float resistance)
+void CarLightBase::setFilterValues(float capacitance, float resistance, FilterDesigner::Response response)
 {
+    const Biquad::Coefficients coefficients = FilterDesigner::lowPass(response, resistance * capacitance, STEP_SIZE);
     for (size_t i = 0; i < LED_COUNT; ++i)
     {
-        colorFilters[i].setFilterCoefficients(capacitance, resistance);
-        whiteFilters[i].setFilterCoefficients(capacitance, resistance);
+        colorFilters[i].setCoefficients(coefficients);
+        whiteFilters[i].setCoefficients(coefficients);
     }
+    markChanged();
+}
+
+void CarLightBase::setFilterTolerance(float tolerance)
+{
+    filterTolerance = tolerance;
+    markChanged();
 }
 
-void CarLight::setInitialFilterValues(float input, float output)
+void CarLightBase::setInitialFilterValues(float input, float output)
 {
     for (size_t i = 0; i < LED_COUNT; ++i)
     {
         colorFilters[i].setInitialValues(input, output);
         whiteFilters[i].setInitialValues(input, output);
     }
+    markChanged();
 }
@@ -2,16 +2,28 @@
 #define CAR_LIGHT_H
 
 #include <stddef.h>
+#include <math.h>
 
-#include "filters/RC.h"
-#include "colors/ColorConverter.h"
+#include <array>
+#include <atomic>
 
-class CarLight
+#include "colors/ColorConverter.h"
+#include "effects/Effect.h"
+#include "filters/FilterDesigner.h"
+#include "filters/LowPass.h"
+#include "parallel/ParallelFor.h"
+
+/// Everything of the car light that does not depend on the LED count.
+/// Pixel storage lives in CarLight<N> or, for the segments of a SegmentedLight, in a slice of a shared buffer.
+/// The per pixel loop (renderStep<COUNT>()) is instantiated for the pixel count, so the loop bounds are known at compile time.
+/// Use this type to refer to a car light of any size.
+class CarLightBase
 {
 public:
-    CarLight(const double stepTime, const int ledCount, const ColorConverter::rgbcct lightColor);
+    virtual ~CarLightBase() {}
 
-    void step();
+    /// Advance all animations by one step and render all pixels
+    virtual void step() = 0;
 
     void turnOn();
     void turnOff();
@@ -19,17 +31,23 @@ public:
 
     void turnOnBrake();
     void turnOffBrake();
+    bool isBraking() const;
 
     void turnOnEmergencyBrake();
     void turnOffEmergencyBrake();
+    /// Effects (emergency brake, blinker, police) start and stop with the next step(), so does their is...() state
+    bool isEmergencyBraking() const;
 
     void turnOnLeft();
     void turnOnRight();
     void turnOnHazard();
     void turnOffBlinker();
+    /// True while any blinker (or hazard) is blinking, including the last blink after turnOffBlinker()
+    bool isBlinking() const;
 
     void turnOnPolice();
     void turnOffPolice();
+    bool isPoliceOn() const;
 
     void setColor(float red, float green, float blue);
     ColorConverter::rgb getColor() const;
@@ -46,9 +64,41 @@ public:
     void setWhiteBrightnessAfter(float brightness);
     float getWhiteBrightness() const;
 
-    void setFilterValues(float capacitance, float resistance);
+    /// Default response of the pixel filters and of the on/off animation
+    static const FilterDesigner::Response DEFAULT_FILTER_RESPONSE = FilterDesigner::CRITICALLY_DAMPED;
+
+    /// Response of the pixel filters with the time constant resistance * capacitance [seconds]
+    void setFilterValues(float capacitance, float resistance, FilterDesigner::Response response = DEFAULT_FILTER_RESPONSE);
     void setInitialFilterValues(float input, float output);
 
+    /// Filters closer than this to their target snap to it and stop being computed until the target changes.
+    void setFilterTolerance(float tolerance);
+
+    /// Cheaper rendering while the frame budget is at risk (see FrameGovernor). Only call from the render task.
+    /// @param bypassFilters Pixels jump to their targets instead of being filtered
+    /// @param spanFill Pixels that get the same color as their left neighbour are copied instead of computed.
+    ///                 Only while the filters are not used, filtered pixels hardly ever match.
+    /// @param stepsPerFrame Animation steps one step() advances, for calling step() less often than every step time
+    void setRenderQuality(bool bypassFilters, bool spanFill, unsigned stepsPerFrame);
+
+    /// Time until the light changes [seconds], counted from the last step().
+    /// 0 while an animation or a filter is running or after a setter changed the light since the last step(),
+    /// the next effect deadline while all effects sleep and INFINITY if nothing is going on.
+    double getTimeUntilChange() const;
+
+    /// Time one step() advances the animations [seconds]
+    double getStepTime() const;
+
+    /// Lets time pass without rendering, instead of calling step() while nothing changes
+    /// @param time At most getTimeUntilChange() minus one step [seconds]
+    void skip(double time);
+
+    /// Split the pixel loop between both cores. NULL renders all pixels on the calling task.
+    /// Only used for lights with at least MIN_PARALLEL_PIXELS pixels, smaller ones are faster without the fork/join.
+    void setParallel(ParallelFor* parallel);
+
+    static const size_t MIN_PARALLEL_PIXELS = 256;
+
     /// Get current colors of all LEDs (Pixels)
     /// @return Array with size of pixel count (use getPixelCount())
     ColorConverter::rgbcct* getPixels() const;
@@ -56,37 +106,113 @@ public:
     /// Get Pixel (LED) count
     size_t getPixelCount() const;
 
+protected:
+    /// Storage is owned by the derived class, we only keep pointers for the functions that are not performance critical
+    CarLightBase(const double stepTime, const size_t ledCount, const ColorConverter::rgbcct lightColor,
+                 ColorConverter::rgbcct* pixels, LowPass* colorPixelFilters, LowPass* whitePixelFilters);
+
+    /// State that is the same for all pixels of one step. Computed once per step before rendering the pixels.
+    struct Frame
+    {
+        /// Base color with the value to be replaced by each pixel
+        ColorConverter::hsvcct hsv;
+
+        /// Pixels below/above these indices are lit by the on/off animation
+        double illuminateBelow;
+        double illuminateAbove;
+
+        double colorBrightness;
+        double whiteBrightness;
+        bool useFilter;
+
+        /// Filters start at their targets instead of where they stopped when they were bypassed
+        bool resetFilters;
+
+        /// See setRenderQuality(), never together with useFilter
+        bool spanFill;
+
+        /// Police light range that is lit in this step. Empty if none.
+        size_t policeStart;
+        size_t policeEnd;
+
+        /// Blinker ranges that are lit in this step. Empty if none.
+        size_t rightBlinkerStart;
+        size_t rightBlinkerEnd;
+        size_t leftBlinkerStart;
+        size_t leftBlinkerEnd;
+    };
+
+    /// Resumes the active effects and computes the state all pixels share in this step
+    Frame beginStep();
+
+    /// Without filters a pixel only depends on which ranges of the frame it is in.
+    /// @return Key of those ranges, pixels with the same key get the same color
+    inline uint8_t getSpan(const Frame& frame, size_t i) const;
+
+    /// Renders a single pixel
+    /// @return true if both filters of the pixel are settled or not in use
+    inline bool renderPixel(const Frame& frame, size_t i, ColorConverter::rgbcct& color, LowPass& colorFilter, LowPass& whiteFilter) const;
+
+    /// step() of a light with COUNT pixels
+    template <size_t COUNT>
+    void renderStep();
+
 private:
+    /// Renders the pixels [begin, end)
+    /// @return true if the filters of all of them are settled
+    inline bool render(const Frame& frame, size_t begin, size_t end);
+
+    struct RenderJob
+    {
+        CarLightBase* light;
+        const Frame* frame;
+        bool filtersSettled[ParallelFor::PARTS];
+    };
+
+    /// ParallelFor::Job rendering one part of the pixels
+    static void renderRange(void* context, size_t begin, size_t end, size_t part);
+
+    /// Called by the setters after they changed the light, see getTimeUntilChange()
+    void markChanged();
+
+    /// See setParallel()
+    ParallelFor* parallel;
+
+    /// True if the filters of all pixels were settled (or not in use) in the last step
+    bool filtersSettled;
+
+    /// Set by the setters (any task), cleared by the step that picks the change up
+    std::atomic<bool> changed;
+
     /// Holds colors for each pixel (=LED)
     ColorConverter::rgbcct* colors;
 
     /// Filters for each color pixel
-    RC* colorFilters;
+    LowPass* colorFilters;
 
     /// Filters for each cct pixel
-    RC* whiteFilters;
+    LowPass* whiteFilters;
 
     /// How much time passes inbetween step() calls [seconds]
     const double STEP_SIZE;
 
     /// Total number of LEDs (=pixels)
-    const int LED_COUNT;
+    const size_t LED_COUNT;
 
     /// The base color we display if we are on and nothing is happening
     ColorConverter::rgbcct baseColor;
 
-    /// The general state that can be modified using the public turnOn/Off() functions
+    /// The general state that can be modified using the public turnOn/Off() functions.
+    /// Emergency brake, blinker and police light are effects, they are on while their effect is active.
     bool on;
     bool braking;
-    bool emergencyBraking;
     enum Blinker
     {
         OFF,
         LEFT,
         RIGHT,
         HAZARD
-    } blinker;
-    bool policeOn;
+    };
 
     /// Brightness of all RGB LEDs
     double colorBrightness;
@@ -97,21 +223,23 @@ private:
     /// Use individual LED filters?
     bool useFilter;
 
-    /// Turn individual LED filters on/off after animation complete?
-    bool turnFilterOnAfterChange;
-    bool turnFilterOffAfterChange;
-    bool changeColorBrightnessAfter;
-    bool changeWhiteBrightnessAfter;
+    /// See setRenderQuality()
+    bool bypassFilters;
+    bool spanFill;
+    unsigned stepsPerFrame;
+
+    /// Set when the filters stop being bypassed, see Frame
+    bool resetFilters;
 
     /// Frequency of emergency brake pulses [Hz]
     const double EMERGENCY_BRAKE_FREQUENCY = 5;
 
-    /// Counts the steps spent in emergency brake mode
-    int emergencyBrakeCounter;
-
     /// Position and filter for the on/off animation
     double position;
-    RC positionFilter;
+    LowPass positionFilter;
+
+    /// The on/off animation stops once the position is this close to its target [LEDs]
+    const double POSITION_TOLERANCE = 0.01;
 
     /// Speed of blinker animation [% of total strip per second]
     const double BLINKER_SPEED = 0.3;
@@ -125,22 +253,234 @@ private:
     /// [% of total strip]
     double blinkerPosition; // [% of total strip]
 
-    /// Time blinker was already off in between blinks [seconds]
-    double blinkerOffTime;
+    /// Police lights flash every POLICE_FLASH_TIME and change sides every POLICE_FLASHES_PER_SIDE flashes
+    const double POLICE_FLASH_TIME = 0.1; // [seconds]
+    static const int POLICE_FLASHES_PER_SIDE = 4;
+    bool policeFlashOn;
+    bool policeLeft;
+
+    /// Target of the on/off animation [LEDs]
+    double getTargetPosition() const;
+
+    /// Moves the lit range of the on/off animation towards the target until the position filter settles
+    class TransitionEffect : public Effect
+    {
+    public:
+        explicit TransitionEffect(CarLightBase& light) : light(light) {}
+
+    protected:
+        bool resume(double dt) override;
+
+    private:
+        CarLightBase& light;
+    };
+
+    /// Sets the normal color or white brightness once the position is less than one LED above its target,
+    /// i.e. once a turn off animation is (almost) complete and right away otherwise
+    class BrightnessAfterEffect : public Effect
+    {
+    public:
+        BrightnessAfterEffect(CarLightBase& light, bool white) : brightness(0), light(light), white(white) {}
+
+        double brightness;
 
-    /// When the blinker is turned off by the user, we finish the current blink before turning it off.
-    /// With this we remember that we want to turn the blinker off when we are finished.
-    bool turnOffBlinkerWhenDone;
+    protected:
+        bool resume(double dt) override;
 
-    /// Counts the steps spent in police mode [-]
-    unsigned int policeCounter;
+    private:
+        CarLightBase& light;
+        const bool white;
+    };
+
+    /// Alternates between brake and normal brightness
+    class EmergencyBrakeEffect : public Effect
+    {
+    public:
+        explicit EmergencyBrakeEffect(CarLightBase& light) : light(light) {}
+
+    protected:
+        bool resume(double dt) override;
+        void stopped() override;
+
+    private:
+        CarLightBase& light;
+    };
+
+    /// Sweeps the blinker over its range and pauses, until a blink ends after finish was requested
+    class BlinkerEffect : public Effect
+    {
+    public:
+        explicit BlinkerEffect(CarLightBase& light) : side(OFF), finish(false), light(light) {}
+
+        /// Side to blink, may change while blinking
+        Blinker side;
+
+        /// Set by turnOffBlinker(), the current blink is finished before the effect ends
+        bool finish;
+
+    protected:
+        bool resume(double dt) override;
+
+    private:
+        CarLightBase& light;
+    };
+
+    /// Flashes one side of the police light after the other
+    class PoliceEffect : public Effect
+    {
+    public:
+        explicit PoliceEffect(CarLightBase& light) : flashes(0), light(light) {}
+
+    protected:
+        bool resume(double dt) override;
+        void stopped() override;
+
+    private:
+        int flashes;
+        CarLightBase& light;
+    };
+
+    EffectRunner effects;
+    TransitionEffect transition;
+    BrightnessAfterEffect colorBrightnessAfter;
+    BrightnessAfterEffect whiteBrightnessAfter;
+    EmergencyBrakeEffect emergencyBrake;
+    BlinkerEffect blinker;
+    PoliceEffect police;
 
     double normalColorBrightness = 0.5;
     double normalWhiteBrightness = 0.3;
     const double BRAKE_BRIGHTNESS = 1.0;
 
-    double normalColorBrightnessAfter = 0.0;
-    double normalWhiteBrightnessAfter = 0.0;
+    static constexpr float PIXEL_TIME_CONSTANT = 0.1;    // [seconds]
+    static constexpr float POSITION_TIME_CONSTANT = 0.2; // [seconds]
+
+    /// Below half a step of the 10 bit output tables (LightTable), so snapping is invisible
+    const double DEFAULT_FILTER_TOLERANCE = 0.0004;
+
+    /// See setFilterTolerance()
+    double filterTolerance;
+};
+
+bool CarLightBase::renderPixel(const Frame& frame, size_t i, ColorConverter::rgbcct& color, LowPass& colorFilter, LowPass& whiteFilter) const
+{
+    bool illuminate = i < frame.illuminateBelow || i > frame.illuminateAbove;
+    double localColorBrightness = illuminate ? frame.colorBrightness : 0.0;
+    double localWhiteBrightness = illuminate ? frame.whiteBrightness : 0.0;
+    if (frame.resetFilters)
+    {
+        colorFilter.setInitialValues(localColorBrightness, localColorBrightness);
+        whiteFilter.setInitialValues(localWhiteBrightness, localWhiteBrightness);
+    }
+    double colorValue = frame.useFilter ? colorFilter.step(localColorBrightness, filterTolerance) : localColorBrightness;
+    double whiteValue = frame.useFilter ? whiteFilter.step(localWhiteBrightness, filterTolerance) : localWhiteBrightness;
+
+    ColorConverter::hsvcct hsv = frame.hsv;
+    hsv.color.v = colorValue;
+    hsv.whiteValue = whiteValue;
+
+    // Gamma correction and quantization happen in the output stage (LightTable)
+    color = ColorConverter::hsv2rgb(hsv);
+
+    if (i >= frame.policeStart && i < frame.policeEnd)
+    {
+        color = ColorConverter::rgbcct(ColorConverter::rgb(0.0, 0.0, 1.0), 0, 0);
+    }
+
+    if ((i >= frame.rightBlinkerStart && i < frame.rightBlinkerEnd)
+    ||  (i >= frame.leftBlinkerStart  && i < frame.leftBlinkerEnd))
+    {
+        color = ColorConverter::rgbcct(ColorConverter::rgb(1.0, 1.0, 0.0), 0, 0);
+    }
+
+    return !frame.useFilter || (colorFilter.isSettled() && whiteFilter.isSettled());
+}
+
+uint8_t CarLightBase::getSpan(const Frame& frame, size_t i) const
+{
+    const bool illuminate = i < frame.illuminateBelow || i > frame.illuminateAbove;
+    const bool police = i >= frame.policeStart && i < frame.policeEnd;
+    const bool blinker = (i >= frame.rightBlinkerStart && i < frame.rightBlinkerEnd)
+                      || (i >= frame.leftBlinkerStart  && i < frame.leftBlinkerEnd);
+    return illuminate | police << 1 | blinker << 2;
+}
+
+template <size_t COUNT>
+void CarLightBase::renderStep()
+{
+    const Frame frame = beginStep();
+
+    if (COUNT >= MIN_PARALLEL_PIXELS && parallel)
+    {
+        RenderJob job = {this, &frame, {}};
+        parallel->run(COUNT, &CarLightBase::renderRange, &job);
+        filtersSettled = true;
+        for (size_t part = 0; part < ParallelFor::PARTS; ++part)
+        {
+            filtersSettled &= job.filtersSettled[part];
+        }
+    }
+    else
+    {
+        filtersSettled = render(frame, 0, COUNT);
+    }
+}
+
+bool CarLightBase::render(const Frame& frame, size_t begin, size_t end)
+{
+    if (frame.spanFill)
+    {
+        uint8_t previousSpan = 0xFF;
+        for (size_t i = begin; i < end; ++i)
+        {
+            const uint8_t span = getSpan(frame, i);
+            if (span == previousSpan)
+            {
+                colors[i] = colors[i - 1];
+            }
+            else
+            {
+                renderPixel(frame, i, colors[i], colorFilters[i], whiteFilters[i]);
+                previousSpan = span;
+            }
+        }
+        return true;
+    }
+
+    bool settled = true;
+    for (size_t i = begin; i < end; ++i)
+    {
+        settled &= renderPixel(frame, i, colors[i], colorFilters[i], whiteFilters[i]);
+    }
+    return settled;
+}
+
+/// Pixel storage of CarLight<N>.
+/// A separate base class so it is constructed before CarLightBase, which gets pointers into it.
+template <size_t N>
+struct CarLightStorage
+{
+    std::array<ColorConverter::rgbcct, N> pixelColors;
+    std::array<LowPass, N> pixelColorFilters;
+    std::array<LowPass, N> pixelWhiteFilters;
+};
+
+/// Car light with a fixed number of LEDs.
+/// All pixel state is stored inside the object, so placing the object (e.g. static, in PSRAM) places all of it.
+/// Nothing is allocated on the heap.
+template <size_t N>
+class CarLight : private CarLightStorage<N>, public CarLightBase
+{
+public:
+    CarLight(const double stepTime, const ColorConverter::rgbcct lightColor)
+        : CarLightStorage<N>()
+        , CarLightBase(stepTime, N, lightColor, this->pixelColors.data(), this->pixelColorFilters.data(), this->pixelWhiteFilters.data())
+    {}
+
+    void step() override
+    {
+        renderStep<N>();
+    }
 };
 
-#endif
\ No newline at end of file
+#endif
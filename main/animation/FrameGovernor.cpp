@@ -0,0 +1,54 @@
+#include "FrameGovernor.h"
+
+FrameGovernor::FrameGovernor()
+    : quality(FULL)
+    , load(0)
+    , changes(0)
+    , pressuredFrames(0)
+    , relaxedFrames(0)
+{}
+
+bool FrameGovernor::update(double workTime, double budget)
+{
+    load = budget > 0 ? workTime / budget : 0;
+
+    pressuredFrames = load > DEGRADE_LOAD ? pressuredFrames + 1 : 0;
+    relaxedFrames = load < RESTORE_LOAD ? relaxedFrames + 1 : 0;
+
+    if (quality + 1 < QUALITY_COUNT && (load > 1 || pressuredFrames >= DEGRADE_FRAMES))
+    {
+        change(static_cast<Quality>(quality + 1));
+        return true;
+    }
+    if (quality > FULL && relaxedFrames >= RESTORE_FRAMES)
+    {
+        change(static_cast<Quality>(quality - 1));
+        return true;
+    }
+    return false;
+}
+
+void FrameGovernor::change(Quality newQuality)
+{
+    quality = newQuality;
+    ++changes;
+
+    // The load of the new level has to be measured from scratch
+    pressuredFrames = 0;
+    relaxedFrames = 0;
+}
+
+FrameGovernor::Quality FrameGovernor::getQuality() const
+{
+    return quality;
+}
+
+double FrameGovernor::getLoad() const
+{
+    return load;
+}
+
+uint32_t FrameGovernor::getChanges() const
+{
+    return changes;
+}
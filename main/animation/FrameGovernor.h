@@ -0,0 +1,65 @@
+#ifndef FRAME_GOVERNOR_H
+#define FRAME_GOVERNOR_H
+
+#include <inttypes.h>
+#include <stddef.h>
+
+/// Keeps rendered frames inside their period by trading quality for time.
+/// Every rendered frame reports the CPU time of its render and output work. Waiting for the LEDs does not count,
+/// no quality level makes it shorter. When the load (work / budget) stays high, quality drops by one level.
+/// It is restored one level at a time after a long run of frames with headroom.
+/// Levels are cumulative, every level also keeps the savings of the ones before.
+/// Nothing here reads a clock, the caller passes the measured times, so the same code runs in host tools.
+class FrameGovernor
+{
+public:
+    enum Quality : uint8_t
+    {
+        FULL,           // Everything
+        NO_FILTERS,     // Pixels jump to their targets, no per pixel filter steps
+        SPANS,          // Runs of equal pixels are computed once and copied
+        HALF_RATE,      // Render every second frame, the output holds or interpolates in between
+        QUALITY_COUNT
+    };
+
+    /// Load of a frame that puts the deadline at risk
+    static constexpr double DEGRADE_LOAD = 0.9;
+
+    /// Frames in a row above DEGRADE_LOAD before the quality drops. A frame over budget drops it right away.
+    static const unsigned DEGRADE_FRAMES = 3;
+
+    /// Load below which a frame has headroom for the next better level
+    static constexpr double RESTORE_LOAD = 0.5;
+
+    /// Frames in a row below RESTORE_LOAD before the quality is raised again
+    static const unsigned RESTORE_FRAMES = 100;
+
+    FrameGovernor();
+
+    /// Called once per rendered frame
+    /// @param workTime CPU time of rendering and preparing the output of the frame [seconds]
+    /// @param budget Time the frame had [seconds], its period
+    /// @return true if the quality changed
+    bool update(double workTime, double budget);
+
+    Quality getQuality() const;
+
+    /// Load of the last frame, work / budget
+    double getLoad() const;
+
+    /// Quality changes since boot
+    uint32_t getChanges() const;
+
+private:
+    void change(Quality newQuality);
+
+    Quality quality;
+    double load;
+    uint32_t changes;
+
+    /// Frames in a row above DEGRADE_LOAD / below RESTORE_LOAD
+    unsigned pressuredFrames;
+    unsigned relaxedFrames;
+};
+
+#endif // FRAME_GOVERNOR_H
@@ -0,0 +1,88 @@
+#ifndef INDEXED_FRAME_H
+#define INDEXED_FRAME_H
+
+#include <inttypes.h>
+#include <stddef.h>
+#include <string.h>
+
+#include <array>
+
+/// Framebuffer that stores one palette index (see colors/Palette.h) per LED instead of a color.
+/// One byte per LED instead of the 40 byte color plus two filters of CarLight, so strips with
+/// thousands of LEDs fit into internal RAM. Use this type to refer to a frame of any size.
+class IndexedFrameBase
+{
+public:
+    /// Sets the palette index of one LED. Indices outside of the frame are ignored.
+    void set(size_t index, uint8_t paletteIndex)
+    {
+        if (index < count)
+        {
+            indices[index] = paletteIndex;
+        }
+    }
+
+    /// Sets the palette index of a range of LEDs. The range is clipped to the frame.
+    void fill(size_t start, size_t length, uint8_t paletteIndex)
+    {
+        if (start < count)
+        {
+            memset(&indices[start], paletteIndex, length < count - start ? length : count - start);
+        }
+    }
+
+    /// Copies palette indices to a range of LEDs. The range is clipped to the frame.
+    void write(size_t start, const uint8_t* source, size_t length)
+    {
+        if (start < count)
+        {
+            memcpy(&indices[start], source, length < count - start ? length : count - start);
+        }
+    }
+
+    uint8_t get(size_t index) const
+    {
+        return indices[index];
+    }
+
+    /// Palette indices of all LEDs (size getPixelCount())
+    const uint8_t* getIndices() const
+    {
+        return indices;
+    }
+
+    size_t getPixelCount() const
+    {
+        return count;
+    }
+
+protected:
+    /// Storage is owned by the derived class
+    IndexedFrameBase(uint8_t* indices, size_t count)
+        : indices(indices)
+        , count(count)
+    {}
+
+private:
+    uint8_t* indices;
+    const size_t count;
+};
+
+template <size_t N>
+struct IndexedFrameStorage
+{
+    std::array<uint8_t, N> paletteIndices;
+};
+
+/// Indexed framebuffer of N LEDs. All LEDs start at palette index 0.
+template <size_t N>
+class IndexedFrame : private IndexedFrameStorage<N>, public IndexedFrameBase
+{
+public:
+    IndexedFrame()
+        : IndexedFrameStorage<N>()
+        , IndexedFrameBase(this->paletteIndices.data(), N)
+    {}
+};
+
+#endif // INDEXED_FRAME_H
@@ -0,0 +1,108 @@
+#include "SegmentedLight.h"
+
+#include <math.h>
+
+SegmentedLightBase::SegmentedLightBase(ColorConverter::rgbcct* pixels, size_t pixelCount,
+                                       const LightSegment* table, CarLightBase* const* segments, size_t segmentCount)
+    : pixels(pixels)
+    , PIXEL_COUNT(pixelCount)
+    , table(table)
+    , segments(segments)
+    , SEGMENT_COUNT(segmentCount)
+    , renderedSegments(0)
+{
+    // The segments clear their own pixels, this is for the gaps between them
+    for (size_t i = 0; i < pixelCount; ++i)
+    {
+        pixels[i] = ColorConverter::rgbcct(ColorConverter::rgb(0, 0, 0), 0, 0);
+    }
+}
+
+void SegmentedLightBase::step(bool skipUnchanged)
+{
+    renderedSegments = 0;
+    for (size_t i = 0; i < SEGMENT_COUNT; ++i)
+    {
+        CarLightBase& segment = *segments[i];
+
+        // Same rounding as EffectRunner::step(): nothing is due if it is more than half a step after this one
+        const double stepTime = segment.getStepTime();
+        if (skipUnchanged && segment.getTimeUntilChange() > 1.5 * stepTime)
+        {
+            segment.skip(stepTime);
+            continue;
+        }
+
+        segment.step();
+        ++renderedSegments;
+    }
+}
+
+size_t SegmentedLightBase::getSegmentCount() const
+{
+    return SEGMENT_COUNT;
+}
+
+CarLightBase& SegmentedLightBase::getSegment(size_t index) const
+{
+    return *segments[index];
+}
+
+CarLightBase* const* SegmentedLightBase::getSegments() const
+{
+    return segments;
+}
+
+LightSegment SegmentedLightBase::getRange(size_t index) const
+{
+    return table[index].clamp(PIXEL_COUNT);
+}
+
+size_t SegmentedLightBase::getRenderedSegments() const
+{
+    return renderedSegments;
+}
+
+double SegmentedLightBase::getTimeUntilChange() const
+{
+    double time = INFINITY;
+    for (size_t i = 0; i < SEGMENT_COUNT; ++i)
+    {
+        time = fmin(time, segments[i]->getTimeUntilChange());
+    }
+    return time;
+}
+
+void SegmentedLightBase::skip(double time)
+{
+    for (size_t i = 0; i < SEGMENT_COUNT; ++i)
+    {
+        segments[i]->skip(time);
+    }
+}
+
+void SegmentedLightBase::setRenderQuality(bool bypassFilters, bool spanFill, unsigned stepsPerFrame)
+{
+    for (size_t i = 0; i < SEGMENT_COUNT; ++i)
+    {
+        segments[i]->setRenderQuality(bypassFilters, spanFill, stepsPerFrame);
+    }
+}
+
+void SegmentedLightBase::setParallel(ParallelFor* parallel)
+{
+    for (size_t i = 0; i < SEGMENT_COUNT; ++i)
+    {
+        segments[i]->setParallel(parallel);
+    }
+}
+
+ColorConverter::rgbcct* SegmentedLightBase::getPixels() const
+{
+    return pixels;
+}
+
+size_t SegmentedLightBase::getPixelCount() const
+{
+    return PIXEL_COUNT;
+}
@@ -0,0 +1,147 @@
+#ifndef SEGMENTED_LIGHT_H
+#define SEGMENTED_LIGHT_H
+
+#include <stddef.h>
+#include <inttypes.h>
+
+#include <array>
+#include <iterator>
+#include <utility>
+
+#include "CarLight.h"
+
+/// Range of pixels a segment of a SegmentedLight covers
+struct LightSegment
+{
+    uint16_t first;
+    uint16_t count;
+
+    /// The part of the range that lies within pixelCount pixels
+    constexpr LightSegment clamp(size_t pixelCount) const
+    {
+        const uint16_t clampedFirst = first < pixelCount ? first : pixelCount;
+        return LightSegment{clampedFirst, count < pixelCount - clampedFirst ? count : uint16_t(pixelCount - clampedFirst)};
+    }
+};
+
+/// A car light with COUNT pixels on a slice of pixel storage that is owned by a SegmentedLight
+template <size_t COUNT>
+class CarLightSegment : public CarLightBase
+{
+public:
+    CarLightSegment(const double stepTime, const ColorConverter::rgbcct lightColor,
+                    ColorConverter::rgbcct* pixels, LowPass* colorPixelFilters, LowPass* whitePixelFilters)
+        : CarLightBase(stepTime, COUNT, lightColor, pixels, colorPixelFilters, whitePixelFilters)
+    {}
+
+    void step() override
+    {
+        renderStep<COUNT>();
+    }
+};
+
+/// Independent light zones on one output, e.g. brake light in the middle and blinkers on the sides.
+/// Each segment is a car light of its own (effects, filters, brightness) that renders into its slice of one shared
+/// pixel buffer. Segments that do not change in a step are not rendered again, their pixels keep the last frame.
+/// Pixels that are not in any segment stay black.
+/// Use this type to refer to a segmented light of any size.
+class SegmentedLightBase
+{
+public:
+    /// Segments a light can have at most, bounded by the status reply (LightStatus)
+    static const size_t MAX_SEGMENTS = 8;
+
+    /// Steps every segment that changes in this step. The others only let the time pass (CarLightBase::skip()).
+    /// @param skipUnchanged false renders every segment, e.g. when something else wrote into the pixels since the last step
+    void step(bool skipUnchanged = true);
+
+    size_t getSegmentCount() const;
+
+    /// Segment by index, starting at 0
+    CarLightBase& getSegment(size_t index) const;
+
+    /// All segments, for code that addresses them by index (LEDProtocol, Timeline)
+    CarLightBase* const* getSegments() const;
+
+    /// Pixels of a segment, clamped to the pixels there are
+    LightSegment getRange(size_t index) const;
+
+    /// Segments rendered by the last step()
+    size_t getRenderedSegments() const;
+
+    /// See CarLightBase, for all segments together
+    double getTimeUntilChange() const;
+    void skip(double time);
+    void setRenderQuality(bool bypassFilters, bool spanFill, unsigned stepsPerFrame);
+    void setParallel(ParallelFor* parallel);
+
+    /// Colors of all pixels, segments and the gaps between them
+    ColorConverter::rgbcct* getPixels() const;
+    size_t getPixelCount() const;
+
+protected:
+    /// Storage is owned by the derived class, we only keep pointers
+    SegmentedLightBase(ColorConverter::rgbcct* pixels, size_t pixelCount,
+                       const LightSegment* table, CarLightBase* const* segments, size_t segmentCount);
+
+private:
+    ColorConverter::rgbcct* pixels;
+    const size_t PIXEL_COUNT;
+    const LightSegment* table;
+    CarLightBase* const* segments;
+    const size_t SEGMENT_COUNT;
+    size_t renderedSegments;
+};
+
+/// Pixel storage of SegmentedLight<N, TABLE>.
+/// A separate base class so it is constructed before the segments, which get pointers into it.
+template <size_t N>
+struct SegmentedLightStorage
+{
+    std::array<ColorConverter::rgbcct, N> pixelColors;
+    std::array<LowPass, N> pixelColorFilters;
+    std::array<LowPass, N> pixelWhiteFilters;
+};
+
+/// Segment I of a SegmentedLight. Each segment has its own type (its pixel count), so they are base classes
+/// instead of an array. I keeps the bases distinct when two segments have the same size.
+template <size_t I, size_t COUNT>
+struct SegmentedLightSlot
+{
+    template <size_t N>
+    SegmentedLightSlot(const double stepTime, const ColorConverter::rgbcct lightColor,
+                       SegmentedLightStorage<N>& storage, const LightSegment& range)
+        : segment(stepTime, lightColor, &storage.pixelColors[range.first],
+                  &storage.pixelColorFilters[range.first], &storage.pixelWhiteFilters[range.first])
+    {}
+
+    CarLightSegment<COUNT> segment;
+};
+
+/// Segmented light with N pixels and the segments of TABLE, a constexpr LightSegment array.
+/// The table is a template argument so every segment renders with a loop of known length (CarLightBase::renderStep()).
+/// All pixel and segment state is stored inside the object, nothing is allocated on the heap.
+template <size_t N, const auto& TABLE, typename = std::make_index_sequence<std::size(TABLE)>>
+class SegmentedLight;
+
+template <size_t N, const auto& TABLE, size_t... I>
+class SegmentedLight<N, TABLE, std::index_sequence<I...>>
+    : private SegmentedLightStorage<N>
+    , private SegmentedLightSlot<I, TABLE[I].clamp(N).count>...
+    , public SegmentedLightBase
+{
+    static_assert(sizeof...(I) > 0 && sizeof...(I) <= MAX_SEGMENTS, "Segment count out of range");
+
+public:
+    SegmentedLight(const double stepTime, const ColorConverter::rgbcct lightColor)
+        : SegmentedLightStorage<N>()
+        , SegmentedLightSlot<I, TABLE[I].clamp(N).count>(stepTime, lightColor, *this, TABLE[I].clamp(N))...
+        , SegmentedLightBase(this->pixelColors.data(), N, TABLE, segmentPointers.data(), sizeof...(I))
+        , segmentPointers{{&this->SegmentedLightSlot<I, TABLE[I].clamp(N).count>::segment...}}
+    {}
+
+private:
+    std::array<CarLightBase*, sizeof...(I)> segmentPointers;
+};
+
+#endif // SEGMENTED_LIGHT_H
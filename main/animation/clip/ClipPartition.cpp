@@ -0,0 +1,49 @@
+#include "ClipPartition.h"
+
+#include <esp_log.h>
+
+ClipPartition::ClipPartition()
+    : data(NULL)
+    , size(0)
+    , handle()
+{}
+
+ClipPartition::~ClipPartition()
+{
+    if (data)
+    {
+        esp_partition_munmap(handle);
+    }
+}
+
+bool ClipPartition::map(const char* label)
+{
+    const esp_partition_t* partition = esp_partition_find_first(ESP_PARTITION_TYPE_DATA, ESP_PARTITION_SUBTYPE_ANY, label);
+    if (!partition)
+    {
+        ESP_LOGI("ClipPartition", "No partition %s", label);
+        return false;
+    }
+
+    const void* mapped = NULL;
+    esp_err_t ret = esp_partition_mmap(partition, 0, partition->size, ESP_PARTITION_MMAP_DATA, &mapped, &handle);
+    if (ret != ESP_OK)
+    {
+        ESP_LOGI("ClipPartition", "Mapping partition %s failed (%d)", label, ret);
+        return false;
+    }
+
+    data = static_cast<const uint8_t*>(mapped);
+    size = partition->size;
+    return true;
+}
+
+const uint8_t* ClipPartition::getData() const
+{
+    return data;
+}
+
+size_t ClipPartition::getSize() const
+{
+    return size;
+}
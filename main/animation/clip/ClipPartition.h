@@ -0,0 +1,31 @@
+#ifndef CLIP_PARTITION_H
+#define CLIP_PARTITION_H
+
+#include <esp_partition.h>
+
+#include <inttypes.h>
+#include <stddef.h>
+
+/// Maps a flash data partition holding a clip (see ClipPlayer.h) into the address space.
+/// Reads then go through the flash cache, no copy of the clip is kept in RAM.
+class ClipPartition
+{
+public:
+    ClipPartition();
+    ~ClipPartition();
+
+    /// @param label Partition label in partitions.csv
+    /// @return false if there is no such partition or it could not be mapped
+    bool map(const char* label);
+
+    /// Mapped partition, NULL if not mapped
+    const uint8_t* getData() const;
+    size_t getSize() const;
+
+private:
+    const uint8_t* data;
+    size_t size;
+    esp_partition_mmap_handle_t handle;
+};
+
+#endif // CLIP_PARTITION_H
@@ -0,0 +1,207 @@
+#include "ClipPlayer.h"
+
+#include <string.h>
+
+#include "../../connect/FrameCodec.h"
+
+ClipPlayerBase::ClipPlayerBase(uint8_t* reference, size_t size, size_t stride)
+    : reference(reference)
+    , size(size)
+    , stride(stride)
+    , clip(NULL)
+    , clipSize(0)
+    , header()
+    , command(NONE)
+    , playing(false)
+    , loop(false)
+    , frameDuration(0)
+    , elapsed(0)
+    , frameIndex(0)
+    , offset(0)
+{}
+
+bool ClipPlayerBase::open(const uint8_t* data, size_t dataSize)
+{
+    clip = NULL;
+    playing = false;
+
+    Header newHeader;
+    if (dataSize < sizeof(Header))
+    {
+        return false;
+    }
+    memcpy(&newHeader, data, sizeof(Header));
+
+    if (newHeader.magic != MAGIC || newHeader.version != VERSION || newHeader.frameRate == 0
+        || newHeader.frameSize != size || newHeader.bytesPerLED != stride || newHeader.frameCount == 0)
+    {
+        return false;
+    }
+
+    clip = data;
+    clipSize = dataSize;
+    header = newHeader;
+
+    // Walk all frames once, so playback never has to check anything
+    size_t position = sizeof(Header);
+    for (uint32_t i = 0; i < header.frameCount; ++i)
+    {
+        const uint8_t* frame;
+        size_t frameSize;
+        if (!frameData(position, frame, frameSize)
+            || ((header.flags & DELTA) && !FrameCodec::validate(frame, frameSize, size, stride)))
+        {
+            clip = NULL;
+            return false;
+        }
+        position = frame - clip + frameSize;
+    }
+
+    frameDuration = 1.0 / header.frameRate;
+    return true;
+}
+
+void ClipPlayerBase::play(bool loopClip)
+{
+    command = loopClip ? PLAY_LOOP : PLAY_ONCE;
+}
+
+void ClipPlayerBase::stop()
+{
+    command = STOP;
+}
+
+bool ClipPlayerBase::isPlaying() const
+{
+    return playing;
+}
+
+bool ClipPlayerBase::step(double dt, uint8_t* out)
+{
+    const int newCommand = command.exchange(NONE);
+    if (newCommand == STOP)
+    {
+        playing = false;
+    }
+    else if ((newCommand == PLAY_ONCE || newCommand == PLAY_LOOP) && clip)
+    {
+        playing = true;
+        loop = newCommand == PLAY_LOOP;
+        rewind();
+        // Show the first frame right away
+        elapsed = frameDuration;
+        dt = 0;
+    }
+
+    if (!playing)
+    {
+        return false;
+    }
+
+    elapsed += dt;
+    bool written = false;
+    while (elapsed >= frameDuration)
+    {
+        elapsed -= frameDuration;
+
+        if (frameIndex == header.frameCount)
+        {
+            if (!loop)
+            {
+                playing = false;
+                break;
+            }
+            rewind();
+        }
+
+        // Only the last frame that is due this step is shown
+        const bool show = elapsed < frameDuration;
+        decodeFrame(show ? out : NULL);
+        written |= show;
+    }
+
+    return written;
+}
+
+void ClipPlayerBase::prefetch() const
+{
+    if (!playing)
+    {
+        return;
+    }
+
+    size_t next = offset;
+    if (frameIndex == header.frameCount)
+    {
+        next = sizeof(Header);
+    }
+
+    const uint8_t* frame;
+    size_t frameSize;
+    if (!frameData(next, frame, frameSize))
+    {
+        return;
+    }
+
+    for (size_t i = 0; i < frameSize; i += CACHE_LINE)
+    {
+        static_cast<const volatile uint8_t*>(frame)[i];
+    }
+}
+
+bool ClipPlayerBase::frameData(size_t position, const uint8_t*& data, size_t& dataSize) const
+{
+    if (header.flags & DELTA)
+    {
+        uint32_t payloadSize;
+        if (position + sizeof(uint32_t) > clipSize)
+        {
+            return false;
+        }
+        memcpy(&payloadSize, &clip[position], sizeof(uint32_t));
+        position += sizeof(uint32_t);
+        dataSize = payloadSize;
+    }
+    else
+    {
+        dataSize = header.frameSize;
+    }
+
+    if (position + dataSize > clipSize)
+    {
+        return false;
+    }
+
+    data = &clip[position];
+    return true;
+}
+
+void ClipPlayerBase::rewind()
+{
+    frameIndex = 0;
+    offset = sizeof(Header);
+    if (header.flags & DELTA)
+    {
+        memset(reference, 0, size);
+    }
+}
+
+void ClipPlayerBase::decodeFrame(uint8_t* out)
+{
+    // open() made sure every frame is complete
+    const uint8_t* frame = clip;
+    size_t frameSize = 0;
+    frameData(offset, frame, frameSize);
+
+    if (header.flags & DELTA)
+    {
+        FrameCodec::decode(frame, frameSize, reference, out, size, stride);
+    }
+    else if (out)
+    {
+        memcpy(out, frame, frameSize);
+    }
+
+    offset = frame - clip + frameSize;
+    ++frameIndex;
+}
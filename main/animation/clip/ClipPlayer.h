@@ -0,0 +1,129 @@
+#ifndef CLIP_PLAYER_H
+#define CLIP_PLAYER_H
+
+#include <inttypes.h>
+#include <stddef.h>
+
+#include <array>
+#include <atomic>
+
+/// Plays animations that were rendered offline, straight from memory (e.g. a memory mapped flash partition, see ClipPartition.h).
+/// Every frame is copied or decoded directly into the driver buffer, nothing is rendered at runtime.
+///
+/// Clip format (little endian):
+///   Header: uint32 magic (MAGIC), uint8 version (VERSION), uint8 flags (see Flags), uint8 bytes per LED, uint8 reserved,
+///           uint32 frame size [bytes of wire format], uint32 frame count, uint16 frame rate [Hz], uint16 reserved
+///   Frames: without DELTA: frame count * frame size bytes of wire format
+///           with DELTA:    per frame uint32 payload size and a FrameCodec payload coded against the previous frame.
+///                          The first frame is coded against a black frame.
+/// Use tools/clip_tool.cpp to create clips.
+class ClipPlayerBase
+{
+public:
+    static const uint32_t MAGIC = 0x4344454C; // "LEDC"
+    static const uint8_t VERSION = 1;
+
+    enum Flags
+    {
+        DELTA = 1 << 0
+    };
+
+    struct Header
+    {
+        uint32_t magic;
+        uint8_t version;
+        uint8_t flags;
+        uint8_t bytesPerLED;
+        uint8_t reserved0;
+        uint32_t frameSize;
+        uint32_t frameCount;
+        uint16_t frameRate;
+        uint16_t reserved1;
+    };
+
+    /// Flash cache line size. prefetch() touches one byte per line.
+    static const size_t CACHE_LINE = 32;
+
+    /// Checks the whole clip and makes it the current one. Stops playback.
+    /// Called once at start up, before the render loop runs.
+    /// @param data Clip, must stay valid (mapped) while it is the current clip
+    /// @return false if the clip is malformed or its frame size does not match the driver
+    bool open(const uint8_t* data, size_t size);
+
+    /// Starts playing from the first frame with the next step(). Can be called from any task.
+    void play(bool loop);
+    /// Stops playing with the next step(). Can be called from any task.
+    void stop();
+
+    /// True while a clip is playing. Render task only.
+    bool isPlaying() const;
+
+    /// Advances playback by dt and writes the frame that is due to out. Called once per rendered frame.
+    /// Frames that are due in between are skipped (delta clips still have to decode them).
+    /// @param out Wire format buffer (e.g. LEDDriver::getBuffer())
+    /// @return true if out was written
+    bool step(double dt, uint8_t* out);
+
+    /// Touches the data of the next frame, so it is loaded into the flash cache before it is due.
+    /// Call after the current frame was sent, while we would otherwise wait for the next deadline.
+    /// Only helps as long as a frame fits into the cache (32 KB on the ESP32).
+    void prefetch() const;
+
+protected:
+    /// Storage is owned by the derived class
+    ClipPlayerBase(uint8_t* reference, size_t size, size_t stride);
+
+private:
+    enum Command
+    {
+        NONE,
+        PLAY_ONCE,
+        PLAY_LOOP,
+        STOP
+    };
+
+    /// Offset and size of the stored data of the frame at offset
+    bool frameData(size_t offset, const uint8_t*& data, size_t& dataSize) const;
+
+    void rewind();
+
+    /// Decodes the next frame into the reference and out (may be NULL) and moves on to the frame after it
+    void decodeFrame(uint8_t* out);
+
+    /// Last decoded frame of delta clips
+    uint8_t* reference;
+    const size_t size;
+    const size_t stride;
+
+    const uint8_t* clip;
+    size_t clipSize;
+    Header header;
+
+    std::atomic<int> command;
+    bool playing;
+    bool loop;
+    double frameDuration;
+    double elapsed;
+    uint32_t frameIndex;
+    /// Offset of the next frame in clip
+    size_t offset;
+};
+
+template <size_t Size>
+struct ClipPlayerStorage
+{
+    std::array<uint8_t, Size> referenceFrame;
+};
+
+/// Plays clips with Size bytes per frame and Stride bytes per LED (e.g. LEDDriver<N>::BUFFER_SIZE and BYTES_PER_LED)
+template <size_t Size, size_t Stride>
+class ClipPlayer : private ClipPlayerStorage<Size>, public ClipPlayerBase
+{
+public:
+    ClipPlayer()
+        : ClipPlayerStorage<Size>()
+        , ClipPlayerBase(this->referenceFrame.data(), Size, Stride)
+    {}
+};
+
+#endif // CLIP_PLAYER_H
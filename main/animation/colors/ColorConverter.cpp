@@ -1,144 +1,188 @@
 #include "ColorConverter.h"
 
-#include <math.h>
-
 namespace ColorConverter {
 
-hsv rgb2hsv(rgb in)
+/// Smallest chroma we still consider a color. Below that the hue is undefined and we report gray.
+template <typename T> static inline T hueEpsilon() { return T(0.00001); }
+template <> inline Q16 hueEpsilon<Q16>() { return Q16::fromRaw(1); }
+
+// The kernels pick their results with selects instead of branches. GCC still does not vectorize the batch loops:
+// it moves divisions that only one side of a select uses behind a branch, which it may not turn back into a select
+// with trapping math (the default), and it does not vectorize loads of the five component rgbcct / hsvcct structs.
+// The ESP32 has no floating point SIMD anyway.
+template <typename T> static inline T minOf(const T a, const T b) { return a < b ? a : b; }
+template <typename T> static inline T maxOf(const T a, const T b) { return a > b ? a : b; }
+
+template <typename T>
+static inline hsvT<T> rgb2hsvKernel(const rgbT<T> in)
 {
-    hsv         out;
-    double      min, max, delta;
+    hsvT<T> out;
 
-    min = in.r < in.g ? in.r : in.g;
-    min = min  < in.b ? min  : in.b;
+    const T min = minOf(minOf(in.r, in.g), in.b);
+    const T max = maxOf(maxOf(in.r, in.g), in.b);
+    const T delta = max - min;
+    const bool gray = delta < hueEpsilon<T>();
 
-    max = in.r > in.g ? in.r : in.g;
-    max = max  > in.b ? max  : in.b;
+    // Divisors are replaced by 1 where the result is thrown away anyway, so we never divide by zero
+    const T safeDelta = gray ? T(1) : delta;
+    const T safeMax = max > T(0) ? max : T(1);
 
-    out.v = max;                                // v
-    delta = max - min;
-    if (delta < 0.00001)
-    {
-        out.s = 0;
-        out.h = 0; // undefined, maybe nan?
-        return out;
-    }
-    if( max > 0.0 ) { // NOTE: if Max is == 0, this divide would cause a crash
-        out.s = (delta / max);                  // s
-    } else {
-        // if max is 0, then r = g = b = 0
-        // s = 0, h is undefined
-        out.s = 0.0;
-        out.h = NAN;                            // its now undefined
-        return out;
-    }
-    if( in.r >= max )                           // > is bogus, just keeps compilor happy
-        out.h = ( in.g - in.b ) / delta;        // between yellow & magenta
-    else
-    if( in.g >= max )
-        out.h = 2.0 + ( in.b - in.r ) / delta;  // between cyan & yellow
-    else
-        out.h = 4.0 + ( in.r - in.g ) / delta;  // between magenta & cyan
+    const T hueRed   =        (in.g - in.b) / safeDelta;     // between yellow & magenta
+    const T hueGreen = T(2) + (in.b - in.r) / safeDelta;     // between cyan & yellow
+    const T hueBlue  = T(4) + (in.r - in.g) / safeDelta;     // between magenta & cyan
 
-    out.h *= 60.0;                              // degrees
+    T h = in.r >= max ? hueRed : (in.g >= max ? hueGreen : hueBlue);
+    h = h * T(60);                                           // degrees
+    h = h < T(0) ? h + T(360) : h;
 
-    if( out.h < 0.0 )
-        out.h += 360.0;
+    out.v = max;
+    out.s = gray || !(max > T(0)) ? T(0) : delta / safeMax;
+    out.h = gray ? T(0) : h;                                 // undefined for gray, we use 0
 
     return out;
 }
 
-hsvcct rgb2hsv(rgbcct in)
+template <typename T>
+static inline hsvcctT<T> rgb2hsvKernel(const rgbcctT<T> in)
 {
-    hsvcct ret;
-    ret.color = rgb2hsv(in.color);
+    hsvcctT<T> ret;
+    ret.color = rgb2hsvKernel(in.color);
 
     // We always want the cold and warm values to add up to the value.
     // This ensures that we keep the same brightness when changing temperature.
-    ret.whiteValue = std::min(in.cw + in.ww, 1.0);
+    const T sum = in.cw + in.ww;
+    ret.whiteValue = minOf(sum, T(1));
 
-    double coldAmount = COLD_TEMPERATURE * in.cw;
-    double warmAmount = WARM_TEMPERATURE * in.ww;
+    const T coldAmount = T(COLD_TEMPERATURE) * in.cw;
+    const T warmAmount = T(WARM_TEMPERATURE) * in.ww;
 
-    ret.whiteTemp = (coldAmount + warmAmount) / (in.cw + in.ww);
+    // Without any white the temperature is undefined. Report warm white instead of dividing by zero.
+    const bool noWhite = !(sum > T(0));
+    ret.whiteTemp = noWhite ? T(WARM_TEMPERATURE) : (coldAmount + warmAmount) / (noWhite ? T(1) : sum);
 
     return ret;
 }
 
-rgb hsv2rgb(hsv in)
+/// Computes one rgb channel from hue sector position
+/// @param n Channel offset in sectors (5 = red, 3 = green, 1 = blue)
+/// @param sector Hue in sectors of 60 degrees [0, 6)
+template <typename T>
+static inline T hsvChannel(const T n, const T sector, const hsvT<T> in, const T saturation)
 {
-    double      hh, p, q, t, ff;
-    long        i;
-    rgb         out;
-
-    if(in.s <= 0.0) {       // < is bogus, just shuts up warnings
-        out.r = in.v;
-        out.g = in.v;
-        out.b = in.v;
-        return out;
-    }
-    hh = in.h;
-    if(hh >= 360.0) hh = 0.0;
-    hh /= 60.0;
-    i = (long)hh;
-    ff = hh - i;
-    p = in.v * (1.0 - in.s);
-    q = in.v * (1.0 - (in.s * ff));
-    t = in.v * (1.0 - (in.s * (1.0 - ff)));
-
-    switch(i) {
-    case 0:
-        out.r = in.v;
-        out.g = t;
-        out.b = p;
-        break;
-    case 1:
-        out.r = q;
-        out.g = in.v;
-        out.b = p;
-        break;
-    case 2:
-        out.r = p;
-        out.g = in.v;
-        out.b = t;
-        break;
-
-    case 3:
-        out.r = p;
-        out.g = q;
-        out.b = in.v;
-        break;
-    case 4:
-        out.r = t;
-        out.g = p;
-        out.b = in.v;
-        break;
-    case 5:
-    default:
-        out.r = in.v;
-        out.g = p;
-        out.b = q;
-        break;
-    }
+    T k = n + sector;
+    k = k >= T(6) ? k - T(6) : k;
+    const T ramp = maxOf(T(0), minOf(minOf(k, T(4) - k), T(1)));
+    return in.v - in.v * saturation * ramp;
+}
+
+template <typename T>
+static inline rgbT<T> hsv2rgbKernel(const hsvT<T> in)
+{
+    rgbT<T> out;
+
+    // Saturations <= 0 result in gray, hues outside of [0, 360) in red
+    const T saturation = maxOf(in.s, T(0));
+    const T hue = in.h >= T(360) || in.h < T(0) ? T(0) : in.h;
+    const T sector = hue / T(60);
+
+    out.r = hsvChannel(T(5), sector, in, saturation);
+    out.g = hsvChannel(T(3), sector, in, saturation);
+    out.b = hsvChannel(T(1), sector, in, saturation);
+
     return out;
 }
 
-rgbcct hsv2rgb(hsvcct in)
+template <typename T>
+static inline rgbcctT<T> hsv2rgbKernel(const hsvcctT<T> in)
 {
-    rgbcct ret;
-    ret.color = hsv2rgb(in.color);
+    rgbcctT<T> ret;
+    ret.color = hsv2rgbKernel(in.color);
 
-    double temperatureRange = COLD_TEMPERATURE - WARM_TEMPERATURE;
+    const T temperatureRange = T(COLD_TEMPERATURE - WARM_TEMPERATURE);
 
-    ret.cw = (in.whiteTemp - WARM_TEMPERATURE) / temperatureRange;
-    ret.ww = (COLD_TEMPERATURE - in.whiteTemp) / temperatureRange;
+    ret.cw = (in.whiteTemp - T(WARM_TEMPERATURE)) / temperatureRange;
+    ret.ww = (T(COLD_TEMPERATURE) - in.whiteTemp) / temperatureRange;
 
-    ret.cw *= in.whiteValue;
-    ret.ww *= in.whiteValue;
+    ret.cw = ret.cw * in.whiteValue;
+    ret.ww = ret.ww * in.whiteValue;
 
     return ret;
 }
 
+template <typename T>
+hsvT<T> rgb2hsv(rgbT<T> in)
+{
+    return rgb2hsvKernel(in);
+}
+
+template <typename T>
+hsvcctT<T> rgb2hsv(rgbcctT<T> in)
+{
+    return rgb2hsvKernel(in);
+}
+
+template <typename T>
+rgbT<T> hsv2rgb(hsvT<T> in)
+{
+    return hsv2rgbKernel(in);
+}
+
+template <typename T>
+rgbcctT<T> hsv2rgb(hsvcctT<T> in)
+{
+    return hsv2rgbKernel(in);
+}
+
+template <typename T>
+void rgb2hsv(const rgbT<T>* __restrict in, hsvT<T>* __restrict out, size_t n)
+{
+    for (size_t i = 0; i < n; ++i)
+    {
+        out[i] = rgb2hsvKernel(in[i]);
+    }
+}
+
+template <typename T>
+void rgb2hsv(const rgbcctT<T>* __restrict in, hsvcctT<T>* __restrict out, size_t n)
+{
+    for (size_t i = 0; i < n; ++i)
+    {
+        out[i] = rgb2hsvKernel(in[i]);
+    }
+}
+
+template <typename T>
+void hsv2rgb(const hsvT<T>* __restrict in, rgbT<T>* __restrict out, size_t n)
+{
+    for (size_t i = 0; i < n; ++i)
+    {
+        out[i] = hsv2rgbKernel(in[i]);
+    }
+}
+
+template <typename T>
+void hsv2rgb(const hsvcctT<T>* __restrict in, rgbcctT<T>* __restrict out, size_t n)
+{
+    for (size_t i = 0; i < n; ++i)
+    {
+        out[i] = hsv2rgbKernel(in[i]);
+    }
+}
+
+#define INSTANTIATE_COLOR_CONVERSIONS(T) \
+    template hsvT<T> rgb2hsv(rgbT<T> in); \
+    template hsvcctT<T> rgb2hsv(rgbcctT<T> in); \
+    template rgbT<T> hsv2rgb(hsvT<T> in); \
+    template rgbcctT<T> hsv2rgb(hsvcctT<T> in); \
+    template void rgb2hsv(const rgbT<T>* in, hsvT<T>* out, size_t n); \
+    template void rgb2hsv(const rgbcctT<T>* in, hsvcctT<T>* out, size_t n); \
+    template void hsv2rgb(const hsvT<T>* in, rgbT<T>* out, size_t n); \
+    template void hsv2rgb(const hsvcctT<T>* in, rgbcctT<T>* out, size_t n);
+
+INSTANTIATE_COLOR_CONVERSIONS(double)
+INSTANTIATE_COLOR_CONVERSIONS(float)
+INSTANTIATE_COLOR_CONVERSIONS(Q16)
+
 uint64_t to8BitBRG(const rgb in)
 {
     int64_t retValue = 0;
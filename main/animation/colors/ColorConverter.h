@@ -2,6 +2,9 @@
 #define COLOR_CONVERTER_H
 
 #include <inttypes.h>
+#include <stddef.h>
+
+#include "FixedPoint.h"
 
 namespace ColorConverter
 {
@@ -9,34 +12,63 @@ namespace ColorConverter
 static const double WARM_TEMPERATURE = 3000; // Kelvin
 static const double COLD_TEMPERATURE = 6500; // Kelvin
 
-typedef struct {
-    double r;       // a fraction between 0 and 1
-    double g;       // a fraction between 0 and 1
-    double b;       // a fraction between 0 and 1
-} rgb;
-
-typedef struct {
-    double h;       // angle in degrees
-    double s;       // a fraction between 0 and 1
-    double v;       // a fraction between 0 and 1
-} hsv;
-
-typedef struct {
-    rgb color;
-    double ww;
-    double cw;
-} rgbcct;
-
-typedef struct {
-    hsv color;
-    double whiteTemp;
-    double whiteValue;
-} hsvcct;
-
-hsv rgb2hsv(rgb in);
-hsvcct rgb2hsv(rgbcct in);
-rgb hsv2rgb(hsv in);
-rgbcct hsv2rgb(hsvcct in);
+/// All color types are templated on their scalar type.
+/// Conversions are available for double, float and Q16 (16.16 fixed point).
+template <typename T>
+struct rgbT {
+    T r;       // a fraction between 0 and 1
+    T g;       // a fraction between 0 and 1
+    T b;       // a fraction between 0 and 1
+};
+
+template <typename T>
+struct hsvT {
+    T h;       // angle in degrees
+    T s;       // a fraction between 0 and 1
+    T v;       // a fraction between 0 and 1
+};
+
+template <typename T>
+struct rgbcctT {
+    rgbT<T> color;
+    T ww;
+    T cw;
+};
+
+template <typename T>
+struct hsvcctT {
+    hsvT<T> color;
+    T whiteTemp;
+    T whiteValue;
+};
+
+typedef rgbT<double> rgb;
+typedef hsvT<double> hsv;
+typedef rgbcctT<double> rgbcct;
+typedef hsvcctT<double> hsvcct;
+
+typedef rgbT<float> rgbf;
+typedef hsvT<float> hsvf;
+typedef rgbcctT<float> rgbcctf;
+typedef hsvcctT<float> hsvcctf;
+
+typedef rgbT<Q16> rgbq;
+typedef hsvT<Q16> hsvq;
+typedef rgbcctT<Q16> rgbcctq;
+typedef hsvcctT<Q16> hsvcctq;
+
+template <typename T> hsvT<T> rgb2hsv(rgbT<T> in);
+template <typename T> hsvcctT<T> rgb2hsv(rgbcctT<T> in);
+template <typename T> rgbT<T> hsv2rgb(hsvT<T> in);
+template <typename T> rgbcctT<T> hsv2rgb(hsvcctT<T> in);
+
+/// Batch conversions of n values, same results as converting them one by one.
+/// The compiler does not vectorize these loops (see ColorConverter.cpp), they save the call per value.
+/// in and out must not overlap.
+template <typename T> void rgb2hsv(const rgbT<T>* in, hsvT<T>* out, size_t n);
+template <typename T> void rgb2hsv(const rgbcctT<T>* in, hsvcctT<T>* out, size_t n);
+template <typename T> void hsv2rgb(const hsvT<T>* in, rgbT<T>* out, size_t n);
+template <typename T> void hsv2rgb(const hsvcctT<T>* in, rgbcctT<T>* out, size_t n);
 
 /// Converts given color to 8 bit values saved in the least significant bits of the returned integer
 /// Color order is Blue Red Green
@@ -0,0 +1,62 @@
+#ifndef FIXED_POINT_H
+#define FIXED_POINT_H
+
+#include <inttypes.h>
+
+/// Signed 16.16 fixed point number.
+/// Range is [-32768, 32768) with a resolution of 1/65536. This is enough for color fractions,
+/// hue angles in degrees and white temperatures in Kelvin.
+/// Behaves like a floating point type so the templated color conversions can use it as scalar type.
+class Q16
+{
+public:
+    static const int FRACTION_BITS = 16;
+    static const int32_t ONE = 1 << FRACTION_BITS;
+
+    constexpr Q16() : raw(0) {}
+    constexpr Q16(int value) : raw(value * ONE) {}
+    constexpr Q16(double value) : raw(static_cast<int32_t>(value * ONE + (value < 0 ? -0.5 : 0.5))) {}
+
+    /// Creates a number from its raw 16.16 representation
+    static constexpr Q16 fromRaw(int32_t raw)
+    {
+        Q16 ret;
+        ret.raw = raw;
+        return ret;
+    }
+
+    constexpr explicit operator double() const { return static_cast<double>(raw) / ONE; }
+    constexpr explicit operator float() const { return static_cast<float>(raw) / ONE; }
+    /// Rounds towards negative infinity
+    constexpr explicit operator int() const { return raw >> FRACTION_BITS; }
+
+    constexpr Q16 operator-() const { return fromRaw(-raw); }
+
+    constexpr Q16 operator+(const Q16 other) const { return fromRaw(raw + other.raw); }
+    constexpr Q16 operator-(const Q16 other) const { return fromRaw(raw - other.raw); }
+    constexpr Q16 operator*(const Q16 other) const
+    {
+        return fromRaw(static_cast<int32_t>((static_cast<int64_t>(raw) * other.raw) >> FRACTION_BITS));
+    }
+    /// Division by zero is undefined, just like for integers
+    constexpr Q16 operator/(const Q16 other) const
+    {
+        return fromRaw(static_cast<int32_t>((static_cast<int64_t>(raw) * ONE) / other.raw));
+    }
+
+    constexpr Q16& operator+=(const Q16 other) { return *this = *this + other; }
+    constexpr Q16& operator-=(const Q16 other) { return *this = *this - other; }
+    constexpr Q16& operator*=(const Q16 other) { return *this = *this * other; }
+    constexpr Q16& operator/=(const Q16 other) { return *this = *this / other; }
+
+    constexpr bool operator==(const Q16 other) const { return raw == other.raw; }
+    constexpr bool operator!=(const Q16 other) const { return raw != other.raw; }
+    constexpr bool operator<(const Q16 other) const { return raw < other.raw; }
+    constexpr bool operator<=(const Q16 other) const { return raw <= other.raw; }
+    constexpr bool operator>(const Q16 other) const { return raw > other.raw; }
+    constexpr bool operator>=(const Q16 other) const { return raw >= other.raw; }
+
+    int32_t raw;
+};
+
+#endif // FIXED_POINT_H
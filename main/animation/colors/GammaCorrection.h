@@ -2,24 +2,111 @@
 #define GAMMA_CORRECTION_H
 
 #include <stdint.h>
+#include <stddef.h>
 
-const uint8_t gamma8[] = {
-  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,
-  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  1,  1,  1,  1,
-  1,  1,  1,  1,  1,  1,  1,  1,  1,  2,  2,  2,  2,  2,  2,  2,
-  2,  3,  3,  3,  3,  3,  3,  3,  4,  4,  4,  4,  4,  5,  5,  5,
-  5,  6,  6,  6,  6,  7,  7,  7,  7,  8,  8,  8,  9,  9,  9, 10,
-  10, 10, 11, 11, 11, 12, 12, 13, 13, 13, 14, 14, 15, 15, 16, 16,
-  17, 17, 18, 18, 19, 19, 20, 20, 21, 21, 22, 22, 23, 24, 24, 25,
-  25, 26, 27, 27, 28, 29, 29, 30, 31, 32, 32, 33, 34, 35, 35, 36,
-  37, 38, 39, 39, 40, 41, 42, 43, 44, 45, 46, 47, 48, 49, 50, 50,
-  51, 52, 54, 55, 56, 57, 58, 59, 60, 61, 62, 63, 64, 66, 67, 68,
-  69, 70, 72, 73, 74, 75, 77, 78, 79, 81, 82, 83, 85, 86, 87, 89,
-  90, 92, 93, 95, 96, 98, 99,101,102,104,105,107,109,110,112,114,
-  115,117,119,120,122,124,126,127,129,131,133,135,137,138,140,142,
-  144,146,148,150,152,154,156,158,160,162,164,167,169,171,173,175,
-  177,180,182,184,186,189,191,193,196,198,200,203,205,208,210,213,
-  215,218,220,223,225,228,231,233,236,239,241,244,247,249,252,255
-};
-
-#endif
\ No newline at end of file
+#include <array>
+
+namespace GammaCorrection
+{
+
+/// Gamma exponent of the LEDs. Change this to recalibrate all tables at compile time.
+constexpr double GAMMA = 2.8;
+
+/// Natural logarithm that can be evaluated at compile time
+/// @param x Must be greater than 0
+constexpr double log(double x)
+{
+    constexpr double LN2 = 0.69314718055994530942;
+
+    // Reduce x to [0.5, 1) so the series below converges quickly
+    int exponent = 0;
+    while (x >= 1.0)
+    {
+        x /= 2;
+        ++exponent;
+    }
+    while (x < 0.5)
+    {
+        x *= 2;
+        --exponent;
+    }
+
+    // ln(x) = 2 * atanh((x - 1) / (x + 1))
+    const double y = (x - 1) / (x + 1);
+    const double ySquared = y * y;
+    double term = y;
+    double sum = 0;
+    for (int n = 1; n < 60; n += 2)
+    {
+        sum += term / n;
+        term *= ySquared;
+    }
+
+    return exponent * LN2 + 2 * sum;
+}
+
+/// Exponential function that can be evaluated at compile time
+constexpr double exp(double x)
+{
+    constexpr double LN2 = 0.69314718055994530942;
+
+    // Split into 2^n * e^r with |r| <= ln(2) / 2
+    int n = static_cast<int>(x / LN2 + (x < 0 ? -0.5 : 0.5));
+    const double r = x - n * LN2;
+
+    double term = 1;
+    double sum = 1;
+    for (int k = 1; k < 30; ++k)
+    {
+        term *= r / k;
+        sum += term;
+    }
+
+    for (; n > 0; --n)
+    {
+        sum *= 2;
+    }
+    for (; n < 0; ++n)
+    {
+        sum /= 2;
+    }
+
+    return sum;
+}
+
+/// base^exponent for base >= 0 that can be evaluated at compile time
+constexpr double pow(double base, double exponent)
+{
+    return base <= 0 ? 0 : GammaCorrection::exp(exponent * GammaCorrection::log(base));
+}
+
+/// Generates a gamma lookup table
+/// @tparam Size Number of table entries. Index 0 is black, Size - 1 is full intensity.
+/// @param gamma Gamma exponent
+/// @param maxOutput Value of the last table entry
+/// @param scale Factor applied after gamma correction (white balance, brightness)
+template <typename T, size_t Size>
+constexpr std::array<T, Size> makeTable(double gamma, double maxOutput, double scale = 1.0)
+{
+    std::array<T, Size> table = {};
+    for (size_t i = 0; i < Size; ++i)
+    {
+        double value = GammaCorrection::pow(static_cast<double>(i) / (Size - 1), gamma) * maxOutput * scale;
+        table[i] = static_cast<T>(value > maxOutput ? maxOutput : value + 0.5);
+    }
+    return table;
+}
+
+/// Bits of the linear intensity used to index the high resolution table
+constexpr size_t LINEAR_BITS = 10;
+constexpr size_t LINEAR_SIZE = 1 << LINEAR_BITS;
+
+/// Maps 10 bit linear intensity to 16 bit gamma corrected intensity
+constexpr std::array<uint16_t, LINEAR_SIZE> linear10 = makeTable<uint16_t, LINEAR_SIZE>(GAMMA, 0xFFFF);
+
+} // namespace GammaCorrection
+
+/// Maps 8 bit linear intensity to 8 bit gamma corrected intensity
+constexpr std::array<uint8_t, 256> gamma8 = GammaCorrection::makeTable<uint8_t, 256>(GammaCorrection::GAMMA, 0xFF);
+
+#endif
@@ -0,0 +1,66 @@
+#include "LightTable.h"
+
+#include <math.h>
+
+LightTable::LightTable()
+    : brightness(1.0)
+{
+    for (size_t c = 0; c < CHANNEL_COUNT; ++c)
+    {
+        whiteBalance[c] = 1.0;
+    }
+    rebuild();
+}
+
+void LightTable::setWhiteBalance(Channel channel, float scale)
+{
+    if (whiteBalance[channel] != scale)
+    {
+        whiteBalance[channel] = scale;
+        rebuild();
+    }
+}
+
+void LightTable::setBrightness(float newBrightness)
+{
+    if (brightness != newBrightness)
+    {
+        brightness = newBrightness;
+        rebuild();
+    }
+}
+
+float LightTable::getBrightness() const
+{
+    return brightness;
+}
+
+uint64_t LightTable::to8BitWWBRG(const ColorConverter::rgbcct& in) const
+{
+    uint64_t retValue = 0;
+
+    retValue |= static_cast<uint64_t>(lookup(COLD, in.cw)) << 32;
+    retValue |= static_cast<uint64_t>(lookup(WARM, in.ww)) << 24;
+    retValue |= static_cast<uint64_t>(lookup(BLUE, in.color.b)) << 16;
+    retValue |= static_cast<uint64_t>(lookup(RED, in.color.r)) << 8;
+    retValue |= static_cast<uint64_t>(lookup(GREEN, in.color.g));
+
+    return retValue;
+}
+
+void LightTable::rebuild()
+{
+    // (brightness * x)^gamma = brightness^gamma * x^gamma, so folding in brightness is a single multiply
+    // on top of the compile time gamma table.
+    const float brightnessFactor = powf(brightness, GammaCorrection::GAMMA);
+
+    for (size_t c = 0; c < CHANNEL_COUNT; ++c)
+    {
+        const float scale = brightnessFactor * whiteBalance[c];
+        for (size_t i = 0; i < SIZE; ++i)
+        {
+            float value = GammaCorrection::linear10[i] * scale + 0.5f;
+            tables[c][i] = static_cast<uint16_t>(value > 0xFFFF ? 0xFFFF : value);
+        }
+    }
+}
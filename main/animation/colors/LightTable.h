@@ -0,0 +1,76 @@
+#ifndef LIGHT_TABLE_H
+#define LIGHT_TABLE_H
+
+#include <inttypes.h>
+#include <stddef.h>
+
+#include "ColorConverter.h"
+#include "GammaCorrection.h"
+
+/// Fused brightness * gamma * white balance lookup tables.
+/// Maps a linear channel intensity to the value we send to the LED with a single table lookup.
+/// Tables hold 16 bit output intensity so TemporalDither can recover the fraction lost in 8 bit.
+/// The gamma curve is generated at compile time (see GammaCorrection.h), white balance and global
+/// brightness are folded in at runtime whenever they change.
+class LightTable
+{
+public:
+    enum Channel
+    {
+        RED,
+        GREEN,
+        BLUE,
+        WARM,
+        COLD,
+        CHANNEL_COUNT
+    };
+
+    /// Number of entries per channel. Index is the linear intensity with 10 bit resolution.
+    static const size_t SIZE = GammaCorrection::LINEAR_SIZE;
+
+    LightTable();
+
+    /// Scale the given channel to match the other channels [0, 1]
+    void setWhiteBalance(Channel channel, float scale);
+
+    /// Global brightness that is applied to all channels [0, 1].
+    /// Call once per frame, the tables are only rebuilt when the value actually changed.
+    /// main.cpp sets it from on/off and dim in indexed mode. Rendered pixels are already dimmed by CarLight, there it stays 1.
+    void setBrightness(float brightness);
+    float getBrightness() const;
+
+    /// Look up the 8 bit output value of a channel
+    /// @param intensity Linear intensity [0, 1]
+    uint8_t lookup(Channel channel, float intensity) const
+    {
+        const uint32_t value = lookup16(channel, intensity);
+        return (value + 0x80 - (value >> 8)) >> 8; // Rounds 0xFFFF to 0xFF
+    }
+
+    /// Look up the 16 bit output value of a channel
+    /// @param intensity Linear intensity [0, 1]
+    uint16_t lookup16(Channel channel, float intensity) const
+    {
+        return tables[channel][toIndex(intensity)];
+    }
+
+    /// Same as ColorConverter::to8BitWWBRG() but with brightness, gamma and white balance applied
+    /// @return Format 0xCWWWBBRRGG
+    uint64_t to8BitWWBRG(const ColorConverter::rgbcct& in) const;
+
+private:
+    static size_t toIndex(float intensity)
+    {
+        intensity = intensity < 0 ? 0 : (intensity > 1 ? 1 : intensity);
+        return static_cast<size_t>(intensity * (SIZE - 1) + 0.5f);
+    }
+
+    void rebuild();
+
+    float brightness;
+    float whiteBalance[CHANNEL_COUNT];
+
+    uint16_t tables[CHANNEL_COUNT][SIZE];
+};
+
+#endif // LIGHT_TABLE_H
@@ -0,0 +1,28 @@
+#include "Palette.h"
+
+Palette::Palette()
+{
+    for (size_t i = 0; i < SIZE; ++i)
+    {
+        colors[i] = ColorConverter::rgbcct(ColorConverter::rgb(0, 0, 0), 0, 0);
+        output[i] = 0;
+    }
+}
+
+void Palette::set(uint8_t index, const ColorConverter::rgbcct& color)
+{
+    colors[index] = color;
+}
+
+const ColorConverter::rgbcct& Palette::get(uint8_t index) const
+{
+    return colors[index];
+}
+
+void Palette::update(const LightTable& table)
+{
+    for (size_t i = 0; i < SIZE; ++i)
+    {
+        output[i] = table.to8BitWWBRG(colors[i]);
+    }
+}
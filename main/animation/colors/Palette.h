@@ -0,0 +1,56 @@
+#ifndef PALETTE_H
+#define PALETTE_H
+
+#include <inttypes.h>
+#include <stddef.h>
+
+#include "ColorConverter.h"
+#include "LightTable.h"
+#include "../../led_driver/WireFormat.h"
+
+/// 256 entry color palette for indexed framebuffers (see IndexedFrame.h).
+/// Keeps the linear colors and a copy already converted to output values, so expanding a pixel to
+/// wire format is a single table lookup. Changing an entry recolors every pixel using it at the cost
+/// of converting that one entry.
+class Palette
+{
+public:
+    static const size_t SIZE = 256;
+
+    /// All entries start black
+    Palette();
+
+    /// Sets an entry. Takes effect at the next update().
+    void set(uint8_t index, const ColorConverter::rgbcct& color);
+    const ColorConverter::rgbcct& get(uint8_t index) const;
+
+    /// Converts all entries to output values with brightness, gamma and white balance of the given table.
+    /// Call once per rendered frame, before expand(). Costs SIZE lookups, independent of the LED count.
+    void update(const LightTable& table);
+
+    /// Output value of an entry
+    /// @return Format 0xCWWWBBRRGG
+    uint64_t lookup(uint8_t index) const
+    {
+        return output[index];
+    }
+
+    /// Writes the colors of the given indices to a wire format buffer
+    /// @param indices One palette index per LED
+    /// @param count Number of LEDs
+    /// @param buffer Wire format buffer with space for count LEDs (e.g. LEDDriver::getBuffer())
+    template <typename Format>
+    void expand(const uint8_t* indices, size_t count, uint8_t* buffer) const
+    {
+        for (size_t i = 0; i < count; ++i)
+        {
+            WireFormat::pack<Format>(&buffer[i * Format::BYTES_PER_LED], output[indices[i]]);
+        }
+    }
+
+private:
+    ColorConverter::rgbcct colors[SIZE];
+    uint64_t output[SIZE];
+};
+
+#endif // PALETTE_H
@@ -0,0 +1,91 @@
+#ifndef TEMPORAL_DITHER_H
+#define TEMPORAL_DITHER_H
+
+#include <inttypes.h>
+#include <stddef.h>
+
+#include <array>
+
+#include "ColorConverter.h"
+#include "LightTable.h"
+
+/// Temporal dithering for more than 8 bit effective color depth.
+/// Keeps the 16 bit output intensity of every channel and an error accumulator holding the fraction
+/// that did not fit into 8 bit. Every output frame the accumulated error is added, so the average over
+/// consecutive frames matches the 16 bit target.
+/// Only works if the strip is refreshed a lot faster than the eye can see (~200 Hz).
+template <size_t N>
+class TemporalDither
+{
+public:
+    TemporalDither()
+    {
+        for (size_t i = 0; i < N * CHANNELS; ++i)
+        {
+            targets[i] = 0;
+            // Start every channel at a different phase so neighbouring pixels do not step up in the same frame
+            errors[i] = (i * 151) & 0xFF;
+        }
+    }
+
+    /// Sets the target of a pixel. Call once per rendered frame.
+    void set(size_t index, const LightTable& table, const ColorConverter::rgbcct& color)
+    {
+        uint16_t* target = &targets[index * CHANNELS];
+        target[LightTable::RED]   = table.lookup16(LightTable::RED,   color.color.r);
+        target[LightTable::GREEN] = table.lookup16(LightTable::GREEN, color.color.g);
+        target[LightTable::BLUE]  = table.lookup16(LightTable::BLUE,  color.color.b);
+        target[LightTable::WARM]  = table.lookup16(LightTable::WARM,  color.ww);
+        target[LightTable::COLD]  = table.lookup16(LightTable::COLD,  color.cw);
+    }
+
+    /// Advances the error accumulators of a pixel by one output frame
+    /// @return 8 bit values of this output frame. Format 0xCWWWBBRRGG
+    uint64_t next8BitWWBRG(size_t index)
+    {
+        const uint16_t* target = &targets[index * CHANNELS];
+        uint8_t* error = &errors[index * CHANNELS];
+
+        uint64_t retValue = 0;
+        retValue |= static_cast<uint64_t>(dither(target[LightTable::COLD],  error[LightTable::COLD]))  << 32;
+        retValue |= static_cast<uint64_t>(dither(target[LightTable::WARM],  error[LightTable::WARM]))  << 24;
+        retValue |= static_cast<uint64_t>(dither(target[LightTable::BLUE],  error[LightTable::BLUE]))  << 16;
+        retValue |= static_cast<uint64_t>(dither(target[LightTable::RED],   error[LightTable::RED]))   << 8;
+        retValue |= static_cast<uint64_t>(dither(target[LightTable::GREEN], error[LightTable::GREEN]));
+
+        return retValue;
+    }
+
+    /// @return true if every target fits into 8 bit, so refreshing the strip again does not show anything new
+    bool isExact() const
+    {
+        for (size_t i = 0; i < N * CHANNELS; ++i)
+        {
+            // Targets above 0xFF00 are clamped to 0xFF anyway
+            if ((targets[i] & 0xFF) != 0 && targets[i] < 0xFF00)
+            {
+                return false;
+            }
+        }
+        return true;
+    }
+
+private:
+    static const size_t CHANNELS = LightTable::CHANNEL_COUNT;
+
+    static uint8_t dither(uint16_t target, uint8_t& error)
+    {
+        const uint16_t accumulated = error + (target & 0xFF);
+        error = accumulated & 0xFF;
+        const uint16_t value = (target >> 8) + (accumulated >> 8);
+        return value > 0xFF ? 0xFF : value;
+    }
+
+    /// 16 bit output intensity, CHANNELS per pixel
+    std::array<uint16_t, N * CHANNELS> targets;
+
+    /// Fraction carried over to the next frame, CHANNELS per pixel
+    std::array<uint8_t, N * CHANNELS> errors;
+};
+
+#endif // TEMPORAL_DITHER_H
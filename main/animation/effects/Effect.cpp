@@ -0,0 +1,138 @@
+#include "Effect.h"
+
+#include <math.h>
+
+Effect::Effect()
+    : resumePoint(0)
+    , sleep(0)
+    , next(NULL)
+    , nextStarted(NULL)
+    , active(false)
+    , queued(false)
+    , stopRequested(false)
+{}
+
+bool Effect::isActive() const
+{
+    return active.load(std::memory_order_relaxed);
+}
+
+EffectRunner::EffectRunner()
+    : active(NULL)
+    , started(NULL)
+{}
+
+void EffectRunner::start(Effect& effect)
+{
+    effect.stopRequested.store(false, std::memory_order_relaxed);
+    if (effect.queued.exchange(true, std::memory_order_acq_rel))
+    {
+        return;
+    }
+
+    // Lock free push, several tasks may start effects at the same time
+    Effect* head = started.load(std::memory_order_relaxed);
+    do
+    {
+        effect.nextStarted = head;
+    } while (!started.compare_exchange_weak(head, &effect, std::memory_order_release, std::memory_order_relaxed));
+}
+
+void EffectRunner::stop(Effect& effect)
+{
+    effect.stopRequested.store(true, std::memory_order_relaxed);
+}
+
+void EffectRunner::step(double dt)
+{
+    // Started effects are appended in start order, so effects started together run in the order they were started
+    Effect* newest = started.exchange(NULL, std::memory_order_acquire);
+    Effect* oldest = NULL;
+    while (newest)
+    {
+        Effect* effect = newest;
+        newest = effect->nextStarted;
+        effect->nextStarted = oldest;
+        oldest = effect;
+    }
+
+    Effect** tail = &active;
+    while (*tail)
+    {
+        tail = &(*tail)->next;
+    }
+    while (oldest)
+    {
+        Effect* effect = oldest;
+        oldest = effect->nextStarted;
+        effect->queued.store(false, std::memory_order_relaxed);
+        if (effect->isActive())
+        {
+            continue;
+        }
+
+        effect->resumePoint = 0;
+        effect->sleep = 0;
+        effect->next = NULL;
+        effect->active.store(true, std::memory_order_relaxed);
+        *tail = effect;
+        tail = &effect->next;
+    }
+
+    Effect** link = &active;
+    while (*link)
+    {
+        Effect* effect = *link;
+        bool running;
+        if (effect->stopRequested.exchange(false, std::memory_order_relaxed))
+        {
+            effect->stopped();
+            running = false;
+        }
+        else if (effect->sleep > dt / 2 && (effect->sleep -= dt) > dt / 2)
+        {
+            running = true;
+        }
+        else
+        {
+            running = effect->resume(dt);
+        }
+
+        if (running)
+        {
+            link = &effect->next;
+        }
+        else
+        {
+            *link = effect->next;
+            effect->active.store(false, std::memory_order_relaxed);
+        }
+    }
+}
+
+double EffectRunner::getTimeUntilResume() const
+{
+    if (started.load(std::memory_order_relaxed))
+    {
+        return 0;
+    }
+
+    double time = INFINITY;
+    for (const Effect* effect = active; effect; effect = effect->next)
+    {
+        if (effect->stopRequested.load(std::memory_order_relaxed))
+        {
+            return 0;
+        }
+        time = fmin(time, fmax(effect->sleep, 0.0));
+    }
+    return time;
+}
+
+void EffectRunner::skip(double time)
+{
+    for (Effect* effect = active; effect; effect = effect->next)
+    {
+        effect->sleep -= time;
+    }
+}
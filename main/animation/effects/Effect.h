@@ -0,0 +1,117 @@
+#ifndef EFFECT_H
+#define EFFECT_H
+
+#include <stddef.h>
+
+#include <atomic>
+
+/// An animation that runs for a while and is written as sequential code, e.g. "flash, wait 100 ms, flash again".
+/// Effects are resumable functions in the style of protothreads: resume() returns at a suspension point and
+/// continues right after it the next time. Locals do not survive a suspension, keep the state in members.
+/// Unlike C++20 coroutines nothing is allocated, the effect object is the whole coroutine frame.
+///
+///   bool resume(double dt) override
+///   {
+///       EFFECT_BEGIN();
+///       for (flashes = 0; flashes < 3; ++flashes)
+///       {
+///           flashOn = !flashOn;
+///           EFFECT_SLEEP(0.1);
+///       }
+///       EFFECT_END();
+///   }
+///
+/// The line number identifies the suspension point, so use at most one suspension macro per line.
+class Effect
+{
+public:
+    Effect();
+    virtual ~Effect() {}
+
+    /// True from the EffectRunner::step() that picked up start() until the effect ends or is stopped.
+    /// Can be called from any task.
+    bool isActive() const;
+
+protected:
+    /// Runs the effect up to its next suspension point. Called by EffectRunner::step() on the render task.
+    /// @param dt Duration of the step [seconds]
+    /// @return false if the effect is done
+    virtual bool resume(double dt) = 0;
+
+    /// Called instead of resume() when the effect was stopped by EffectRunner::stop(), e.g. to undo what it changed
+    virtual void stopped() {}
+
+    /// Suspension point to continue at, 0 is the beginning. Only used by the EFFECT_ macros.
+    int resumePoint;
+
+    /// Time until the effect wants to be resumed again [seconds]. Set by EFFECT_SLEEP, counted down by EffectRunner.
+    double sleep;
+
+private:
+    friend class EffectRunner;
+
+    /// Next effect in the runner's list of active effects. Only touched by EffectRunner::step().
+    Effect* next;
+
+    /// Next effect in the runner's queue of started effects
+    Effect* nextStarted;
+
+    std::atomic<bool> active;
+    std::atomic<bool> queued;
+    std::atomic<bool> stopRequested;
+};
+
+/// Starts the body of resume()
+#define EFFECT_BEGIN() switch (resumePoint) { case 0:
+
+/// Suspends until the next step
+#define EFFECT_YIELD() do { resumePoint = __LINE__; return true; case __LINE__:; } while (0)
+
+/// Suspends until condition is true, checked once per step
+#define EFFECT_WAIT_UNTIL(condition) do { resumePoint = __LINE__; [[fallthrough]]; case __LINE__: if (!(condition)) { return true; } } while (0)
+
+/// Suspends for the given time [seconds]. The runner does not resume the effect in between.
+/// Rounded to whole steps, the remainder is carried over to the next sleep so periodic effects do not drift.
+#define EFFECT_SLEEP(seconds) do { sleep += (seconds); resumePoint = __LINE__; return true; case __LINE__:; } while (0)
+
+/// Ends the body of resume(), the effect is done when it gets here
+#define EFFECT_END() } resumePoint = 0; return false
+
+/// Resumes the active effects once per step. Effects that are not running are not in its list and cost nothing,
+/// so a step costs O(active effects). Sleeping effects tell when they are due, so the steps in between can be
+/// skipped altogether (see getTimeUntilResume()). Effects are started and stopped from any task, the changes are picked up by
+/// the next step() on the render task.
+class EffectRunner
+{
+public:
+    EffectRunner();
+
+    /// Starts the effect from the beginning with the next step(). Can be called from any task.
+    /// An effect that is still running continues where it is and is not stopped by an earlier stop().
+    void start(Effect& effect);
+
+    /// Stops the effect with the next step(). Can be called from any task.
+    void stop(Effect& effect);
+
+    /// Takes over started effects and resumes every active effect that does not sleep, in the order they were started.
+    /// @param dt Duration of the step [seconds]
+    void step(double dt);
+
+    /// Time until step() resumes an effect again [seconds], counted from the last step().
+    /// 0 if an effect resumes every step or was started or stopped since the last step(), INFINITY if no effect is active.
+    /// Only call from the task that calls step().
+    double getTimeUntilResume() const;
+
+    /// Lets time pass without a step: counts down the sleeping effects without resuming them.
+    /// @param time At most getTimeUntilResume() [seconds]
+    void skip(double time);
+
+private:
+    /// Effects that are running. Only touched by step().
+    Effect* active;
+
+    /// Effects started since the last step(), newest first
+    std::atomic<Effect*> started;
+};
+
+#endif
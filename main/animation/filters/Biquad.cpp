@@ -0,0 +1,30 @@
+#include "Biquad.h"
+
+Biquad::Biquad()
+    : coefficients{1, 0, 0, 0, 0}
+    , s1(0)
+    , s2(0)
+{}
+
+Biquad::Biquad(const Coefficients& coefficients)
+    : coefficients(coefficients)
+    , s1(0)
+    , s2(0)
+{}
+
+void Biquad::setCoefficients(const Coefficients& newCoefficients)
+{
+    coefficients = newCoefficients;
+}
+
+void Biquad::setInitialValues(float input, float output)
+{
+    // The state step() leaves behind when input and output did not change
+    s2 = coefficients.b2 * input - coefficients.a2 * output;
+    s1 = coefficients.b1 * input - coefficients.a1 * output + s2;
+}
+
+float Biquad::getDcGain() const
+{
+    return (coefficients.b0 + coefficients.b1 + coefficients.b2) / (1 + coefficients.a1 + coefficients.a2);
+}
@@ -0,0 +1,89 @@
+#ifndef BIQUAD_H
+#define BIQUAD_H
+
+#include <stddef.h>
+
+#include <array>
+
+/// Second order IIR section in transposed direct form II:
+///   y  = b0 x + s1
+///   s1 = b1 x - a1 y + s2
+///   s2 = b2 x - a2 y
+/// Two state variables instead of the four input and output histories of direct form I. Everything is float,
+/// the ESP32 FPU only does single precision in hardware. Get the coefficients from FilterDesigner.
+class Biquad
+{
+public:
+    /// Normalized to a0 = 1
+    struct Coefficients
+    {
+        float b0;
+        float b1;
+        float b2;
+        float a1;
+        float a2;
+    };
+
+    /// Passes the input through. The state is exactly zero.
+    Biquad();
+    explicit Biquad(const Coefficients& coefficients);
+
+    /// Keeps the state, the output continues from where it is
+    void setCoefficients(const Coefficients& coefficients);
+
+    /// Sets the state as if input and output had been constant at these values for a while.
+    /// (0, 0) is exactly zero, so is the output for a zero input from then on.
+    void setInitialValues(float input, float output);
+
+    /// Output for a constant input, (b0 + b1 + b2) / (1 + a1 + a2)
+    float getDcGain() const;
+
+    float step(float input)
+    {
+        const float output = coefficients.b0 * input + s1;
+        s1 = coefficients.b1 * input - coefficients.a1 * output + s2;
+        s2 = coefficients.b2 * input - coefficients.a2 * output;
+        return output;
+    }
+
+private:
+    Coefficients coefficients;
+    float s1;
+    float s2;
+};
+
+/// N sections in series for responses above second order, e.g. two critically damped sections for fourth order
+template <size_t N>
+class BiquadCascade
+{
+public:
+    void setCoefficients(size_t section, const Biquad::Coefficients& coefficients)
+    {
+        sections[section].setCoefficients(coefficients);
+    }
+
+    /// Sets every section to the steady state of a constant input
+    void setInitialValues(float input)
+    {
+        for (Biquad& section : sections)
+        {
+            const float output = input * section.getDcGain();
+            section.setInitialValues(input, output);
+            input = output;
+        }
+    }
+
+    float step(float input)
+    {
+        for (Biquad& section : sections)
+        {
+            input = section.step(input);
+        }
+        return input;
+    }
+
+private:
+    std::array<Biquad, N> sections;
+};
+
+#endif // BIQUAD_H
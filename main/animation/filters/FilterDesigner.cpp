@@ -0,0 +1,64 @@
+#include "FilterDesigner.h"
+
+#include <math.h>
+
+Biquad::Coefficients FilterDesigner::lowPass(Response response, float timeConstant, float sampleTime)
+{
+    // Faster than the samples can follow, the filter would only ring
+    if (timeConstant < sampleTime / 2)
+    {
+        return Biquad::Coefficients{1, 0, 0, 0, 0};
+    }
+
+    switch (response)
+    {
+    case CRITICALLY_DAMPED:
+        return criticallyDamped(timeConstant, sampleTime);
+    case BUTTERWORTH:
+        return butterworth(timeConstant, sampleTime);
+    case ONE_POLE:
+    default:
+        return onePole(timeConstant, sampleTime);
+    }
+}
+
+Biquad::Coefficients FilterDesigner::onePole(float timeConstant, float sampleTime)
+{
+    // Computed in double, the coefficients are only rounded to float once
+    const double k = 2.0 * timeConstant / sampleTime;
+    const double b = 1 / (1 + k);
+
+    Biquad::Coefficients coefficients;
+    coefficients.b0 = b;
+    coefficients.b1 = b;
+    coefficients.b2 = 0;
+    coefficients.a1 = (1 - k) / (1 + k);
+    coefficients.a2 = 0;
+    return coefficients;
+}
+
+Biquad::Coefficients FilterDesigner::criticallyDamped(float timeConstant, float sampleTime)
+{
+    return secondOrder(1.0 / timeConstant, 1, sampleTime);
+}
+
+Biquad::Coefficients FilterDesigner::butterworth(float timeConstant, float sampleTime)
+{
+    return secondOrder(1.0 / timeConstant, M_SQRT1_2, sampleTime);
+}
+
+Biquad::Coefficients FilterDesigner::secondOrder(double frequency, double damping, double sampleTime)
+{
+    // s = k (1 - z^-1) / (1 + z^-1)
+    const double k = 2 / sampleTime;
+    const double w2 = frequency * frequency;
+    const double a0 = k * k + 2 * damping * frequency * k + w2;
+
+    Biquad::Coefficients coefficients;
+    coefficients.b0 = w2 / a0;
+    coefficients.b1 = 2 * w2 / a0;
+    coefficients.b2 = w2 / a0;
+    coefficients.a1 = (2 * w2 - 2 * k * k) / a0;
+    coefficients.a2 = (k * k - 2 * damping * frequency * k + w2) / a0;
+    return coefficients;
+}
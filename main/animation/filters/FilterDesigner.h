@@ -0,0 +1,38 @@
+#ifndef FILTER_DESIGNER_H
+#define FILTER_DESIGNER_H
+
+#include <inttypes.h>
+
+#include "Biquad.h"
+
+/// Low pass coefficients for Biquad from time constants.
+/// The analog prototypes are discretized with the bilinear transform, all responses have a DC gain of 1.
+class FilterDesigner
+{
+public:
+    enum Response : uint8_t
+    {
+        ONE_POLE,           // 1 / (tau s + 1), the RC low pass. Starts moving at full speed.
+        CRITICALLY_DAMPED,  // 1 / (tau s + 1)^2, starts softly and arrives without overshoot
+        BUTTERWORTH,        // Second order with the flattest pass band, faster than critically damped but overshoots ~4 %
+        RESPONSE_COUNT
+    };
+
+    /// @param timeConstant tau [seconds], see Response. Below half a sample time the output follows the input.
+    /// @param sampleTime Time between two Biquad::step() [seconds]
+    static Biquad::Coefficients lowPass(Response response, float timeConstant, float sampleTime);
+
+    static Biquad::Coefficients onePole(float timeConstant, float sampleTime);
+
+    /// Two equal poles at -1 / timeConstant
+    static Biquad::Coefficients criticallyDamped(float timeConstant, float sampleTime);
+
+    /// Cutoff at 1 / timeConstant [rad/s]
+    static Biquad::Coefficients butterworth(float timeConstant, float sampleTime);
+
+private:
+    /// w^2 / (s^2 + 2 damping w s + w^2)
+    static Biquad::Coefficients secondOrder(double frequency, double damping, double sampleTime);
+};
+
+#endif // FILTER_DESIGNER_H
@@ -0,0 +1,64 @@
+#include "LowPass.h"
+
+#include <math.h>
+
+LowPass::LowPass()
+    : lastInput(0)
+    , lastOutput(0)
+    , settled(false)
+{}
+
+LowPass::LowPass(const Biquad::Coefficients& coefficients)
+    : biquad(coefficients)
+    , lastInput(0)
+    , lastOutput(0)
+    , settled(false)
+{}
+
+void LowPass::setCoefficients(const Biquad::Coefficients& coefficients)
+{
+    biquad.setCoefficients(coefficients);
+
+    // The state of the old response is not the steady state of the new one
+    biquad.setInitialValues(lastInput, lastOutput);
+    settled = false;
+}
+
+void LowPass::setInitialValues(float input, float output)
+{
+    biquad.setInitialValues(input, output);
+    lastInput = input;
+    lastOutput = output;
+    settled = false;
+}
+
+float LowPass::step(float input, float tolerance)
+{
+    if (settled && input == lastInput)
+    {
+        return lastOutput;
+    }
+
+    float output = biquad.step(input);
+
+    if (input == lastInput && fabsf(output - input) < tolerance && fabsf(output - lastOutput) < tolerance)
+    {
+        // Snap to the target so the filter holds it exactly instead of creeping towards it forever
+        biquad.setInitialValues(input, input);
+        settled = true;
+        output = input;
+    }
+    else
+    {
+        settled = false;
+    }
+
+    lastInput = input;
+    lastOutput = output;
+    return output;
+}
+
+bool LowPass::isSettled() const
+{
+    return settled;
+}
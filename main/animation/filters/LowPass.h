@@ -0,0 +1,36 @@
+#ifndef LOW_PASS_H
+#define LOW_PASS_H
+
+#include "Biquad.h"
+
+/// Smooths the transitions of a light value: a Biquad low pass that stops being computed once it reached its input.
+/// Get the coefficients from FilterDesigner, they need a DC gain of 1. The default passes the input through.
+class LowPass
+{
+public:
+    LowPass();
+    explicit LowPass(const Biquad::Coefficients& coefficients);
+
+    /// Changes the response, the output continues from where it is
+    void setCoefficients(const Biquad::Coefficients& coefficients);
+
+    /// See Biquad::setInitialValues()
+    void setInitialValues(float input, float output);
+
+    /// Skips the filter math once the output has converged.
+    /// The filter counts as settled when the input did not change since the last step and the output is within
+    /// tolerance of the input and hardly moves any more, a second order response may still be passing through.
+    /// From then on it outputs exactly the input until the input changes.
+    float step(float input, float tolerance);
+
+    /// @return true if the output converged to the input (see step())
+    bool isSettled() const;
+
+private:
+    Biquad biquad;
+    float lastInput;
+    float lastOutput;
+    bool settled;
+};
+
+#endif // LOW_PASS_H
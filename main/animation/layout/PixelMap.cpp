@@ -0,0 +1,114 @@
+#include "PixelMap.h"
+
+PixelMapBase::PixelMapBase(uint16_t* table, size_t ledCount)
+    : table(table)
+    , ledCount(ledCount)
+    , width(0)
+    , height(0)
+{
+    makeLine(ledCount);
+}
+
+size_t PixelMapBase::getWidth() const
+{
+    return width;
+}
+
+size_t PixelMapBase::getHeight() const
+{
+    return height;
+}
+
+size_t PixelMapBase::getPixelCount() const
+{
+    return width * height;
+}
+
+size_t PixelMapBase::getLEDCount() const
+{
+    return ledCount;
+}
+
+void PixelMapBase::makeLine(size_t pixelCount, bool reversed)
+{
+    reset(pixelCount, 1);
+
+    for (size_t i = 0; i < ledCount && i < pixelCount; ++i)
+    {
+        table[i] = reversed ? pixelCount - 1 - i : i;
+    }
+}
+
+void PixelMapBase::makeMatrix(size_t matrixWidth, size_t matrixHeight, int wiring)
+{
+    reset(matrixWidth, matrixHeight);
+
+    // A run is the part of the strip along one row (or column)
+    const bool columns = wiring & COLUMNS;
+    const size_t runLength = columns ? height : width;
+
+    for (size_t i = 0; i < ledCount && i < width * height; ++i)
+    {
+        const size_t run = i / runLength;
+        size_t along = i % runLength;
+        if ((wiring & SERPENTINE) && run % 2 == 1)
+        {
+            along = runLength - 1 - along;
+        }
+
+        size_t x = columns ? run : along;
+        size_t y = columns ? along : run;
+        if (wiring & FLIP_X)
+        {
+            x = width - 1 - x;
+        }
+        if (wiring & FLIP_Y)
+        {
+            y = height - 1 - y;
+        }
+
+        table[i] = pixelIndex(x, y);
+    }
+}
+
+void PixelMapBase::makeRings(const uint16_t* ledsPerRing, size_t ringCount, size_t columns)
+{
+    reset(columns, ringCount);
+
+    size_t led = 0;
+    for (size_t ring = 0; ring < height; ++ring)
+    {
+        const size_t count = ledsPerRing[ring];
+        for (size_t j = 0; j < count && led < ledCount; ++j, ++led)
+        {
+            // Nearest column to the angle of the LED
+            const size_t x = ((j * columns + count / 2) / count) % columns;
+            table[led] = pixelIndex(x, ring);
+        }
+    }
+}
+
+void PixelMapBase::set(size_t led, size_t x, size_t y)
+{
+    if (led < ledCount && x < width && y < height)
+    {
+        table[led] = pixelIndex(x, y);
+    }
+}
+
+void PixelMapBase::reset(size_t newWidth, size_t newHeight)
+{
+    // Pixel indices have to fit into the table entries
+    if (newWidth * newHeight >= UNMAPPED)
+    {
+        newHeight = newWidth > 0 ? (UNMAPPED - 1) / newWidth : 0;
+    }
+
+    width = newWidth;
+    height = newHeight;
+
+    for (size_t i = 0; i < ledCount; ++i)
+    {
+        table[i] = UNMAPPED;
+    }
+}
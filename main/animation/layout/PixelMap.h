@@ -0,0 +1,97 @@
+#ifndef PIXEL_MAP_H
+#define PIXEL_MAP_H
+
+#include <inttypes.h>
+#include <stddef.h>
+
+#include <array>
+
+/// Maps the LEDs of the strip to pixels of a logical 2D framebuffer (row major, width * height pixels).
+/// Effects render into the framebuffer without knowing how the strip is laid out. The output stage reads
+/// the pixel of every LED through the table while it looks up the output values, so remapping costs one
+/// indexed load per LED instead of a separate pass.
+/// The table is built once at start up by one of the make functions.
+/// Use PixelMap<N> to get a map with its own table. Use this type to refer to a map of any size.
+class PixelMapBase
+{
+public:
+    /// Source of LEDs that do not show any pixel. They are black.
+    static const uint16_t UNMAPPED = 0xFFFF;
+
+    /// How a matrix is wired
+    enum Wiring
+    {
+        ROWS = 0,               // The strip runs along the rows, starting top left
+        COLUMNS = 1 << 0,       // The strip runs along the columns
+        SERPENTINE = 1 << 1,    // Every other row (column) runs backwards
+        FLIP_X = 1 << 2,        // Starts on the right
+        FLIP_Y = 1 << 3         // Starts at the bottom
+    };
+
+    /// Pixel shown by an LED, UNMAPPED for none
+    uint16_t operator[](size_t led) const
+    {
+        return table[led];
+    }
+
+    /// Index of a pixel in the framebuffer
+    size_t pixelIndex(size_t x, size_t y) const
+    {
+        return y * width + x;
+    }
+
+    size_t getWidth() const;
+    size_t getHeight() const;
+    /// Number of framebuffer pixels (width * height)
+    size_t getPixelCount() const;
+    size_t getLEDCount() const;
+
+    /// Straight line, LED i shows pixel i. Pixels and LEDs left over on either side stay unmapped.
+    /// @param reversed LED 0 shows the last pixel
+    void makeLine(size_t pixelCount, bool reversed = false);
+
+    /// Matrix of width * height LEDs
+    /// @param wiring Combination of Wiring flags
+    void makeMatrix(size_t matrixWidth, size_t matrixHeight, int wiring);
+
+    /// Concentric rings wired one after the other. The framebuffer has one row per ring, every LED shows
+    /// the pixel closest to its angle, so effects can treat rings of different size alike.
+    /// @param ledsPerRing LED count of every ring, starting with the first ring of the strip
+    /// @param columns Framebuffer width, usually the LED count of the largest ring
+    void makeRings(const uint16_t* ledsPerRing, size_t ringCount, size_t columns);
+
+    /// Lets one LED show a pixel of the current layout, e.g. to fix up a single wiring mistake
+    void set(size_t led, size_t x, size_t y);
+
+protected:
+    /// Storage is owned by the derived class. Starts as a line.
+    PixelMapBase(uint16_t* table, size_t ledCount);
+
+private:
+    /// Sets the layout size and unmaps all LEDs
+    void reset(size_t newWidth, size_t newHeight);
+
+    uint16_t* table;
+    const size_t ledCount;
+    size_t width;
+    size_t height;
+};
+
+template <size_t N>
+struct PixelMapStorage
+{
+    std::array<uint16_t, N> mapTable;
+};
+
+/// Pixel map for N LEDs
+template <size_t N>
+class PixelMap : private PixelMapStorage<N>, public PixelMapBase
+{
+public:
+    PixelMap()
+        : PixelMapStorage<N>()
+        , PixelMapBase(this->mapTable.data(), N)
+    {}
+};
+
+#endif // PIXEL_MAP_H
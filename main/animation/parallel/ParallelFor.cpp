@@ -0,0 +1,122 @@
+#include "ParallelFor.h"
+
+#ifdef ESP_PLATFORM
+
+ParallelFor::ParallelFor(int workerCore, unsigned priority)
+    : job(NULL)
+    , context(NULL)
+    , count(0)
+    , workerTask(NULL)
+    , callerTask(NULL)
+{
+    xTaskCreatePinnedToCore(&ParallelFor::worker, "parallelFor", 3072, this, priority, &workerTask, workerCore);
+}
+
+ParallelFor::~ParallelFor()
+{
+    vTaskDelete(workerTask);
+}
+
+void ParallelFor::run(size_t itemCount, Job newJob, void* newContext)
+{
+    job = newJob;
+    context = newContext;
+    count = itemCount;
+    callerTask = xTaskGetCurrentTaskHandle();
+
+    // Task notifications are full memory barriers, the worker sees the job we just wrote
+    xTaskNotifyGive(workerTask);
+
+    size_t begin, end;
+    split(count, PARTS, 0, ALIGN, begin, end);
+    job(context, begin, end, 0);
+
+    ulTaskNotifyTake(pdTRUE, portMAX_DELAY);
+}
+
+void ParallelFor::worker(void* args)
+{
+    ParallelFor* instance = static_cast<ParallelFor*>(args);
+
+    while (true)
+    {
+        ulTaskNotifyTake(pdTRUE, portMAX_DELAY);
+
+        size_t begin, end;
+        split(instance->count, PARTS, 1, ALIGN, begin, end);
+        instance->job(instance->context, begin, end, 1);
+
+        xTaskNotifyGive(instance->callerTask);
+    }
+}
+
+#else
+
+ParallelFor::ParallelFor(int, unsigned)
+    : job(NULL)
+    , context(NULL)
+    , count(0)
+    , start(0)
+    , done(0)
+    , stopping(false)
+    , workerThread(&ParallelFor::worker, this)
+{}
+
+ParallelFor::~ParallelFor()
+{
+    stopping = true;
+    start.release();
+    workerThread.join();
+}
+
+void ParallelFor::run(size_t itemCount, Job newJob, void* newContext)
+{
+    job = newJob;
+    context = newContext;
+    count = itemCount;
+
+    start.release();
+
+    size_t begin, end;
+    split(count, PARTS, 0, ALIGN, begin, end);
+    job(context, begin, end, 0);
+
+    done.acquire();
+}
+
+void ParallelFor::worker(void* args)
+{
+    ParallelFor* instance = static_cast<ParallelFor*>(args);
+
+    while (true)
+    {
+        instance->start.acquire();
+        if (instance->stopping)
+        {
+            return;
+        }
+
+        size_t begin, end;
+        split(instance->count, PARTS, 1, ALIGN, begin, end);
+        instance->job(instance->context, begin, end, 1);
+
+        instance->done.release();
+    }
+}
+
+#endif
+
+void ParallelFor::split(size_t count, size_t parts, size_t part, size_t align, size_t& begin, size_t& end)
+{
+    // Whole blocks of align items are distributed as evenly as possible, the last part also gets the remainder
+    const size_t blocks = count / align;
+    const size_t blocksPerPart = blocks / parts;
+    const size_t extraBlocks = blocks % parts;
+
+    begin = (part * blocksPerPart + (part < extraBlocks ? part : extraBlocks)) * align;
+    end = ((part + 1) * blocksPerPart + (part + 1 < extraBlocks ? part + 1 : extraBlocks)) * align;
+    if (part == parts - 1)
+    {
+        end = count;
+    }
+}
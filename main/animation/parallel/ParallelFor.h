@@ -0,0 +1,65 @@
+#ifndef PARALLEL_FOR_H
+#define PARALLEL_FOR_H
+
+#include <inttypes.h>
+#include <stddef.h>
+
+#ifdef ESP_PLATFORM
+#include <freertos/FreeRTOS.h>
+#include <freertos/task.h>
+#else
+#include <semaphore>
+#include <thread>
+#endif
+
+/// Splits a loop over independent items between the calling task and a worker task on the other core.
+/// run() forks the second half of the range to the worker, renders the first half itself and blocks until
+/// the worker is done (fork/join). The worker sleeps on a task notification in between, so it costs nothing
+/// while idle. Only worth it for loops that take a lot longer than the two context switches (~20 us).
+/// On the host the worker is a std::thread, so the split can be tested there.
+class ParallelFor
+{
+public:
+    /// Number of parts a range is split into, one per core
+    static const size_t PARTS = 2;
+
+    /// Work on the items [begin, end). part is 0 for the calling task and 1 for the worker.
+    typedef void (*Job)(void* context, size_t begin, size_t end, size_t part);
+
+    /// Starts the worker task
+    /// @param workerCore Core the worker is pinned to, the other one than the caller of run()
+    /// @param priority Worker priority, usually the priority of the caller of run()
+    ParallelFor(int workerCore, unsigned priority);
+    ~ParallelFor();
+
+    /// Runs job on [0, count), split into PARTS parts. Returns once all parts are done.
+    /// Not reentrant, only one task may call run().
+    void run(size_t count, Job job, void* context);
+
+    /// Range of one part when count items are split into parts parts
+    /// @param align Part boundaries are multiples of this, so parts do not share cache lines
+    static void split(size_t count, size_t parts, size_t part, size_t align, size_t& begin, size_t& end);
+
+    /// Part boundary alignment in items
+    static const size_t ALIGN = 8;
+
+private:
+    static void worker(void* args);
+
+    /// Job of the current run(), written before the worker is notified
+    Job job;
+    void* context;
+    size_t count;
+
+#ifdef ESP_PLATFORM
+    TaskHandle_t workerTask;
+    TaskHandle_t callerTask;
+#else
+    std::binary_semaphore start;
+    std::binary_semaphore done;
+    bool stopping;
+    std::thread workerThread;
+#endif
+};
+
+#endif // PARALLEL_FOR_H
@@ -0,0 +1,242 @@
+#include "PixelShader.h"
+
+#include <math.h>
+#include <string.h>
+
+static const float TWO_PI = 6.28318530718f;
+
+PixelShader::PixelShader()
+    : time(0)
+    , pendingReady(false)
+{
+    active.constantCount = 0;
+    active.instructionCount = 0;
+    active.instructions[0].opcode = END;
+    pending = active;
+
+    memset(slots, 0, sizeof(slots));
+    memset(batch, 0, sizeof(batch));
+}
+
+bool PixelShader::parse(const uint8_t* buffer, size_t size, Program& program)
+{
+    const size_t INSTRUCTION_SIZE = 4;
+
+    size_t offset = 0;
+    if (size < 2)
+    {
+        return false;
+    }
+
+    program.constantCount = buffer[offset++];
+    if (program.constantCount > MAX_CONSTANTS || offset + program.constantCount * sizeof(float) + 1 > size)
+    {
+        return false;
+    }
+    memcpy(program.constants, &buffer[offset], program.constantCount * sizeof(float));
+    offset += program.constantCount * sizeof(float);
+
+    program.instructionCount = buffer[offset++];
+    if (program.instructionCount > MAX_INSTRUCTIONS || offset + program.instructionCount * INSTRUCTION_SIZE != size)
+    {
+        return false;
+    }
+
+    const size_t operandCount = REGISTER_COUNT + program.constantCount;
+    for (size_t i = 0; i < program.instructionCount; ++i)
+    {
+        Instruction& instruction = program.instructions[i];
+        memcpy(&instruction, &buffer[offset], INSTRUCTION_SIZE);
+        offset += INSTRUCTION_SIZE;
+
+        // Constants are read only, all other operands must exist
+        if (instruction.opcode >= OPCODE_COUNT || instruction.dst >= REGISTER_COUNT
+        ||  instruction.a >= operandCount || instruction.b >= operandCount)
+        {
+            return false;
+        }
+    }
+    program.instructions[program.instructionCount].opcode = END;
+
+    return true;
+}
+
+bool PixelShader::load(const uint8_t* buffer, size_t size)
+{
+    if (pendingReady || !parse(buffer, size, pending))
+    {
+        return false;
+    }
+
+    pendingReady = true;
+    return true;
+}
+
+bool PixelShader::isActive() const
+{
+    return active.instructionCount > 0;
+}
+
+void PixelShader::adopt(const Program& program)
+{
+    active = program;
+    time = 0;
+
+    // Constants never change while a program runs, so they are only written once
+    for (size_t k = 0; k < active.constantCount; ++k)
+    {
+        slots[REGISTER_COUNT + k] = active.constants[k];
+        for (size_t lane = 0; lane < BATCH_SIZE; ++lane)
+        {
+            batch[REGISTER_COUNT + k][lane] = active.constants[k];
+        }
+    }
+}
+
+void PixelShader::run(ColorConverter::rgbcct* pixels, size_t count, double dt, float brightness, bool batched)
+{
+    if (pendingReady)
+    {
+        adopt(pending);
+        pendingReady = false;
+    }
+    else
+    {
+        time += dt;
+    }
+
+    if (!isActive())
+    {
+        return;
+    }
+
+    const float positionScale = count > 1 ? 1.0f / (count - 1) : 0.0f;
+
+    if (!batched)
+    {
+        for (size_t i = 0; i < count; ++i)
+        {
+            ColorConverter::rgbcct& pixel = pixels[i];
+            slots[INDEX] = i;
+            slots[POSITION] = i * positionScale;
+            slots[TIME] = time;
+            slots[RED] = pixel.color.r;
+            slots[GREEN] = pixel.color.g;
+            slots[BLUE] = pixel.color.b;
+            slots[WARM] = pixel.ww;
+            slots[COLD] = pixel.cw;
+            slots[BRIGHTNESS] = brightness;
+            for (size_t r = BRIGHTNESS + 1; r < REGISTER_COUNT; ++r)
+            {
+                slots[r] = 0;
+            }
+
+            runPixel(active.instructions, slots);
+
+            pixel = ColorConverter::rgbcct(ColorConverter::rgb(slots[RED], slots[GREEN], slots[BLUE]), slots[WARM], slots[COLD]);
+        }
+        return;
+    }
+
+    for (size_t begin = 0; begin < count; begin += BATCH_SIZE)
+    {
+        const size_t lanes = count - begin < BATCH_SIZE ? count - begin : BATCH_SIZE;
+
+        for (size_t lane = 0; lane < lanes; ++lane)
+        {
+            const size_t i = begin + lane;
+            const ColorConverter::rgbcct& pixel = pixels[i];
+            batch[INDEX][lane] = i;
+            batch[POSITION][lane] = i * positionScale;
+            batch[TIME][lane] = time;
+            batch[RED][lane] = pixel.color.r;
+            batch[GREEN][lane] = pixel.color.g;
+            batch[BLUE][lane] = pixel.color.b;
+            batch[WARM][lane] = pixel.ww;
+            batch[COLD][lane] = pixel.cw;
+            batch[BRIGHTNESS][lane] = brightness;
+        }
+        for (size_t r = BRIGHTNESS + 1; r < REGISTER_COUNT; ++r)
+        {
+            for (size_t lane = 0; lane < BATCH_SIZE; ++lane)
+            {
+                batch[r][lane] = 0;
+            }
+        }
+
+        // Unused lanes of the last batch compute garbage that is never written back
+        runBatch();
+
+        for (size_t lane = 0; lane < lanes; ++lane)
+        {
+            pixels[begin + lane] = ColorConverter::rgbcct(ColorConverter::rgb(batch[RED][lane], batch[GREEN][lane], batch[BLUE][lane]),
+                                                          batch[WARM][lane], batch[COLD][lane]);
+        }
+    }
+}
+
+void PixelShader::runPixel(const Instruction* code, float* slots)
+{
+    // Threaded dispatch: every handler jumps straight to the handler of the next instruction
+    // instead of going back through a central switch.
+    static const void* const handlers[OPCODE_COUNT] =
+    {
+        &&opEnd, &&opMov, &&opAdd, &&opSub, &&opMul, &&opDiv, &&opMin,
+        &&opMax, &&opMad, &&opMix, &&opFract, &&opAbs, &&opSin, &&opStep
+    };
+
+    const Instruction* pc = code;
+    float* r = slots;
+
+#define DISPATCH() goto *handlers[pc->opcode]
+#define NEXT() do { ++pc; DISPATCH(); } while (0)
+
+    DISPATCH();
+
+opMov:   r[pc->dst] = r[pc->a]; NEXT();
+opAdd:   r[pc->dst] = r[pc->a] + r[pc->b]; NEXT();
+opSub:   r[pc->dst] = r[pc->a] - r[pc->b]; NEXT();
+opMul:   r[pc->dst] = r[pc->a] * r[pc->b]; NEXT();
+opDiv:   r[pc->dst] = r[pc->b] != 0 ? r[pc->a] / r[pc->b] : 0; NEXT();
+opMin:   r[pc->dst] = r[pc->a] < r[pc->b] ? r[pc->a] : r[pc->b]; NEXT();
+opMax:   r[pc->dst] = r[pc->a] > r[pc->b] ? r[pc->a] : r[pc->b]; NEXT();
+opMad:   r[pc->dst] = r[pc->dst] + r[pc->a] * r[pc->b]; NEXT();
+opMix:   r[pc->dst] = r[pc->a] + (r[pc->b] - r[pc->a]) * r[pc->dst]; NEXT();
+opFract: r[pc->dst] = r[pc->a] - floorf(r[pc->a]); NEXT();
+opAbs:   r[pc->dst] = fabsf(r[pc->a]); NEXT();
+opSin:   r[pc->dst] = sinf(TWO_PI * r[pc->a]); NEXT();
+opStep:  r[pc->dst] = r[pc->a] < r[pc->b] ? 0 : 1; NEXT();
+opEnd:   return;
+
+#undef NEXT
+#undef DISPATCH
+}
+
+void PixelShader::runBatch()
+{
+    for (const Instruction* pc = active.instructions; pc->opcode != END; ++pc)
+    {
+        float* dst = batch[pc->dst];
+        const float* a = batch[pc->a];
+        const float* b = batch[pc->b];
+
+        // dst may alias a or b (e.g. ADD R9 R9 R1). Every lane only reads its own column before writing it, so this is fine.
+        switch (pc->opcode)
+        {
+        case MOV:   for (size_t l = 0; l < BATCH_SIZE; ++l) dst[l] = a[l]; break;
+        case ADD:   for (size_t l = 0; l < BATCH_SIZE; ++l) dst[l] = a[l] + b[l]; break;
+        case SUB:   for (size_t l = 0; l < BATCH_SIZE; ++l) dst[l] = a[l] - b[l]; break;
+        case MUL:   for (size_t l = 0; l < BATCH_SIZE; ++l) dst[l] = a[l] * b[l]; break;
+        case DIV:   for (size_t l = 0; l < BATCH_SIZE; ++l) dst[l] = b[l] != 0 ? a[l] / b[l] : 0; break;
+        case MIN:   for (size_t l = 0; l < BATCH_SIZE; ++l) dst[l] = a[l] < b[l] ? a[l] : b[l]; break;
+        case MAX:   for (size_t l = 0; l < BATCH_SIZE; ++l) dst[l] = a[l] > b[l] ? a[l] : b[l]; break;
+        case MAD:   for (size_t l = 0; l < BATCH_SIZE; ++l) dst[l] = dst[l] + a[l] * b[l]; break;
+        case MIX:   for (size_t l = 0; l < BATCH_SIZE; ++l) dst[l] = a[l] + (b[l] - a[l]) * dst[l]; break;
+        case FRACT: for (size_t l = 0; l < BATCH_SIZE; ++l) dst[l] = a[l] - floorf(a[l]); break;
+        case ABS:   for (size_t l = 0; l < BATCH_SIZE; ++l) dst[l] = fabsf(a[l]); break;
+        case SIN:   for (size_t l = 0; l < BATCH_SIZE; ++l) dst[l] = sinf(TWO_PI * a[l]); break;
+        case STEP:  for (size_t l = 0; l < BATCH_SIZE; ++l) dst[l] = a[l] < b[l] ? 0 : 1; break;
+        default: break;
+        }
+    }
+}
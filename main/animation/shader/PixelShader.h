@@ -0,0 +1,128 @@
+#ifndef PIXEL_SHADER_H
+#define PIXEL_SHADER_H
+
+#include <inttypes.h>
+#include <stddef.h>
+
+#include <atomic>
+
+#include "../colors/ColorConverter.h"
+
+/// Small register based bytecode interpreter that runs a program for every pixel.
+/// Lets us deploy new effects over the network without rebuilding the firmware.
+/// Runs after CarLight::step() on the rendered pixels.
+///
+/// The program works on 16 float registers plus up to 32 constants. Operands 0-15 address registers,
+/// operands 16-47 address constants. On entry the registers hold:
+///   R0 pixel index, R1 position on the strip [0, 1], R2 time since the program was loaded [s],
+///   R3-R7 pixel color red, green, blue, warm, cold [0, 1], R8 color brightness [0, 1]
+///   R9-R15 0, nothing carries over from the previous pixel, so both modes of run() compute the same
+/// On exit R3-R7 are written back to the pixel. An empty program therefore leaves the pixels untouched.
+///
+/// Binary program format (little endian):
+///   uint8 constantCount, float constants[constantCount], uint8 instructionCount, Instruction[instructionCount]
+///   Instruction: uint8 opcode, uint8 dst, uint8 a, uint8 b
+/// tools/shader_asm.cpp assembles programs from text.
+class PixelShader
+{
+public:
+    enum Opcode
+    {
+        END,    // Stop
+        MOV,    // dst = a
+        ADD,    // dst = a + b
+        SUB,    // dst = a - b
+        MUL,    // dst = a * b
+        DIV,    // dst = a / b, 0 if b is 0
+        MIN,    // dst = min(a, b)
+        MAX,    // dst = max(a, b)
+        MAD,    // dst = dst + a * b
+        MIX,    // dst = a + (b - a) * dst
+        FRACT,  // dst = a - floor(a)
+        ABS,    // dst = |a|
+        SIN,    // dst = sin(2 * pi * a)
+        STEP,   // dst = a < b ? 0 : 1
+        OPCODE_COUNT
+    };
+
+    enum Register
+    {
+        INDEX,
+        POSITION,
+        TIME,
+        RED,
+        GREEN,
+        BLUE,
+        WARM,
+        COLD,
+        BRIGHTNESS,
+        REGISTER_COUNT = 16
+    };
+
+    static const size_t MAX_CONSTANTS = 32;
+    static const size_t MAX_INSTRUCTIONS = 64;
+    static const size_t SLOT_COUNT = REGISTER_COUNT + MAX_CONSTANTS;
+
+    /// Number of pixels that run in lock step in batched mode
+    static const size_t BATCH_SIZE = 16;
+
+    struct Instruction
+    {
+        uint8_t opcode;
+        uint8_t dst;
+        uint8_t a;
+        uint8_t b;
+    };
+
+    struct Program
+    {
+        uint8_t constantCount;
+        float constants[MAX_CONSTANTS];
+        uint8_t instructionCount;
+        Instruction instructions[MAX_INSTRUCTIONS + 1]; // Always terminated by END
+    };
+
+    PixelShader();
+
+    /// Parses and validates a binary program
+    /// @return false if the program is malformed or too big
+    static bool parse(const uint8_t* buffer, size_t size, Program& program);
+
+    /// Replaces the current program. Called from the network task, the program starts with the next run().
+    /// An empty program turns the shader off.
+    /// @return false if the program is invalid or the previous upload was not picked up yet
+    bool load(const uint8_t* buffer, size_t size);
+
+    /// Runs the program on all pixels
+    /// @param dt Time since the last run [seconds]
+    /// @param batched Run one instruction across a batch of pixels before moving to the next instruction
+    ///                instead of running the whole program pixel by pixel. Faster for long programs.
+    void run(ColorConverter::rgbcct* pixels, size_t count, double dt, float brightness, bool batched = true);
+
+    /// @return true if a program is loaded
+    bool isActive() const;
+
+private:
+    /// Runs the whole program for the pixel whose inputs are in slots (threaded dispatch)
+    static void runPixel(const Instruction* code, float* slots);
+
+    /// Runs the whole program for BATCH_SIZE pixels whose inputs are in batch
+    void runBatch();
+
+    void adopt(const Program& program);
+
+    Program active;
+    double time;
+
+    /// Registers and constants for pixel by pixel mode
+    float slots[SLOT_COUNT];
+
+    /// Registers and constants for batched mode, one row per slot
+    float batch[SLOT_COUNT][BATCH_SIZE];
+
+    /// Uploaded program, waiting for the next run() to take it over
+    Program pending;
+    std::atomic<bool> pendingReady;
+};
+
+#endif // PIXEL_SHADER_H
@@ -0,0 +1,274 @@
+#include "Timeline.h"
+
+#include <string.h>
+
+#include <esp_log.h>
+
+Timeline::Timeline()
+    : runningCount(0)
+    , pendingReady(false)
+    , stopRequested(false)
+{
+    active.trackCount = 0;
+    active.keyframeCount = 0;
+    pending.trackCount = 0;
+    pending.keyframeCount = 0;
+}
+
+bool Timeline::load(const uint8_t* buffer, size_t size)
+{
+    if (pendingReady)
+    {
+        ESP_LOGI("Timeline", "Previous script was not started yet");
+        return false;
+    }
+
+    if (!parse(buffer, size, pending))
+    {
+        ESP_LOGI("Timeline", "Script is invalid");
+        return false;
+    }
+
+    pendingReady = true;
+    return true;
+}
+
+void Timeline::stop()
+{
+    stopRequested = true;
+}
+
+bool Timeline::isPlaying() const
+{
+    return runningCount > 0;
+}
+
+bool Timeline::parse(const uint8_t* buffer, size_t size, Script& script)
+{
+    const size_t TRACK_HEADER_SIZE = 4;
+    const size_t KEYFRAME_SIZE = 5;
+
+    if (size < 1)
+    {
+        return false;
+    }
+
+    script.trackCount = buffer[0];
+    script.keyframeCount = 0;
+    if (script.trackCount > MAX_TRACKS)
+    {
+        return false;
+    }
+
+    size_t offset = 1;
+    for (size_t t = 0; t < script.trackCount; ++t)
+    {
+        if (offset + TRACK_HEADER_SIZE > size)
+        {
+            return false;
+        }
+
+        Track& track = script.tracks[t];
+        track.target = buffer[offset];
+        track.segment = buffer[offset + 1];
+        track.loopStart = buffer[offset + 2];
+        track.keyframeCount = buffer[offset + 3];
+        track.firstKeyframe = script.keyframeCount;
+        track.current = 0;
+        track.elapsed = 0;
+        offset += TRACK_HEADER_SIZE;
+
+        if (track.target >= TARGET_COUNT || track.keyframeCount == 0
+        ||  script.keyframeCount + track.keyframeCount > MAX_KEYFRAMES
+        ||  offset + track.keyframeCount * KEYFRAME_SIZE > size)
+        {
+            return false;
+        }
+
+        uint32_t loopDuration = 0;
+        for (size_t k = 0; k < track.keyframeCount; ++k)
+        {
+            Keyframe& keyframe = script.keyframes[script.keyframeCount++];
+            memcpy(&keyframe.duration, &buffer[offset], sizeof(uint16_t));
+            memcpy(&keyframe.value, &buffer[offset + 2], sizeof(uint16_t));
+            keyframe.easing = buffer[offset + 4];
+            offset += KEYFRAME_SIZE;
+
+            if (keyframe.easing >= EASING_COUNT)
+            {
+                return false;
+            }
+            if (track.loopStart != NO_LOOP && k > track.loopStart)
+            {
+                loopDuration += keyframe.duration;
+            }
+        }
+
+        // A loop without duration would spin forever within a single step
+        if (track.loopStart != NO_LOOP && (track.loopStart >= track.keyframeCount || loopDuration == 0))
+        {
+            return false;
+        }
+    }
+
+    return offset == size;
+}
+
+void Timeline::step(double dt, CarLightBase& light)
+{
+    CarLightBase* const segments[] = {&light};
+    step(dt, segments, 1);
+}
+
+void Timeline::step(double dt, CarLightBase* const* segments, size_t segmentCount)
+{
+    if (segmentCount > SegmentedLightBase::MAX_SEGMENTS)
+    {
+        segmentCount = SegmentedLightBase::MAX_SEGMENTS;
+    }
+
+    if (stopRequested)
+    {
+        runningCount = 0;
+        stopRequested = false;
+    }
+
+    if (pendingReady)
+    {
+        active = pending;
+        runningCount = 0;
+        for (size_t t = 0; t < active.trackCount; ++t)
+        {
+            running[runningCount++] = t;
+        }
+        pendingReady = false;
+    }
+
+    if (runningCount == 0)
+    {
+        return;
+    }
+
+    const float dtMillis = dt * 1000;
+
+    // Collect all values first so a color is only set once even if several tracks animate it.
+    // Row 0 is the whole light, row n is segment n - 1.
+    float values[1 + SegmentedLightBase::MAX_SEGMENTS][TARGET_COUNT];
+    bool changed[1 + SegmentedLightBase::MAX_SEGMENTS][TARGET_COUNT] = {};
+
+    size_t stillRunning = 0;
+    for (size_t r = 0; r < runningCount; ++r)
+    {
+        Track& track = active.tracks[running[r]];
+        const Keyframe* keyframes = &active.keyframes[track.firstKeyframe];
+
+        track.elapsed += dtMillis;
+
+        bool finished = false;
+        while (true)
+        {
+            if (track.current + 1 >= track.keyframeCount)
+            {
+                if (track.loopStart == NO_LOOP)
+                {
+                    finished = true;
+                    break;
+                }
+                track.current = track.loopStart;
+            }
+            else if (track.elapsed >= keyframes[track.current + 1].duration)
+            {
+                track.elapsed -= keyframes[track.current + 1].duration;
+                track.current++;
+            }
+            else
+            {
+                break;
+            }
+        }
+
+        if (track.segment <= segmentCount)
+        {
+            values[track.segment][track.target] = evaluate(track);
+            changed[track.segment][track.target] = true;
+        }
+
+        if (!finished)
+        {
+            running[stillRunning++] = running[r];
+        }
+    }
+    runningCount = stillRunning;
+
+    for (size_t segment = 1; segment <= segmentCount; ++segment)
+    {
+        for (size_t target = 0; target < TARGET_COUNT; ++target)
+        {
+            if (!changed[segment][target] && changed[0][target])
+            {
+                values[segment][target] = values[0][target];
+                changed[segment][target] = true;
+            }
+        }
+        apply(*segments[segment - 1], values[segment], changed[segment]);
+    }
+}
+
+void Timeline::apply(CarLightBase& light, const float* values, const bool* changed)
+{
+    if (changed[COLOR_BRIGHTNESS])
+    {
+        light.setColorBrightness(values[COLOR_BRIGHTNESS]);
+    }
+    if (changed[WHITE_BRIGHTNESS])
+    {
+        light.setWhiteBrightness(values[WHITE_BRIGHTNESS]);
+    }
+    if (changed[RED] || changed[GREEN] || changed[BLUE])
+    {
+        ColorConverter::rgb color = light.getColor();
+        light.setColor(changed[RED]   ? values[RED]   : color.r,
+                       changed[GREEN] ? values[GREEN] : color.g,
+                       changed[BLUE]  ? values[BLUE]  : color.b);
+    }
+    if (changed[WHITE_TEMPERATURE])
+    {
+        const float range = ColorConverter::COLD_TEMPERATURE - ColorConverter::WARM_TEMPERATURE;
+        light.setWhiteTemperature(ColorConverter::WARM_TEMPERATURE + values[WHITE_TEMPERATURE] * range);
+    }
+}
+
+float Timeline::evaluate(const Track& track) const
+{
+    const Keyframe* keyframes = &active.keyframes[track.firstKeyframe];
+    const Keyframe& from = keyframes[track.current];
+    const float scale = 1.0f / 0xFFFF;
+
+    if (track.current + 1 >= track.keyframeCount)
+    {
+        return from.value * scale;
+    }
+
+    const Keyframe& to = keyframes[track.current + 1];
+    const float t = ease(from.easing, track.elapsed / to.duration);
+
+    return (from.value + (static_cast<float>(to.value) - from.value) * t) * scale;
+}
+
+float Timeline::ease(uint8_t easing, float t)
+{
+    switch (easing)
+    {
+    case HOLD:
+        return 0;
+    case EASE_IN:
+        return t * t;
+    case EASE_OUT:
+        return t * (2 - t);
+    case EASE_IN_OUT:
+        return t * t * (3 - 2 * t);
+    case LINEAR:
+    default:
+        return t;
+    }
+}
@@ -0,0 +1,131 @@
+#ifndef TIMELINE_H
+#define TIMELINE_H
+
+#include <inttypes.h>
+#include <stddef.h>
+
+#include <atomic>
+
+#include "../CarLight.h"
+#include "../SegmentedLight.h"
+
+/// Plays keyframe animations that were uploaded once, instead of streaming every change over the network.
+/// Evaluated once per frame right before CarLight::step(). Costs O(active tracks) per frame.
+///
+/// Binary script format (little endian):
+///   Script:   uint8 trackCount, Track[trackCount]
+///   Track:    uint8 target (see Target), uint8 segment (0 = whole light, n = segment n - 1 of a SegmentedLight), uint8 loopStart (keyframe index, NO_LOOP to play once),
+///             uint8 keyframeCount, Keyframe[keyframeCount]
+///   Keyframe: uint16 duration [ms] since the previous keyframe (ignored for the first one),
+///             uint16 value (0 = minimum of the target, 0xFFFF = maximum),
+///             uint8 easing of the transition to the next keyframe (see Easing)
+///
+/// Tracks that reach their last keyframe without a loop point hold that value and stop being evaluated.
+class Timeline
+{
+public:
+    enum Target
+    {
+        COLOR_BRIGHTNESS,   // [0, 1]
+        WHITE_BRIGHTNESS,   // [0, 1]
+        RED,                // [0, 1]
+        GREEN,              // [0, 1]
+        BLUE,               // [0, 1]
+        WHITE_TEMPERATURE,  // [ColorConverter::WARM_TEMPERATURE, ColorConverter::COLD_TEMPERATURE]
+        TARGET_COUNT
+    };
+
+    enum Easing
+    {
+        LINEAR,
+        HOLD,           // Jump at the end of the transition
+        EASE_IN,        // Quadratic
+        EASE_OUT,       // Quadratic
+        EASE_IN_OUT,    // Smoothstep
+        EASING_COUNT
+    };
+
+    static const uint8_t NO_LOOP = 0xFF;
+
+    static const size_t MAX_TRACKS = 16;
+    static const size_t MAX_KEYFRAMES = 128;
+
+    Timeline();
+
+    /// Replaces the current script. Called from the network task, the script starts with the next step().
+    /// An empty script (trackCount 0) stops all tracks.
+    /// @return false if the script is malformed, too big or the previous upload was not picked up yet
+    bool load(const uint8_t* buffer, size_t size);
+
+    /// Stops all tracks. They keep their current values.
+    void stop();
+
+    /// Advances all active tracks and applies their values to the light
+    /// @param dt Time since the last step [seconds]
+    void step(double dt, CarLightBase& light);
+
+    /// Same for a light that is split into segments. Tracks of the whole light apply to every segment,
+    /// tracks of a segment override them for that segment. Tracks of segments that do not exist are ignored.
+    void step(double dt, CarLightBase* const* segments, size_t segmentCount);
+
+    /// @return true if at least one track is still running
+    bool isPlaying() const;
+
+private:
+    struct Keyframe
+    {
+        uint16_t duration; // [ms]
+        uint16_t value;
+        uint8_t easing;
+    };
+
+    struct Track
+    {
+        uint8_t target;
+        uint8_t segment;
+        uint8_t loopStart;
+        uint8_t keyframeCount;
+
+        /// Index of the track's first keyframe in keyframes
+        uint16_t firstKeyframe;
+
+        /// Keyframe we are transitioning away from (relative to firstKeyframe)
+        uint8_t current;
+
+        /// Time since we passed the current keyframe [ms]
+        float elapsed;
+    };
+
+    struct Script
+    {
+        uint8_t trackCount;
+        uint16_t keyframeCount;
+        Track tracks[MAX_TRACKS];
+        Keyframe keyframes[MAX_KEYFRAMES];
+    };
+
+    /// Parses a script into the given buffer
+    static bool parse(const uint8_t* buffer, size_t size, Script& script);
+
+    /// @return value of the track at its current position [0, 1]
+    float evaluate(const Track& track) const;
+
+    static float ease(uint8_t easing, float t);
+
+    /// Sets the targets that changed
+    static void apply(CarLightBase& light, const float* values, const bool* changed);
+
+    /// Script that is being played. Only accessed by step().
+    Script active;
+
+    /// Indices of the tracks in active that are still running
+    uint8_t running[MAX_TRACKS];
+    size_t runningCount;
+
+    /// Uploaded script, waiting for the next step() to take it over
+    Script pending;
+    std::atomic<bool> pendingReady;
+    std::atomic<bool> stopRequested;
+};
+
+#endif // TIMELINE_H
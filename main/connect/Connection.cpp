@@ -1,27 +1,43 @@
 #include "Connection.h"
 
-#include <nvs_flash.h>
+#include <freertos/FreeRTOS.h>
+#include <freertos/task.h>
+
 #include <esp_log.h>
+#include <esp_timer.h>
 #include <esp_netif.h>
 
+#include <inttypes.h>
+
 #include <lwip/sockets.h>
 
-Connection::Connection(const char* ssid, const char* password, const char* ip)
+#include "MessageSchema.h"
+
+Connection::Connection(const char* ssid, const char* password, const char* ip, const char* multicastGroup)
+    : ssid(ssid)
+    , password(password)
+    , ip(ip)
+    , multicastGroup(multicastGroup)
+    , sock(-1)
+    , senderAddress(0)
+    , senderPort(0)
+{}
+
+void Connection::start()
 {
-    // NVS is used for SSID and password storage
-    esp_err_t ret = nvs_flash_init();
-    if (ret == ESP_ERR_NVS_NO_FREE_PAGES || ret == ESP_ERR_NVS_NEW_VERSION_FOUND)
-    {
-        nvs_flash_erase();
-        nvs_flash_init();
-    }
+    xTaskCreate(&Connection::startTask, "connection", 4096, this, 2, NULL);
+}
+
+void Connection::startTask(void* args)
+{
+    Connection* instance = static_cast<Connection*>(args);
 
     esp_netif_init();
 
     esp_event_loop_create_default();
     esp_netif_t* netIF = esp_netif_create_default_wifi_sta();
     esp_netif_ip_info_t ipInfo;
-    ipInfo.ip.addr = esp_ip4addr_aton(ip);
+    ipInfo.ip.addr = esp_ip4addr_aton(instance->ip);
     ipInfo.gw.addr = esp_ip4addr_aton("192.168.0.1");
     ipInfo.netmask.addr = esp_ip4addr_aton("255.255.255.0");
 
@@ -35,8 +51,8 @@ Connection::Connection(const char* ssid, const char* password, const char* ip)
 
     esp_event_handler_instance_t anyHandler;
     esp_event_handler_instance_t gotIPHandler;
-    esp_event_handler_instance_register(WIFI_EVENT, ESP_EVENT_ANY_ID, &Connection::wifiEventHandler, this, &anyHandler);
-    esp_event_handler_instance_register(IP_EVENT, IP_EVENT_STA_GOT_IP, &Connection::wifiEventHandler, this, &gotIPHandler);
+    esp_event_handler_instance_register(WIFI_EVENT, ESP_EVENT_ANY_ID, &Connection::wifiEventHandler, instance, &anyHandler);
+    esp_event_handler_instance_register(IP_EVENT, IP_EVENT_STA_GOT_IP, &Connection::wifiEventHandler, instance, &gotIPHandler);
 
     #pragma GCC diagnostic push
     #pragma GCC diagnostic ignored "-Wmissing-field-initializers"
@@ -48,13 +64,24 @@ Connection::Connection(const char* ssid, const char* password, const char* ip)
             .password = ""
         }
     };
-    strncpy((char*) wifiConfig.sta.ssid, ssid, sizeof(wifiConfig.sta.ssid));
-    strncpy((char*) wifiConfig.sta.password, password, sizeof(wifiConfig.sta.password));
+    strncpy((char*) wifiConfig.sta.ssid, instance->ssid, sizeof(wifiConfig.sta.ssid));
+    strncpy((char*) wifiConfig.sta.password, instance->password, sizeof(wifiConfig.sta.password));
     #pragma GCC diagnostic pop
 
     esp_wifi_set_mode(WIFI_MODE_STA);
     esp_wifi_set_config(WIFI_IF_STA, &wifiConfig);
     esp_wifi_start();
+
+    // In modem sleep the AP holds multicast frames until the next DTIM beacon (100 ms and more), and every light
+    // wakes up at a different time. Stay awake so the group changes together.
+    if (instance->multicastGroup)
+    {
+        esp_wifi_set_ps(WIFI_PS_NONE);
+    }
+
+    ESP_LOGI("Connection", "WiFi started %" PRId64 " ms after boot", esp_timer_get_time() / 1000);
+
+    vTaskDelete(NULL);
 }
 
 void Connection::wifiEventHandler(void* arg, esp_event_base_t eventBase, int32_t eventID, void* eventData)
@@ -77,7 +104,7 @@ void Connection::wifiEventHandler(void* arg, esp_event_base_t eventBase, int32_t
         ip_event_got_ip_t* event = static_cast<ip_event_got_ip_t*>(eventData);
         char buffer[50];
         esp_ip4addr_ntoa(&event->ip_info.ip, buffer, 50);
-        ESP_LOGI("Connection", "Got IP: %s", buffer);
+        ESP_LOGI("Connection", "Got IP: %s (%" PRId64 " ms after boot)", buffer, esp_timer_get_time() / 1000);
 
         xTaskCreate(&Connection::udpTask, "udpTask", 4096, instance, 5, NULL);
     }
@@ -88,6 +115,7 @@ void Connection::udpTask(void* args)
     Connection* instance = static_cast<Connection*>(args);
 
     int sock = socket(AF_INET, SOCK_DGRAM, IPPROTO_UDP);
+    instance->sock = sock;
     if (sock < 1)
     {
         ESP_LOGI("Connection", "Error creating socket %d", errno);
@@ -102,15 +130,65 @@ void Connection::udpTask(void* args)
     myAddress.sin_port = htons(8002);
     bind(sock, (sockaddr*) &myAddress, sizeof(myAddress));
 
-    const size_t BUFFER_SIZE = 512;
-    uint8_t buffer[BUFFER_SIZE];
+    // Bound to INADDR_ANY, the socket receives the group's datagrams on the same port once it is a member
+    if (instance->multicastGroup)
+    {
+        instance->joinGroup(sock);
+    }
+
+    uint8_t buffer[MessageSchema::MAX_DATAGRAM];
 
     sockaddr_in fromAddress;
     socklen_t fromLength;
 
     while (true)
     {
-        size_t received = recvfrom(sock, buffer, BUFFER_SIZE, 0, (sockaddr*) &fromAddress, &fromLength);
+        fromLength = sizeof(fromAddress);
+        ssize_t received = recvfrom(sock, buffer, sizeof(buffer), 0, (sockaddr*) &fromAddress, &fromLength);
+        if (received < 0)
+        {
+            ESP_LOGI("Connection", "Error receiving %d", errno);
+            continue;
+        }
+        instance->senderAddress = fromAddress.sin_addr.s_addr;
+        instance->senderPort = fromAddress.sin_port;
         instance->packetHandler(buffer, received);
     }
 }
+
+void Connection::joinGroup(int sock)
+{
+    ip_mreq membership;
+    memset(&membership, 0, sizeof(membership));
+    membership.imr_multiaddr.s_addr = inet_addr(multicastGroup);
+    membership.imr_interface.s_addr = inet_addr(ip);
+    if (!IN_MULTICAST(ntohl(membership.imr_multiaddr.s_addr)))
+    {
+        ESP_LOGI("Connection", "%s is not a multicast address", multicastGroup);
+        return;
+    }
+
+    if (setsockopt(sock, IPPROTO_IP, IP_ADD_MEMBERSHIP, &membership, sizeof(membership)) < 0)
+    {
+        ESP_LOGI("Connection", "Error joining multicast group %s: %d", multicastGroup, errno);
+    }
+    else
+    {
+        ESP_LOGI("Connection", "Joined multicast group %s", multicastGroup);
+    }
+}
+
+void Connection::reply(const uint8_t* buffer, size_t size)
+{
+    if (sock < 0 || senderPort == 0)
+    {
+        return;
+    }
+
+    sockaddr_in toAddress;
+    memset(&toAddress, 0, sizeof(toAddress));
+    toAddress.sin_family = AF_INET;
+    toAddress.sin_addr.s_addr = senderAddress;
+    toAddress.sin_port = senderPort;
+    sendto(sock, buffer, size, 0, (sockaddr*) &toAddress, sizeof(toAddress));
+}
@@ -2,19 +2,49 @@
 #define CONNECTION_H
 
 #include <esp_wifi.h>
+
+#include <atomic>
 #include <functional>
 
 class Connection
 {
 public:
-    Connection(const char* ssid, const char* password, const char* ip);
+    /// Only stores the settings, the network is brought up by start()
+    /// The strings must stay valid until the network is up.
+    /// @param multicastGroup IPv4 multicast address the UDP server joins besides its own address, NULL for unicast only.
+    ///                       All lights of a fleet join the same group, so one datagram reaches them together (see NodeAddress).
+    Connection(const char* ssid, const char* password, const char* ip, const char* multicastGroup = NULL);
+
+    /// Brings up WiFi and the UDP server on a task of its own and returns right away.
+    /// NVS must be initialized before (see StateStore::init()).
+    void start();
 
     std::function<void (const uint8_t*, size_t)> packetHandler;
 
+    /// Sends a packet to the sender of the last received packet. Can be called from any task.
+    void reply(const uint8_t* buffer, size_t size);
+
 private:
+    /// Blocking part of the network bring-up, runs on the connection task
+    static void startTask(void* args);
+
     static void wifiEventHandler(void* arg, esp_event_base_t eventBase, int32_t eventID, void* eventData);
 
     static void udpTask(void* args);
+
+    /// Adds the socket to the multicast group (IGMP membership report on our interface)
+    void joinGroup(int sock);
+
+    const char* ssid;
+    const char* password;
+    const char* ip;
+    const char* multicastGroup;
+
+    std::atomic<int> sock;
+
+    /// Address and port of the last sender in network byte order
+    std::atomic<uint32_t> senderAddress;
+    std::atomic<uint16_t> senderPort;
 };
 
 #endif
\ No newline at end of file
@@ -0,0 +1,220 @@
+#include "FrameCodec.h"
+
+#include <string.h>
+
+namespace FrameCodec
+{
+
+static const uint8_t SKIP = 0x00;
+static const uint8_t LITERAL = 0x80;
+static const uint8_t REPEAT = 0xC0;
+
+static const uint8_t TYPE_MASK = 0xC0;
+static const uint8_t SKIP_MASK = 0x80;
+
+static inline uint8_t referenceAt(const uint8_t* reference, size_t i)
+{
+    return reference ? reference[i] : 0;
+}
+
+/// Number of bytes from position on that are the same in frame and reference, up to one token
+static size_t unchangedBytes(const uint8_t* frame, const uint8_t* reference, size_t position, size_t size)
+{
+    size_t count = 0;
+    while (count < MAX_SKIP && position + count < size && frame[position + count] == referenceAt(reference, position + count))
+    {
+        ++count;
+    }
+    return count;
+}
+
+/// Number of LEDs from position on that are copies of the LED before position, up to one token
+static size_t repeatedLEDs(const uint8_t* frame, size_t position, size_t size, size_t stride)
+{
+    if (position < stride || position % stride != 0)
+    {
+        return 0;
+    }
+
+    const uint8_t* previous = &frame[position - stride];
+    size_t count = 0;
+    while (count < MAX_REPEAT && position + (count + 1) * stride <= size && memcmp(&frame[position + count * stride], previous, stride) == 0)
+    {
+        ++count;
+    }
+    return count;
+}
+
+bool encode(const uint8_t* frame, const uint8_t* reference, size_t size, size_t stride, uint8_t* out, size_t capacity, size_t& payloadSize)
+{
+    size_t written = 0;
+    // Payload size without the skip tokens at its end. Unchanged bytes at the end of the frame need no token.
+    size_t withoutTrailingSkips = 0;
+    size_t literalStart = 0;
+    size_t literalLength = 0;
+
+    // Emits the pending literal bytes. Returns false if out is full.
+    auto flushLiteral = [&]() -> bool
+    {
+        while (literalLength > 0)
+        {
+            const size_t length = literalLength < MAX_LITERAL ? literalLength : MAX_LITERAL;
+            if (written + 1 + length > capacity)
+            {
+                return false;
+            }
+            out[written++] = LITERAL | (length - 1);
+            for (size_t i = 0; i < length; ++i)
+            {
+                out[written++] = frame[literalStart + i] ^ referenceAt(reference, literalStart + i);
+            }
+            literalStart += length;
+            literalLength -= length;
+            withoutTrailingSkips = written;
+        }
+        return true;
+    };
+
+    size_t position = 0;
+    while (position < size)
+    {
+        size_t unchanged = unchangedBytes(frame, reference, position, size);
+        const size_t repeated = repeatedLEDs(frame, position, size, stride);
+
+        // Stop skipping at the next LED if a longer repeat starts there. Otherwise we would lose the LED alignment repeats need.
+        const size_t nextLED = (position / stride + 1) * stride;
+        if (position + unchanged > nextLED && repeatedLEDs(frame, nextLED, size, stride) * stride > position + unchanged - nextLED)
+        {
+            unchanged = nextLED - position;
+        }
+
+        // Single unchanged bytes are cheaper inside a literal than as their own token
+        const bool skip = unchanged >= 2 || (unchanged > 0 && position + unchanged == size);
+
+        if (!skip && repeated == 0)
+        {
+            if (literalLength == 0)
+            {
+                literalStart = position;
+            }
+            ++literalLength;
+            ++position;
+            continue;
+        }
+
+        if (!flushLiteral() || written + 1 > capacity)
+        {
+            return false;
+        }
+
+        if (unchanged >= repeated * stride)
+        {
+            out[written++] = SKIP | (unchanged - 1);
+            position += unchanged;
+        }
+        else
+        {
+            out[written++] = REPEAT | (repeated - 1);
+            position += repeated * stride;
+            withoutTrailingSkips = written;
+        }
+    }
+
+    if (!flushLiteral())
+    {
+        return false;
+    }
+
+    payloadSize = withoutTrailingSkips;
+    return true;
+}
+
+bool validate(const uint8_t* payload, size_t payloadSize, size_t size, size_t stride)
+{
+    size_t position = 0;
+    size_t i = 0;
+    while (i < payloadSize)
+    {
+        const uint8_t control = payload[i++];
+
+        if ((control & SKIP_MASK) == SKIP)
+        {
+            position += (control & ~SKIP_MASK) + 1;
+        }
+        else if ((control & TYPE_MASK) == LITERAL)
+        {
+            const size_t length = (control & ~TYPE_MASK) + 1;
+            if (i + length > payloadSize)
+            {
+                return false;
+            }
+            i += length;
+            position += length;
+        }
+        else
+        {
+            if (position < stride || position % stride != 0)
+            {
+                return false;
+            }
+            position += ((control & ~TYPE_MASK) + 1) * stride;
+        }
+
+        if (position > size)
+        {
+            return false;
+        }
+    }
+    return true;
+}
+
+void decode(const uint8_t* payload, size_t payloadSize, uint8_t* reference, uint8_t* out, size_t size, size_t stride)
+{
+    size_t position = 0;
+    size_t i = 0;
+    while (i < payloadSize)
+    {
+        const uint8_t control = payload[i++];
+
+        if ((control & SKIP_MASK) == SKIP)
+        {
+            const size_t length = (control & ~SKIP_MASK) + 1;
+            if (out)
+            {
+                memcpy(&out[position], &reference[position], length);
+            }
+            position += length;
+        }
+        else if ((control & TYPE_MASK) == LITERAL)
+        {
+            const size_t length = (control & ~TYPE_MASK) + 1;
+            for (size_t k = 0; k < length; ++k, ++position)
+            {
+                reference[position] ^= payload[i++];
+                if (out)
+                {
+                    out[position] = reference[position];
+                }
+            }
+        }
+        else
+        {
+            const size_t length = ((control & ~TYPE_MASK) + 1) * stride;
+            for (size_t k = 0; k < length; ++k, ++position)
+            {
+                reference[position] = reference[position - stride];
+                if (out)
+                {
+                    out[position] = reference[position];
+                }
+            }
+        }
+    }
+
+    if (out && position < size)
+    {
+        memcpy(&out[position], &reference[position], size - position);
+    }
+}
+
+} // namespace FrameCodec
@@ -0,0 +1,44 @@
+#ifndef FRAME_CODEC_H
+#define FRAME_CODEC_H
+
+#include <inttypes.h>
+#include <stddef.h>
+
+/// Compression of streamed wire format frames. Shared by the firmware (decoder) and the host tools (encoder).
+///
+/// A frame is coded against a reference frame, usually the last frame the receiver acknowledged.
+/// Keyframes use an all black reference. The payload is a sequence of tokens, each starting with a control byte:
+///   0nnnnnnn  Skip:    n + 1 bytes are unchanged from the reference
+///   10nnnnnn  Literal: n + 1 bytes follow, each XORed onto the reference
+///   11nnnnnn  Repeat:  n + 1 LEDs (stride bytes each) are copies of the LED before them
+/// Bytes after the last token are unchanged. Repeats must start on an LED boundary after the first LED.
+namespace FrameCodec
+{
+
+static const size_t MAX_SKIP = 128;
+static const size_t MAX_LITERAL = 64;
+static const size_t MAX_REPEAT = 64;
+
+/// Encodes a frame
+/// @param frame New frame
+/// @param reference Frame the receiver has, NULL for a keyframe
+/// @param size Frame size in bytes, a multiple of stride
+/// @param stride Bytes per LED
+/// @param out Payload buffer
+/// @param capacity Size of out
+/// @param payloadSize Set to the number of bytes written to out. 0 if the frame equals the reference.
+/// @return false if the payload did not fit into capacity
+bool encode(const uint8_t* frame, const uint8_t* reference, size_t size, size_t stride, uint8_t* out, size_t capacity, size_t& payloadSize);
+
+/// Checks a payload for tokens that would leave the frame, without touching any frame data
+bool validate(const uint8_t* payload, size_t payloadSize, size_t size, size_t stride);
+
+/// Applies a payload to the reference and writes the result to out, in one pass over the frame.
+/// For a keyframe clear the reference first. The payload must be valid (see validate()).
+/// @param reference Reference frame, becomes the decoded frame
+/// @param out Second copy of the decoded frame (e.g. LEDDriver::getBuffer()), may be NULL
+void decode(const uint8_t* payload, size_t payloadSize, uint8_t* reference, uint8_t* out, size_t size, size_t stride);
+
+} // namespace FrameCodec
+
+#endif // FRAME_CODEC_H
@@ -0,0 +1,78 @@
+#include "FrameStream.h"
+
+#include <string.h>
+
+#include "FrameCodec.h"
+
+FrameStreamBase::FrameStreamBase(uint8_t* reference, size_t size, size_t stride, unsigned timeoutFrames)
+    : reference(reference)
+    , size(size)
+    , stride(stride)
+    , referenceID(NO_FRAME)
+    , timeoutFrames(timeoutFrames)
+    , idleFrames(timeoutFrames)
+    , pendingSize(0)
+    , pendingID(NO_FRAME)
+    , pendingBaseID(NO_FRAME)
+    , pendingReady(false)
+{}
+
+bool FrameStreamBase::push(uint16_t frameId, uint16_t baseId, const uint8_t* payload, size_t payloadSize)
+{
+    if (pendingReady || frameId == NO_FRAME || payloadSize > MAX_PAYLOAD)
+    {
+        return false;
+    }
+
+    if (!FrameCodec::validate(payload, payloadSize, size, stride))
+    {
+        return false;
+    }
+
+    memcpy(pending, payload, payloadSize);
+    pendingSize = payloadSize;
+    pendingID = frameId;
+    pendingBaseID = baseId;
+    pendingReady = true;
+
+    return true;
+}
+
+bool FrameStreamBase::decode(uint8_t* out)
+{
+    if (!pendingReady)
+    {
+        if (idleFrames < timeoutFrames)
+        {
+            ++idleFrames;
+        }
+        return false;
+    }
+
+    bool decoded = false;
+    if (pendingBaseID == NO_FRAME || pendingBaseID == referenceID)
+    {
+        if (pendingBaseID == NO_FRAME)
+        {
+            memset(reference, 0, size);
+        }
+        FrameCodec::decode(pending, pendingSize, reference, out, size, stride);
+        referenceID = pendingID;
+        idleFrames = 0;
+        decoded = true;
+    }
+
+    pendingReady = false;
+
+    if (ackHandler)
+    {
+        ackHandler(referenceID);
+    }
+
+    return decoded;
+}
+
+bool FrameStreamBase::isActive() const
+{
+    return idleFrames < timeoutFrames;
+}
@@ -0,0 +1,84 @@
+#ifndef FRAME_STREAM_H
+#define FRAME_STREAM_H
+
+#include <inttypes.h>
+#include <stddef.h>
+
+#include <array>
+#include <atomic>
+#include <functional>
+
+#include "MessageSchema.h"
+
+/// Receives compressed wire format frames streamed by a host (see FrameCodec.h for the coding).
+/// Every frame names the frame it was coded against. We keep the last decoded frame as reference
+/// and acknowledge it after every decode, so the host knows what to code the next frame against.
+/// Frames coded against anything else are dropped and answered with the current reference.
+/// Use FrameStream<Size, Stride> to get a stream with its own reference frame.
+class FrameStreamBase
+{
+public:
+    /// Largest payload of a single frame: what is left of a datagram after the ID and the fields of StreamFrameMessage.
+    /// Longer payloads are cut off by Connection, which can end on a token boundary and still decode.
+    static const size_t MAX_PAYLOAD =
+        MessageSchema::MAX_DATAGRAM - sizeof(uint32_t) - MessageSchema::StreamFrameMessage::FIXED_SIZE;
+
+    /// Base frame ID of keyframes, which are coded against a black frame
+    static const uint16_t NO_FRAME = 0xFFFF;
+
+    /// Hands a received frame to the render task. Called from the network task.
+    /// @return false if the payload is malformed or the previous frame was not decoded yet
+    bool push(uint16_t frameId, uint16_t baseId, const uint8_t* payload, size_t payloadSize);
+
+    /// Decodes the pending frame, if there is one, in a single pass into the reference and out.
+    /// Called once per rendered frame from the render task.
+    /// @param out Wire format buffer (e.g. LEDDriver::getBuffer())
+    /// @return true if out was written
+    bool decode(uint8_t* out);
+
+    /// True while frames arrive. Becomes false after timeoutFrames calls of decode() without a frame.
+    bool isActive() const;
+
+    /// Called from the render task with the ID of the reference frame after every pushed frame
+    std::function<void (uint16_t)> ackHandler;
+
+protected:
+    /// Storage is owned by the derived class
+    FrameStreamBase(uint8_t* reference, size_t size, size_t stride, unsigned timeoutFrames);
+
+private:
+    uint8_t* reference;
+    const size_t size;
+    const size_t stride;
+    uint16_t referenceID;
+
+    const unsigned timeoutFrames;
+    unsigned idleFrames;
+
+    /// Written by the network task while pendingReady is false, read by the render task while it is true
+    uint8_t pending[MAX_PAYLOAD];
+    size_t pendingSize;
+    uint16_t pendingID;
+    uint16_t pendingBaseID;
+    std::atomic<bool> pendingReady;
+};
+
+template <size_t Size>
+struct FrameStreamStorage
+{
+    std::array<uint8_t, Size> referenceFrame;
+};
+
+/// Stream of frames with Size bytes and Stride bytes per LED (e.g. LEDDriver<N>::BUFFER_SIZE and BYTES_PER_LED)
+template <size_t Size, size_t Stride>
+class FrameStream : private FrameStreamStorage<Size>, public FrameStreamBase
+{
+public:
+    /// @param timeoutFrames Number of rendered frames without a streamed frame until the stream is inactive
+    FrameStream(unsigned timeoutFrames)
+        : FrameStreamStorage<Size>()
+        , FrameStreamBase(this->referenceFrame.data(), Size, Stride, timeoutFrames)
+    {}
+};
+
+#endif // FRAME_STREAM_H
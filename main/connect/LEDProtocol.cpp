@@ -3,14 +3,34 @@
 #include <math.h>
 
 #include <esp_log.h>
+#include <esp_timer.h>
 
-LEDProtocol::LEDProtocol(CarLight* light)
+LEDProtocol::LEDProtocol(CarLightBase* light, Timeline* timeline, PixelShader* shader,
+                         Palette* palette, IndexedFrameBase* indexedFrame, FrameStreamBase* stream,
+                         ClipPlayerBase* clip, const Seqlock<LightStatus>* status,
+                         LatencyProbe* latency, TraceRecorderBase* trace,
+                         const NodeAddress* address)
 	: lightDriver(light)
+	, segments(NULL)
+	, segmentCount(0)
+	, indexed(false)
+	, selectedSegment(NULL)
+	, envelopeDepth(0)
+	, timeline(timeline)
+	, shader(shader)
+	, palette(palette)
+	, indexedFrame(indexedFrame)
+	, stream(stream)
+	, clip(clip)
+	, status(status)
+	, latency(latency)
+	, trace(trace)
+	, address(address)
 {}
 
 void LEDProtocol::parse(const uint8_t* buffer, const size_t &size)
 {
-	if (size < 4)
+	if (size < sizeof(uint32_t))
 	{
 		ESP_LOGI("LED_Protocol", "Message was invalid (Shorter than 4)");
 		return;
@@ -19,51 +39,61 @@ void LEDProtocol::parse(const uint8_t* buffer, const size_t &size)
 	uint32_t id = 0;
 	memcpy(&id, buffer, sizeof(uint32_t));
 
+	const uint8_t* payload = &buffer[sizeof(uint32_t)];
+	const size_t payloadSize = size - sizeof(uint32_t);
+
+	if (indexed && isIgnoredWhenIndexed(id))
+	{
+		ESP_LOGI("LED_Protocol", "Message 0x%03x is not supported by the indexed framebuffer", static_cast<unsigned>(id));
+		return;
+	}
+
+	// Envelopes only wrap plain requests. Deeper nesting would recurse once per envelope on the stack of the network task.
+	if (envelopeDepth > 0 && isEnvelope(id))
+	{
+		ESP_LOGI("LED_Protocol", "Message 0x%03x was invalid (Nested in an envelope)", static_cast<unsigned>(id));
+		return;
+	}
+
+	// Every request is checked against its size in the schema before it is executed
 	switch (id)
 	{
-		case 0x100:
-		{
-			executeMessage(ColorMessage(&buffer[sizeof(uint32_t)]));
-			break;
-		}
-		case 0x101:
-		{
-			executeMessage(DimMessage(&buffer[sizeof(uint32_t)]));
-			break;
+#define LED_PROTOCOL_DISPATCH(TYPE, ID, LATEST) \
+		case ID: \
+		{ \
+			MessageSchema::TYPE message = {}; \
+			if (!message.decode(payload, payloadSize)) \
+			{ \
+				ESP_LOGI("LED_Protocol", #TYPE " was invalid (%u bytes)", static_cast<unsigned>(size)); \
+				break; \
+			} \
+			executeMessage(message); \
+			break; \
 		}
-		case 0x102:
-		{
-			executeMessage(ValueMessage(&buffer[sizeof(uint32_t)]));
-			break;
-		}
-		case 0x103:
-		{
-			executeMessage(FilterMessage(&buffer[sizeof(uint32_t)]));
-			break;
-		}
-		case 0x104:
-		{
-			executeMessage(SetFilterValuesMessage(&buffer[sizeof(uint32_t)]));
-			break;
-		}
-		case 0x105:
-		{
-			executeMessage(SetFilterValuesBufferMessage(&buffer[sizeof(uint32_t)]));
-			break;
-		}
-		case 0x106:
-		{
-			executeMessage(WhiteDimMessage(&buffer[sizeof(uint32_t)]));
-			break;
-		}
-		case 0x107:
+#define LED_PROTOCOL_SKIP(...)
+		LED_PROTOCOL_REQUESTS(LED_PROTOCOL_DISPATCH, LED_PROTOCOL_SKIP, LED_PROTOCOL_SKIP, )
+#undef LED_PROTOCOL_DISPATCH
+#undef LED_PROTOCOL_SKIP
+		default:
 		{
-			executeMessage(WhiteTemperatureMessage(&buffer[sizeof(uint32_t)]));
 			break;
 		}
-		case 0x108:
+	}
+
+	// Messages that change settings we keep across reboots. Only the whole light is kept, not single segments.
+	switch (selectedSegment ? 0 : id)
+	{
+		case MessageSchema::ColorMessage::ID:
+		case MessageSchema::DimMessage::ID:
+		case MessageSchema::ValueMessage::ID:
+		case MessageSchema::WhiteDimMessage::ID:
+		case MessageSchema::WhiteTemperatureMessage::ID:
+		case MessageSchema::TurnOnOffMessage::ID:
 		{
-			executeMessage(TurnOnOffMessage(&buffer[sizeof(uint32_t)]));
+			if (stateChangedHandler)
+			{
+				stateChangedHandler();
+			}
 			break;
 		}
 		default:
@@ -73,7 +103,75 @@ void LEDProtocol::parse(const uint8_t* buffer, const size_t &size)
 	}
 }
 
-void LEDProtocol::executeMessage(const ColorMessage &message)
+void LEDProtocol::setSegments(CarLightBase* const* newSegments, size_t count)
+{
+	segments = newSegments;
+	segmentCount = count;
+}
+
+void LEDProtocol::setIndexed(bool newIndexed)
+{
+	indexed = newIndexed;
+}
+
+void LEDProtocol::parseEnvelope(const uint8_t* buffer, size_t size)
+{
+	++envelopeDepth;
+	parse(buffer, size);
+	--envelopeDepth;
+}
+
+bool LEDProtocol::isEnvelope(uint32_t id)
+{
+	switch (id)
+	{
+		case MessageSchema::LatencyProbeMessage::ID:
+		case MessageSchema::BatchMessage::ID:
+		case MessageSchema::AddressedMessage::ID:
+		case MessageSchema::SegmentMessage::ID:
+			return true;
+		default:
+			return false;
+	}
+}
+
+bool LEDProtocol::isIgnoredWhenIndexed(uint32_t id)
+{
+	switch (id)
+	{
+		case MessageSchema::ColorMessage::ID:
+		case MessageSchema::ValueMessage::ID:
+		case MessageSchema::WhiteTemperatureMessage::ID:
+		case MessageSchema::WhiteDimMessage::ID:
+		case MessageSchema::FilterMessage::ID:
+		case MessageSchema::SetFilterValuesMessage::ID:
+		case MessageSchema::SetFilterValuesBufferMessage::ID:
+		case MessageSchema::TimelineMessage::ID:
+		case MessageSchema::ShaderMessage::ID:
+		case MessageSchema::SegmentMessage::ID:
+		case MessageSchema::StreamFrameMessage::ID:
+		case MessageSchema::ClipMessage::ID:
+			return true;
+		default:
+			return false;
+	}
+}
+
+void LEDProtocol::acknowledgeFrame(uint16_t frameId)
+{
+	if (!replyHandler)
+	{
+		return;
+	}
+
+	MessageSchema::FrameAckReply reply;
+	reply.frameId = frameId;
+
+	uint8_t buffer[sizeof(uint32_t) + MessageSchema::FrameAckReply::FIXED_SIZE];
+	replyHandler(buffer, reply.encode(buffer, sizeof(buffer)));
+}
+
+void LEDProtocol::executeMessage(const MessageSchema::ColorMessage &message)
 {
 	float red = static_cast<float>(message.red) / 0xFFFF;
 	float green = static_cast<float>(message.green) / 0xFFFF;
@@ -83,7 +181,7 @@ void LEDProtocol::executeMessage(const ColorMessage &message)
 	{
 	case 0:
 		ESP_LOGI("LEDProtocol", "Color Message RGB %.02f %.02f %.02f", red, green, blue);
-		lightDriver->setColor(red, green, blue);
+		forEachLight([&](CarLightBase& light) { light.setColor(red, green, blue); });
 		break;
 	case 1:
 		break;
@@ -92,22 +190,15 @@ void LEDProtocol::executeMessage(const ColorMessage &message)
 	}
 }
 
-LEDProtocol::ColorMessage::ColorMessage(const uint8_t* buffer) : LEDMessage(0x100, buffer)
+void LEDProtocol::executeMessage(const MessageSchema::DimMessage &message)
 {
-	const size_t colorSize = sizeof(uint16_t);
-
-	memcpy(&red,   &message[0 * colorSize], colorSize);
-	memcpy(&green, &message[1 * colorSize], colorSize);
-	memcpy(&blue,  &message[2 * colorSize], colorSize);
-}
+	const float dim = static_cast<float>(message.dim) / 0xFFFF;
 
-void LEDProtocol::executeMessage(const DimMessage &message)
-{
 	switch (message.channel)
 	{
 	case 0:
-		ESP_LOGI("LEDProtocol", "Set Dim %f", message.dim);
-		lightDriver->setColorBrightness(message.dim);
+		ESP_LOGI("LEDProtocol", "Set Dim %f", dim);
+		forEachLight([&](CarLightBase& light) { light.setColorBrightness(dim); });
 		break;
 	case 1:
 		break;
@@ -116,37 +207,18 @@ void LEDProtocol::executeMessage(const DimMessage &message)
 	}
 }
 
-LEDProtocol::DimMessage::DimMessage(const uint8_t* buffer) : LEDMessage(0x101, buffer)
-{
-	memcpy(&dim, message, sizeof(double));
-}
-
-void LEDProtocol::executeMessage(const ValueMessage &message)
+void LEDProtocol::executeMessage(const MessageSchema::ValueMessage &message)
 {
 	// Not implemented
 }
 
-LEDProtocol::ValueMessage::ValueMessage(const uint8_t* buffer) : LEDMessage(0x102, buffer)
-{
-	const size_t colorSize = sizeof(uint16_t);
-
-	memcpy(&red,   &message[0 * colorSize], colorSize);
-	memcpy(&green, &message[1 * colorSize], colorSize);
-	memcpy(&blue,  &message[2 * colorSize], colorSize);
-
-	uint8_t rawChar = 0;
-
-	memcpy(&rawChar, &message[3 * colorSize], sizeof(uint8_t));
-	raw = 0x01 & rawChar;
-}
-
-void LEDProtocol::executeMessage(const WhiteTemperatureMessage &message)
+void LEDProtocol::executeMessage(const MessageSchema::WhiteTemperatureMessage &message)
 {
 	switch (message.channel)
 	{
 	case 0:
-		ESP_LOGI("LEDProtocol", "White Temperature %f", message.temperature);
-		lightDriver->setWhiteTemperature(message.temperature);
+		ESP_LOGI("LEDProtocol", "White Temperature %u", static_cast<unsigned>(message.temperature));
+		forEachLight([&](CarLightBase& light) { light.setWhiteTemperature(message.temperature); });
 		break;
 	case 1:
 		break;
@@ -155,18 +227,15 @@ void LEDProtocol::executeMessage(const WhiteTemperatureMessage &message)
 	}
 }
 
-LEDProtocol::WhiteTemperatureMessage::WhiteTemperatureMessage(const uint8_t* buffer) : LEDMessage(0x107, buffer)
+void LEDProtocol::executeMessage(const MessageSchema::WhiteDimMessage &message)
 {
-	memcpy(&temperature, message, sizeof(double));
-}
+	const float dim = static_cast<float>(message.dim) / 0xFFFF;
 
-void LEDProtocol::executeMessage(const WhiteDimMessage &message)
-{
 	switch (message.channel)
 	{
 	case 0:
-		ESP_LOGI("LEDProtocol", "Dim White %f", message.dim);
-		lightDriver->setWhiteBrightness(message.dim);
+		ESP_LOGI("LEDProtocol", "Dim White %f", dim);
+		forEachLight([&](CarLightBase& light) { light.setWhiteBrightness(dim); });
 		break;
 	case 1:
 		break;
@@ -175,12 +244,7 @@ void LEDProtocol::executeMessage(const WhiteDimMessage &message)
 	}
 }
 
-LEDProtocol::WhiteDimMessage::WhiteDimMessage(const uint8_t* buffer) : LEDMessage(0x106, buffer)
-{
-	memcpy(&dim, message, sizeof(double));
-}
-
-void LEDProtocol::executeMessage(const FilterMessage &message)
+void LEDProtocol::executeMessage(const MessageSchema::FilterMessage &message)
 {
 	switch (message.channel)
 	{
@@ -209,20 +273,75 @@ void LEDProtocol::executeMessage(const FilterMessage &message)
 	}
 }
 
-LEDProtocol::FilterMessage::FilterMessage(const uint8_t* buffer) : LEDMessage(0x103, buffer)
+void LEDProtocol::executeMessage(const MessageSchema::SetFilterValuesMessage &message)
 {
-	uint8_t filterChar = 0;
-	memcpy(&filterChar, message, sizeof(uint8_t));
+	FilterDesigner::Response response = CarLightBase::DEFAULT_FILTER_RESPONSE;
+	if (message.responseSize >= sizeof(uint8_t) && message.response[0] < FilterDesigner::RESPONSE_COUNT)
+	{
+		response = static_cast<FilterDesigner::Response>(message.response[0]);
+	}
 
-	useFilter = 0x01 & filterChar;
+	switch (message.channel)
+	{
+	case 0:
+		ESP_LOGI("LEDProtocol", "Filter response %u, time constant %f", static_cast<unsigned>(response), message.resistance * message.capacitance);
+		forEachLight([&](CarLightBase& light) { light.setFilterValues(message.capacitance, message.resistance, response); });
+		break;
+	case 1:
+		break;
+	default:
+		break;
+	}
 }
 
-void LEDProtocol::executeMessage(const SetFilterValuesMessage &message)
+void LEDProtocol::executeMessage(const MessageSchema::SetFilterValuesBufferMessage &message)
 {
+	MessageSchema::SetFilterValuesMessage values;
+	values.channel = message.channel;
+	values.capacitance = message.capacitance;
+	values.resistance = message.resistance;
+	values.response = message.response;
+	values.responseSize = message.responseSize;
+	executeMessage(values);
+
+	switch(message.channel)
+	{
+	case 0:
+		forEachLight([&](CarLightBase& light) { light.setInitialFilterValues(message.x1, message.y1); });
+		break;
+	case 1:
+		break;
+	default:
+		break;
+	}
+}
+
+void LEDProtocol::executeMessage(const MessageSchema::TurnOnOffMessage &message)
+{
+	const bool on = message.on == 1;
+
 	switch (message.channel)
 	{
 	case 0:
-		lightDriver->setFilterValues(message.capacitance, message.resistance);
+		ESP_LOGI("LEDProtocol", "Turn %s message", on ? "on" : "off");
+		forEachLight([&](CarLightBase& light) { on ? light.turnOn() : light.turnOff(); });
+	case 1:
+		break;
+	default:
+		break;
+	}
+}
+
+void LEDProtocol::executeMessage(const MessageSchema::TimelineMessage &message)
+{
+	switch (message.channel)
+	{
+	case 0:
+		if (timeline)
+		{
+			bool loaded = timeline->load(message.script, message.scriptSize);
+			ESP_LOGI("LEDProtocol", "Timeline upload %s (%u bytes)", loaded ? "started" : "rejected", static_cast<unsigned>(message.scriptSize));
+		}
 		break;
 	case 1:
 		break;
@@ -231,20 +350,48 @@ void LEDProtocol::executeMessage(const SetFilterValuesMessage &message)
 	}
 }
 
-LEDProtocol::SetFilterValuesMessage::SetFilterValuesMessage(const uint8_t* buffer) : LEDMessage(0x104, buffer)
+void LEDProtocol::executeMessage(const MessageSchema::ShaderMessage &message)
 {
-	size_t valueSize = sizeof(double);
-	memcpy(&capacitance, message, valueSize);
-	memcpy(&resistance, &message[valueSize], valueSize);
+	switch (message.channel)
+	{
+	case 0:
+		if (shader)
+		{
+			bool loaded = shader->load(message.program, message.programSize);
+			ESP_LOGI("LEDProtocol", "Shader upload %s (%u bytes)", loaded ? "started" : "rejected", static_cast<unsigned>(message.programSize));
+		}
+		break;
+	case 1:
+		break;
+	default:
+		break;
+	}
 }
 
-void LEDProtocol::executeMessage(const SetFilterValuesBufferMessage &message)
+void LEDProtocol::executeMessage(const MessageSchema::PaletteMessage &message)
 {
-	executeMessage(static_cast<SetFilterValuesMessage>(message));
-	switch(message.channel)
+	const size_t ENTRY_SIZE = MESSAGE_SCHEMA_PALETTE_ENTRY_SIZE;
+
+	switch (message.channel)
 	{
 	case 0:
-		lightDriver->setInitialFilterValues(message.x1, message.y1);
+		if (palette)
+		{
+			const size_t count = message.entriesSize / ENTRY_SIZE;
+			for (size_t i = 0; i < count && message.first + i < Palette::SIZE; ++i)
+			{
+				uint16_t values[5];
+				memcpy(values, &message.entries[i * ENTRY_SIZE], ENTRY_SIZE);
+
+				ColorConverter::rgbcct color;
+				color.color.r = static_cast<double>(values[0]) / 0xFFFF;
+				color.color.g = static_cast<double>(values[1]) / 0xFFFF;
+				color.color.b = static_cast<double>(values[2]) / 0xFFFF;
+				color.ww = static_cast<double>(values[3]) / 0xFFFF;
+				color.cw = static_cast<double>(values[4]) / 0xFFFF;
+				palette->set(message.first + i, color);
+			}
+		}
 		break;
 	case 1:
 		break;
@@ -253,22 +400,58 @@ void LEDProtocol::executeMessage(const SetFilterValuesBufferMessage &message)
 	}
 }
 
-LEDProtocol::SetFilterValuesBufferMessage::SetFilterValuesBufferMessage(const uint8_t* buffer) : SetFilterValuesMessage(buffer)
+void LEDProtocol::executeMessage(const MessageSchema::IndexMessage &message)
 {
-	id = 0x105;
+	switch (message.channel)
+	{
+	case 0:
+		if (indexedFrame)
+		{
+			indexedFrame->write(message.start, message.indices, message.indicesSize);
+		}
+		break;
+	case 1:
+		break;
+	default:
+		break;
+	}
+}
 
-	size_t valueSize = sizeof(double);
-	memcpy(&x1, &message[16], valueSize);
-	memcpy(&y1, &message[24], valueSize);
+void LEDProtocol::executeMessage(const MessageSchema::StreamFrameMessage &message)
+{
+	switch (message.channel)
+	{
+	case 0:
+		if (stream && !stream->push(message.frameId, message.baseId, message.payload, message.payloadSize))
+		{
+			ESP_LOGD("LEDProtocol", "Stream frame %u dropped", static_cast<unsigned>(message.frameId));
+		}
+		break;
+	case 1:
+		break;
+	default:
+		break;
+	}
 }
 
-void LEDProtocol::executeMessage(const TurnOnOffMessage &message)
+void LEDProtocol::executeMessage(const MessageSchema::ClipMessage &message)
 {
 	switch (message.channel)
 	{
 	case 0:
-		ESP_LOGI("LEDProtocol", "Turn %s message", message.on ? "on" : "off");
-		message.on ? lightDriver->turnOn() : lightDriver->turnOff();
+		if (clip)
+		{
+			ESP_LOGI("LEDProtocol", "Clip command %u", static_cast<unsigned>(message.command));
+			if (message.command == MessageSchema::CLIP_STOP)
+			{
+				clip->stop();
+			}
+			else
+			{
+				clip->play(message.command == MessageSchema::CLIP_PLAY_LOOP);
+			}
+		}
+		break;
 	case 1:
 		break;
 	default:
@@ -276,11 +459,119 @@ void LEDProtocol::executeMessage(const TurnOnOffMessage &message)
 	}
 }
 
-LEDProtocol::TurnOnOffMessage::TurnOnOffMessage(const uint8_t* buffer) : LEDMessage(0x108, buffer)
+void LEDProtocol::executeMessage(const MessageSchema::StatusQueryMessage &/*message*/)
 {
-	on = false;
-	if (message[0] == 1)
+	// Never waits for the render task, the snapshot is at most one frame old
+	LightStatus snapshot;
+	if (!status || !replyHandler || !status->read(snapshot))
 	{
-		on = true;
+		return;
 	}
+
+	uint8_t serialized[LightStatus::MAX_SERIALIZED_SIZE];
+	MessageSchema::StatusReply reply;
+	reply.status = serialized;
+	reply.statusSize = snapshot.serialize(serialized, sizeof(serialized));
+
+	uint8_t buffer[sizeof(uint32_t) + LightStatus::MAX_SERIALIZED_SIZE];
+	replyHandler(buffer, reply.encode(buffer, sizeof(buffer)));
+}
+
+void LEDProtocol::executeMessage(const MessageSchema::LatencyProbeMessage &message)
+{
+	// Right after recvfrom, parsing the ID is all that happened since
+	const bool tagged = latency && latency->begin(message.tag, esp_timer_get_time());
+
+	// An empty probe only measures the way to the light and back
+	if (message.commandSize > 0)
+	{
+		parseEnvelope(message.command, message.commandSize);
+	}
+
+	if (tagged)
+	{
+		latency->applied(esp_timer_get_time());
+	}
+}
+
+void LEDProtocol::executeMessage(const MessageSchema::TraceMessage &message)
+{
+	if (!trace)
+	{
+		return;
+	}
+
+	switch (message.command)
+	{
+	case TraceRecorderBase::STOP:
+		trace->stop();
+		break;
+	case TraceRecorderBase::START:
+		trace->start();
+		break;
+	case TraceRecorderBase::DUMP:
+		if (replyHandler)
+		{
+			ESP_LOGI("LEDProtocol", "Dumping trace (%u bytes)", static_cast<unsigned>(trace->getSize()));
+			trace->dump(replyHandler);
+		}
+		break;
+	default:
+		break;
+	}
+}
+
+void LEDProtocol::executeMessage(const MessageSchema::BatchMessage &message)
+{
+	size_t offset = 0;
+	while (message.messagesSize - offset >= sizeof(MessageSchema::BatchEntrySize))
+	{
+		MessageSchema::BatchEntrySize size;
+		memcpy(&size, &message.messages[offset], sizeof(size));
+		offset += sizeof(size);
+
+		if (size > message.messagesSize - offset)
+		{
+			ESP_LOGI("LED_Protocol", "Batch was invalid (Entry of %u bytes is cut off)", static_cast<unsigned>(size));
+			return;
+		}
+
+		const uint8_t* entry = &message.messages[offset];
+		offset += size;
+
+		uint32_t id = 0;
+		if (size >= sizeof(uint32_t))
+		{
+			memcpy(&id, entry, sizeof(uint32_t));
+		}
+		if (id != MessageSchema::BatchMessage::ID)
+		{
+			parse(entry, size);
+		}
+	}
+}
+
+void LEDProtocol::executeMessage(const MessageSchema::AddressedMessage &message)
+{
+	// The outer envelope of a datagram is already resolved by NodeAddress::accept(), this handles envelopes in batches.
+	// Without an address every node matches.
+	if (address && !address->matches(message))
+	{
+		return;
+	}
+
+	parseEnvelope(message.message, message.messageSize);
+}
+
+void LEDProtocol::executeMessage(const MessageSchema::SegmentMessage &message)
+{
+	if (message.channel != 0 || message.segment > segmentCount)
+	{
+		ESP_LOGI("LED_Protocol", "Segment %u does not exist", static_cast<unsigned>(message.segment));
+		return;
+	}
+
+	selectedSegment = message.segment == 0 ? NULL : segments[message.segment - 1];
+	parseEnvelope(message.message, message.messageSize);
+	selectedSegment = NULL;
 }
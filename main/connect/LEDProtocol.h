@@ -3,16 +3,33 @@
 
 #include <inttypes.h>
 #include <cstring>
+#include <functional>
 
 #include "../animation/CarLight.h"
+#include "../animation/clip/ClipPlayer.h"
+#include "../animation/IndexedFrame.h"
+#include "../animation/colors/Palette.h"
+#include "../animation/shader/PixelShader.h"
+#include "../animation/timeline/Timeline.h"
+#include "FrameStream.h"
+#include "LatencyProbe.h"
+#include "LightStatus.h"
+#include "MessageSchema.h"
+#include "NodeAddress.h"
+#include "Seqlock.h"
+#include "TraceRecorder.h"
 
 /**
- * Parses LED control messages
+ * Parses LED control messages. The messages and their wire format are defined in MessageSchema.h.
  */
 class LEDProtocol
 {
 public:
-	LEDProtocol(CarLight* light);
+	LEDProtocol(CarLightBase* light, Timeline* timeline = NULL, PixelShader* shader = NULL,
+	            Palette* palette = NULL, IndexedFrameBase* indexedFrame = NULL, FrameStreamBase* stream = NULL,
+	            ClipPlayerBase* clip = NULL, const Seqlock<LightStatus>* status = NULL,
+	            LatencyProbe* latency = NULL, TraceRecorderBase* trace = NULL,
+	            const NodeAddress* address = NULL);
 
 	/**
 	 * Parse a message buffer and execute its content
@@ -21,109 +38,116 @@ public:
 	 */
 	void parse(const uint8_t* buffer, const size_t &size);
 
-protected:
-
 	/**
-	 * All Control messages
+	 * Tells the host which streamed frame we hold as reference (FrameAckReply).
+	 * Use as FrameStreamBase::ackHandler.
+	 * @param frameId - ID of the reference frame, FrameStreamBase::NO_FRAME if there is none
 	 */
+	void acknowledgeFrame(uint16_t frameId);
 
-	struct LEDMessage
-	{
-		LEDMessage(const uint32_t &ID, const uint8_t* buffer) : id(ID), message(&buffer[sizeof(uint8_t)])
-		{
-			memcpy(&channel, buffer, sizeof(uint8_t));
-		}
-
-		uint32_t id;
-		uint8_t channel;
-
-		const uint8_t* message;
-	};
-
-	struct ColorMessage : LEDMessage
-	{
-		ColorMessage(const uint8_t* buffer);
-
-		uint16_t red;
-		uint16_t green;
-		uint16_t blue;
-	};
-
-	struct DimMessage : LEDMessage
-	{
-		DimMessage(const uint8_t* buffer);
-
-		double dim;
-	};
-
-	struct WhiteDimMessage : LEDMessage
-	{
-		WhiteDimMessage(const uint8_t* buffer);
-
-		double dim;
-	};
-
-	struct ValueMessage : LEDMessage
-	{
-		ValueMessage(const uint8_t* buffer);
+	/**
+	 * Splits the light into segments (see SegmentedLight). Requests then apply to all segments,
+	 * unless a SegmentMessage selects one of them.
+	 * @param segments - Segment lights, must outlive the protocol
+	 * @param count - Number of segments
+	 */
+	void setSegments(CarLightBase* const* segments, size_t count);
 
-		uint16_t red;
-		uint16_t green;
-		uint16_t blue;
-		bool raw;
-	};
+	/**
+	 * Indexed framebuffer mode (main.cpp INDEXED_FRAMEBUFFER): the light is not rendered, only its on/off state
+	 * and dim level scale the palette. Other light requests (color, white, filters, timeline, shader, segments)
+	 * would have no visible effect, they are logged and ignored. So are streamed frames and clips, whose reference
+	 * frames are not kept in this mode.
+	 * @param indexed - True if the output comes from the indexed framebuffer
+	 */
+	void setIndexed(bool indexed);
 
-	struct WhiteTemperatureMessage : LEDMessage
-	{
-		WhiteTemperatureMessage(const uint8_t* buffer);
+	/**
+	 * Sends a message back to the host (e.g. Connection::reply)
+	 */
+	std::function<void (const uint8_t*, size_t)> replyHandler;
 
-		double temperature;
-	};
+	/**
+	 * Called after a message changed a setting of the light that should survive a reboot
+	 */
+	std::function<void ()> stateChangedHandler;
 
-	struct FilterMessage : LEDMessage
-	{
-		FilterMessage(const uint8_t* buffer);
+protected:
 
-		bool useFilter;
-	};
+	/**
+	 * One execute method per request of LED_PROTOCOL_REQUESTS (see MessageSchema.h)
+	 */
+#define LED_PROTOCOL_EXECUTE(TYPE, ID, LATEST) void executeMessage(const MessageSchema::TYPE &message);
+#define LED_PROTOCOL_SKIP(...)
+	LED_PROTOCOL_REQUESTS(LED_PROTOCOL_EXECUTE, LED_PROTOCOL_SKIP, LED_PROTOCOL_SKIP, )
+#undef LED_PROTOCOL_EXECUTE
+#undef LED_PROTOCOL_SKIP
 
-	struct SetFilterValuesMessage : LEDMessage
+	/**
+	 * Applies a light request to the segment selected by a SegmentMessage, else to all segments or the whole light
+	 */
+	template <typename Apply>
+	void forEachLight(Apply apply)
 	{
-		SetFilterValuesMessage(const uint8_t* buffer);
+		if (selectedSegment)
+		{
+			apply(*selectedSegment);
+		}
+		else if (segments)
+		{
+			for (size_t i = 0; i < segmentCount; ++i)
+			{
+				apply(*segments[i]);
+			}
+		}
+		else
+		{
+			apply(*lightDriver);
+		}
+	}
 
-		double capacitance;
-		double resistance;
-	};
+	/**
+	 * Parses the request wrapped by an envelope (AddressedMessage, LatencyProbeMessage, SegmentMessage).
+	 * The wrapped request must be a plain request, see isEnvelope().
+	 */
+	void parseEnvelope(const uint8_t* buffer, size_t size);
 
-	struct SetFilterValuesBufferMessage : SetFilterValuesMessage
-	{
-		SetFilterValuesBufferMessage(const uint8_t* buffer);
+	/**
+	 * @return true for messages that wrap other requests. They are only accepted outside of envelopes, which keeps the
+	 * recursion of parse() at most one envelope deep: a batch, an envelope in it and the request in the envelope.
+	 */
+	static bool isEnvelope(uint32_t id);
 
-		double x1;
-		double y1;
-	};
+	/**
+	 * @return true if the request cannot be shown in indexed mode, see setIndexed()
+	 */
+	static bool isIgnoredWhenIndexed(uint32_t id);
 
-	struct TurnOnOffMessage : LEDMessage
-	{
-		TurnOnOffMessage(const uint8_t* buffer);
+	CarLightBase* lightDriver;
+	CarLightBase* const* segments;
+	size_t segmentCount;
+	bool indexed;
 
-		bool on;
-	};
+	/**
+	 * Set while the request of a SegmentMessage is executed
+	 */
+	CarLightBase* selectedSegment;
 
 	/**
-	 * The following methods execute the specific control messages
+	 * Number of envelopes around the request that is parsed, 0 for the requests of a datagram or a batch
 	 */
-	void executeMessage(const ColorMessage &message);
-	void executeMessage(const DimMessage &message);
-	void executeMessage(const WhiteDimMessage &message);
-	void executeMessage(const ValueMessage &message);
-	void executeMessage(const WhiteTemperatureMessage &message);
-	void executeMessage(const FilterMessage &message);
-	void executeMessage(const SetFilterValuesMessage &message);
-	void executeMessage(const SetFilterValuesBufferMessage &message);
-	void executeMessage(const TurnOnOffMessage &message);
-
-	CarLight* lightDriver;
+	unsigned envelopeDepth;
+
+	Timeline* timeline;
+	PixelShader* shader;
+	Palette* palette;
+	IndexedFrameBase* indexedFrame;
+	FrameStreamBase* stream;
+	ClipPlayerBase* clip;
+	const Seqlock<LightStatus>* status;
+	LatencyProbe* latency;
+	TraceRecorderBase* trace;
+	const NodeAddress* address;
 };
 
 #endif
\ No newline at end of file
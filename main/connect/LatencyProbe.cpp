@@ -0,0 +1,69 @@
+#include "LatencyProbe.h"
+
+#include "MessageSchema.h"
+
+LatencyProbe::LatencyProbe()
+    : state(IDLE)
+    , tag(0)
+    , times()
+{}
+
+bool LatencyProbe::begin(uint32_t tag, int64_t time)
+{
+    uint8_t expected = IDLE;
+    if (!state.compare_exchange_strong(expected, RECEIVING, std::memory_order_acquire))
+    {
+        return false;
+    }
+
+    this->tag = tag;
+    times[0] = time;
+    return true;
+}
+
+void LatencyProbe::applied(int64_t time)
+{
+    times[1] = time;
+    state.store(APPLIED, std::memory_order_release);
+}
+
+void LatencyProbe::beginFrame()
+{
+    uint8_t expected = APPLIED;
+    state.compare_exchange_strong(expected, IN_FRAME, std::memory_order_acquire);
+}
+
+bool LatencyProbe::rendered(int64_t time)
+{
+    if (state.load(std::memory_order_relaxed) != IN_FRAME)
+    {
+        return false;
+    }
+
+    times[2] = time;
+    state.store(RENDERED, std::memory_order_relaxed);
+    return true;
+}
+
+void LatencyProbe::transmitted(int64_t time)
+{
+    if (state.load(std::memory_order_relaxed) != RENDERED)
+    {
+        return;
+    }
+
+    MessageSchema::LatencyEchoReply echo;
+    echo.tag = tag;
+    echo.received = times[0];
+    echo.applied = times[1];
+    echo.rendered = times[2];
+    echo.transmitted = time;
+
+    state.store(IDLE, std::memory_order_release);
+
+    if (echoHandler)
+    {
+        uint8_t buffer[sizeof(uint32_t) + MessageSchema::LatencyEchoReply::FIXED_SIZE];
+        echoHandler(buffer, echo.encode(buffer, sizeof(buffer)));
+    }
+}
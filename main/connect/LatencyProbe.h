@@ -0,0 +1,62 @@
+#ifndef LATENCY_PROBE_H
+#define LATENCY_PROBE_H
+
+#include <inttypes.h>
+#include <stddef.h>
+
+#include <atomic>
+#include <functional>
+
+/// Follows one tagged command (LatencyProbeMessage) from the socket to the LEDs and echoes when each stage was reached.
+/// Only one probe is in flight at a time, probes arriving before the previous one was echoed are not tagged.
+/// Nothing here reads a clock, the callers pass their timestamps, so the same code runs in host tools.
+///
+/// The echo is a LatencyEchoReply (see MessageSchema.h). All times are in microseconds of the device clock:
+///   received    - Packet came out of recvfrom
+///   applied     - The wrapped command was executed
+///   rendered    - The first frame started after that was ready to be sent
+///   transmitted - That frame left the output
+class LatencyProbe
+{
+public:
+    LatencyProbe();
+
+    /// Starts a probe. Called from the network task when the tagged command is received.
+    /// @return false if the previous probe was not echoed yet. Do not call applied() then.
+    bool begin(uint32_t tag, int64_t time);
+
+    /// Called from the network task after the wrapped command was executed
+    void applied(int64_t time);
+
+    /// Called from the render task before rendering a frame. Frames started before applied() do not count.
+    void beginFrame();
+
+    /// Called from the render task when a frame is handed to the output
+    /// @return true if this frame carries the probe. Call transmitted() once it left the output.
+    bool rendered(int64_t time);
+
+    /// Completes the probe and passes the echo to echoHandler
+    void transmitted(int64_t time);
+
+    /// Sends the echo, called from the render task (e.g. Connection::reply)
+    std::function<void (const uint8_t*, size_t)> echoHandler;
+
+private:
+    enum State : uint8_t
+    {
+        IDLE,
+        RECEIVING,  // Network task executes the command
+        APPLIED,    // Waiting for the next frame
+        IN_FRAME,   // Frame that contains the command is rendered
+        RENDERED    // Frame is being transmitted
+    };
+
+    std::atomic<uint8_t> state;
+
+    /// Each stage is only written by the task that owns the current state
+    uint32_t tag;
+    /// received, applied, rendered
+    int64_t times[3];
+};
+
+#endif // LATENCY_PROBE_H
@@ -0,0 +1,94 @@
+#include "LightStatus.h"
+
+#include <string.h>
+
+/// Maps [0, 1] to [0, 0xFFFF]
+static uint16_t toUnit16(double value)
+{
+    value = value < 0 ? 0 : (value > 1 ? 1 : value);
+    return static_cast<uint16_t>(value * 0xFFFF + 0.5);
+}
+
+LightStatus::Channel LightStatus::captureChannel(const CarLightBase& light, uint8_t flags)
+{
+    Channel channel;
+
+    channel.flags = flags;
+    channel.flags |= light.isOn() ? ON : 0;
+    channel.flags |= light.isBraking() ? BRAKING : 0;
+    channel.flags |= light.isEmergencyBraking() ? EMERGENCY_BRAKE : 0;
+    channel.flags |= light.isBlinking() ? BLINKING : 0;
+    channel.flags |= light.isPoliceOn() ? POLICE : 0;
+
+    const ColorConverter::rgb color = light.getColor();
+    channel.red = toUnit16(color.r);
+    channel.green = toUnit16(color.g);
+    channel.blue = toUnit16(color.b);
+    channel.colorBrightness = toUnit16(light.getColorBrightness());
+    channel.whiteBrightness = toUnit16(light.getWhiteBrightness());
+    channel.whiteTemperature = static_cast<uint16_t>(light.getWhiteTemperature() + 0.5f);
+
+    return channel;
+}
+
+size_t LightStatus::serialize(uint8_t* buffer, size_t capacity) const
+{
+    const uint8_t channels = channelCount < MAX_CHANNELS ? channelCount : MAX_CHANNELS;
+    const uint8_t strips = stripCount < MAX_STRIPS ? stripCount : MAX_STRIPS;
+    const uint8_t segments = segmentCount < MAX_SEGMENTS ? segmentCount : MAX_SEGMENTS;
+
+    const size_t size = sizeof(uint8_t) + sizeof(uint32_t) + 3 * sizeof(uint8_t) + channels * CHANNEL_SIZE + strips * STRIP_SIZE +
+                        sizeof(uint8_t) + sizeof(uint32_t) + sizeof(uint8_t) + segments * SEGMENT_SIZE;
+    if (size > capacity)
+    {
+        return 0;
+    }
+
+    size_t offset = 0;
+    auto put = [&](const void* value, size_t valueSize)
+    {
+        memcpy(&buffer[offset], value, valueSize);
+        offset += valueSize;
+    };
+    auto putChannel = [&](const Channel& channel)
+    {
+        put(&channel.flags, sizeof(uint8_t));
+        put(&channel.red, sizeof(uint16_t));
+        put(&channel.green, sizeof(uint16_t));
+        put(&channel.blue, sizeof(uint16_t));
+        put(&channel.colorBrightness, sizeof(uint16_t));
+        put(&channel.whiteBrightness, sizeof(uint16_t));
+        put(&channel.whiteTemperature, sizeof(uint16_t));
+    };
+
+    const uint8_t version = VERSION;
+    put(&version, sizeof(uint8_t));
+    put(&frame, sizeof(uint32_t));
+    put(&mode, sizeof(uint8_t));
+
+    put(&channels, sizeof(uint8_t));
+    for (size_t i = 0; i < channels; ++i)
+    {
+        putChannel(this->channels[i]);
+    }
+
+    put(&strips, sizeof(uint8_t));
+    for (size_t i = 0; i < strips; ++i)
+    {
+        put(&this->strips[i].first, sizeof(uint16_t));
+        put(&this->strips[i].count, sizeof(uint16_t));
+    }
+
+    put(&quality, sizeof(uint8_t));
+    put(&qualityChanges, sizeof(uint32_t));
+
+    put(&segments, sizeof(uint8_t));
+    for (size_t i = 0; i < segments; ++i)
+    {
+        put(&this->segments[i].range.first, sizeof(uint16_t));
+        put(&this->segments[i].range.count, sizeof(uint16_t));
+        putChannel(this->segments[i].settings);
+    }
+
+    return offset;
+}
@@ -0,0 +1,107 @@
+#ifndef LIGHT_STATUS_H
+#define LIGHT_STATUS_H
+
+#include <inttypes.h>
+#include <stddef.h>
+
+#include "../animation/CarLight.h"
+#include "../animation/SegmentedLight.h"
+
+/// Everything a host can ask about the light (LEDProtocol 0x10F).
+/// Captured once per frame by the render task and handed to the network task through a Seqlock.
+///
+/// Serialized format (little endian):
+///   uint8 VERSION, uint32 frame, uint8 mode (see Mode),
+///   uint8 channelCount, Channel[channelCount], uint8 stripCount, Strip[stripCount],
+///   uint8 quality (see FrameGovernor::Quality), uint32 qualityChanges,
+///   uint8 segmentCount, Segment[segmentCount]
+///   Channel: uint8 flags (see Flags), uint16 red, uint16 green, uint16 blue,
+///            uint16 colorBrightness, uint16 whiteBrightness (0xFFFF = 1), uint16 whiteTemperature [Kelvin]
+///   Strip:   uint16 first LED, uint16 LED count
+///   Segment: uint16 first pixel, uint16 pixel count, Channel (the settings of the segment, see SegmentedLight)
+/// Channels are the channels of LEDProtocol requests. Channel 0 reports the first segment, which stands for the whole light.
+/// New fields are only appended, hosts ignore what they do not know.
+struct LightStatus
+{
+    static const uint8_t VERSION = 1;
+
+    /// What produces the output
+    enum Mode
+    {
+        RENDERED,   // CarLight, timeline and shader
+        INDEXED,    // Palette and indexed framebuffer
+        STREAM,     // Frames streamed by the host
+        CLIP        // Clip from flash
+    };
+
+    enum Flags
+    {
+        ON               = 1 << 0,
+        BRAKING          = 1 << 1,
+        EMERGENCY_BRAKE  = 1 << 2,
+        BLINKING         = 1 << 3,
+        POLICE           = 1 << 4,
+        TIMELINE_PLAYING = 1 << 5,
+        SHADER_ACTIVE    = 1 << 6
+    };
+
+    struct Channel
+    {
+        uint8_t flags;
+        uint16_t red;
+        uint16_t green;
+        uint16_t blue;
+        uint16_t colorBrightness;
+        uint16_t whiteBrightness;
+        uint16_t whiteTemperature;
+    };
+
+    struct Strip
+    {
+        uint16_t first;
+        uint16_t count;
+    };
+
+    struct Segment
+    {
+        LightSegment range;
+        Channel settings;
+    };
+
+    /// We only drive one channel on one strip so far
+    static const size_t MAX_CHANNELS = 1;
+    static const size_t MAX_STRIPS = 1;
+    static const size_t MAX_SEGMENTS = SegmentedLightBase::MAX_SEGMENTS;
+
+    static const size_t CHANNEL_SIZE = sizeof(uint8_t) + 6 * sizeof(uint16_t);
+    static const size_t STRIP_SIZE = 2 * sizeof(uint16_t);
+    static const size_t SEGMENT_SIZE = 2 * sizeof(uint16_t) + CHANNEL_SIZE;
+    static const size_t MAX_SERIALIZED_SIZE = sizeof(uint8_t) + sizeof(uint32_t) + 3 * sizeof(uint8_t) +
+                                              MAX_CHANNELS * CHANNEL_SIZE + MAX_STRIPS * STRIP_SIZE +
+                                              sizeof(uint8_t) + sizeof(uint32_t) +
+                                              sizeof(uint8_t) + MAX_SEGMENTS * SEGMENT_SIZE;
+
+    /// Reads the settings of a light into a channel. Only call this from the render task.
+    /// @param flags Flags of things outside the light (TIMELINE_PLAYING, SHADER_ACTIVE)
+    static Channel captureChannel(const CarLightBase& light, uint8_t flags);
+
+    /// @return Bytes written to buffer, 0 if it is too small
+    size_t serialize(uint8_t* buffer, size_t capacity) const;
+
+    /// Rendered frames since boot
+    uint32_t frame;
+    uint8_t mode;
+    uint8_t channelCount;
+    Channel channels[MAX_CHANNELS];
+    uint8_t stripCount;
+    Strip strips[MAX_STRIPS];
+
+    /// Rendering quality of the last frame and how often it changed since boot (see FrameGovernor)
+    uint8_t quality;
+    uint32_t qualityChanges;
+
+    uint8_t segmentCount;
+    Segment segments[MAX_SEGMENTS];
+};
+
+#endif // LIGHT_STATUS_H
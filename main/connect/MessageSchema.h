@@ -0,0 +1,230 @@
+#ifndef MESSAGE_SCHEMA_H
+#define MESSAGE_SCHEMA_H
+
+#include <inttypes.h>
+#include <stddef.h>
+#include <string.h>
+
+/// Single description of every LEDProtocol message. The firmware parser (LEDProtocol.cpp) and the host client
+/// (tools/client/LEDClient.h) are both generated from the tables below, so a field is only ever written down once.
+///
+/// Wire format (little endian, no padding): uint32 message ID followed by the fields in table order.
+/// A TAIL takes all remaining bytes and must be the last field. Requests start with the channel (0 = car light).
+/// Bytes after the last field of a message without a TAIL are ignored.
+///
+/// Table syntax:
+///   MESSAGE(Type, ID, LATEST)  LATEST: Only the newest message of this type per channel matters (see LEDClient)
+///   FIELD(type, name)          Fixed size field, copied out of the buffer
+///   TAIL(name, minimum)        Variable size field of at least minimum bytes, points into the buffer (name, nameSize)
+///   END
+///
+/// Every message becomes a struct with ID, LATEST, FIXED_SIZE, MIN_TAIL and
+///   bool decode(const uint8_t* payload, size_t size)  Reads the bytes after the ID, false if they are too short
+///   size_t encode(uint8_t* buffer, size_t capacity)   Writes ID and fields, 0 if capacity is too small
+///   size_t getSize()                                  Bytes encode() writes
+
+/// Five uint16 per palette entry: red, green, blue, warm white, cold white (0xFFFF = 1)
+#define MESSAGE_SCHEMA_PALETTE_ENTRY_SIZE (5 * sizeof(uint16_t))
+
+/// Host to light
+#define LED_PROTOCOL_REQUESTS(MESSAGE, FIELD, TAIL, END) \
+    /* Base color of the light, 0xFFFF = 1 */ \
+    MESSAGE(ColorMessage, 0x100, true) \
+        FIELD(uint8_t, channel) FIELD(uint16_t, red) FIELD(uint16_t, green) FIELD(uint16_t, blue) END \
+    /* Color brightness, 0xFFFF = 1 */ \
+    MESSAGE(DimMessage, 0x101, true) \
+        FIELD(uint8_t, channel) FIELD(uint16_t, dim) END \
+    /* Not implemented */ \
+    MESSAGE(ValueMessage, 0x102, true) \
+        FIELD(uint8_t, channel) FIELD(uint16_t, red) FIELD(uint16_t, green) FIELD(uint16_t, blue) FIELD(uint8_t, raw) END \
+    /* Not implemented */ \
+    MESSAGE(FilterMessage, 0x103, true) \
+        FIELD(uint8_t, channel) FIELD(uint8_t, useFilter) END \
+    /* Pixel filters with the time constant resistance * capacitance [seconds]. The tail is an optional */ \
+    /* uint8 response (see FilterDesigner::Response), without it the light's default (CarLightBase::DEFAULT_FILTER_RESPONSE). */ \
+    MESSAGE(SetFilterValuesMessage, 0x104, true) \
+        FIELD(uint8_t, channel) FIELD(float, capacitance) FIELD(float, resistance) TAIL(response, 0) END \
+    /* Filter values plus the initial filter state */ \
+    MESSAGE(SetFilterValuesBufferMessage, 0x105, true) \
+        FIELD(uint8_t, channel) FIELD(float, capacitance) FIELD(float, resistance) FIELD(float, x1) FIELD(float, y1) TAIL(response, 0) END \
+    /* White brightness, 0xFFFF = 1 */ \
+    MESSAGE(WhiteDimMessage, 0x106, true) \
+        FIELD(uint8_t, channel) FIELD(uint16_t, dim) END \
+    /* White temperature [Kelvin] */ \
+    MESSAGE(WhiteTemperatureMessage, 0x107, true) \
+        FIELD(uint8_t, channel) FIELD(uint16_t, temperature) END \
+    /* 1 = on */ \
+    MESSAGE(TurnOnOffMessage, 0x108, true) \
+        FIELD(uint8_t, channel) FIELD(uint8_t, on) END \
+    /* Timeline script (see Timeline.h), starts playing it. A script without tracks stops the current one. */ \
+    MESSAGE(TimelineMessage, 0x109, true) \
+        FIELD(uint8_t, channel) TAIL(script, 1) END \
+    /* Pixel shader program (see PixelShader.h). An empty program turns the shader off. */ \
+    MESSAGE(ShaderMessage, 0x10A, true) \
+        FIELD(uint8_t, channel) TAIL(program, 2) END \
+    /* Consecutive palette entries of the indexed framebuffer, starting at first */ \
+    MESSAGE(PaletteMessage, 0x10B, false) \
+        FIELD(uint8_t, channel) FIELD(uint8_t, first) TAIL(entries, MESSAGE_SCHEMA_PALETTE_ENTRY_SIZE) END \
+    /* Palette indices of consecutive LEDs of the indexed framebuffer */ \
+    MESSAGE(IndexMessage, 0x10C, false) \
+        FIELD(uint8_t, channel) FIELD(uint16_t, start) TAIL(indices, 1) END \
+    /* Streamed wire format frame coded against baseId (see FrameCodec.h), FrameStreamBase::NO_FRAME for keyframes */ \
+    MESSAGE(StreamFrameMessage, 0x10D, false) \
+        FIELD(uint8_t, channel) FIELD(uint16_t, frameId) FIELD(uint16_t, baseId) TAIL(payload, 0) END \
+    /* Clip playback: 0 = stop, 1 = play once, 2 = loop */ \
+    MESSAGE(ClipMessage, 0x10E, true) \
+        FIELD(uint8_t, channel) FIELD(uint8_t, command) END \
+    /* Answered with StatusReply */ \
+    MESSAGE(StatusQueryMessage, 0x10F, true) \
+        FIELD(uint8_t, channel) END \
+    /* Wraps a plain request (may be empty) and is answered with LatencyEchoReply (see LatencyProbe.h) */ \
+    MESSAGE(LatencyProbeMessage, 0x110, false) \
+        FIELD(uint8_t, channel) FIELD(uint32_t, tag) TAIL(command, 0) END \
+    /* Trace recording: 0 = stop, 1 = start, 2 = dump as TraceChunkReply (see TraceRecorder.h) */ \
+    MESSAGE(TraceMessage, 0x111, false) \
+        FIELD(uint8_t, channel) FIELD(uint8_t, command) END \
+    /* Several requests in one datagram, each preceded by its uint16 size. Batches do not nest. */ \
+    MESSAGE(BatchMessage, 0x112, false) \
+        FIELD(uint8_t, channel) TAIL(messages, 0) END \
+    /* A request for the nodes in any of the groups (bit mask) or with their node ID set in nodes (see NodeAddress.h). */ \
+    /* Envelopes (addressed, probe, segment) only wrap plain requests, an addressed message wraps a batch only as */ \
+    /* the outermost message of a datagram. */ \
+    MESSAGE(AddressedMessage, 0x113, false) \
+        FIELD(uint8_t, channel) FIELD(uint32_t, groups) FIELD(uint64_t, nodes) TAIL(message, 4) END \
+    /* Sends one plain request to a segment of the light (1 = first, 0 = all). Batches of these update several zones at once. */ \
+    MESSAGE(SegmentMessage, 0x114, false) \
+        FIELD(uint8_t, channel) FIELD(uint8_t, segment) TAIL(message, 4) END
+
+/// Light to host
+#define LED_PROTOCOL_REPLIES(MESSAGE, FIELD, TAIL, END) \
+    /* Reference frame of the stream after every streamed frame */ \
+    MESSAGE(FrameAckReply, 0x10D, true) \
+        FIELD(uint16_t, frameId) END \
+    /* Serialized LightStatus */ \
+    MESSAGE(StatusReply, 0x10F, true) \
+        TAIL(status, 1) END \
+    /* Device times of a LatencyProbeMessage [us] */ \
+    MESSAGE(LatencyEchoReply, 0x110, false) \
+        FIELD(uint32_t, tag) FIELD(int64_t, received) FIELD(int64_t, applied) FIELD(int64_t, rendered) FIELD(int64_t, transmitted) END \
+    /* One chunk of a trace dump */ \
+    MESSAGE(TraceChunkReply, 0x111, false) \
+        FIELD(uint16_t, chunk) FIELD(uint16_t, chunkCount) TAIL(data, 0) END
+
+namespace MessageSchema
+{
+
+/// Messages without a TAIL
+struct NoTail
+{
+    static const size_t MIN_TAIL = 0;
+    static const bool HAS_TAIL = false;
+};
+
+// Sizes, in a struct of their own because the field list is a single expression
+#define SCHEMA_LAYOUT_MESSAGE(TYPE, ID, LATEST) struct TYPE##Layout : NoTail { static const size_t FIXED_SIZE = 0
+#define SCHEMA_LAYOUT_FIELD(FIELD_TYPE, NAME) + sizeof(FIELD_TYPE)
+#define SCHEMA_LAYOUT_TAIL(NAME, MINIMUM) ; static const size_t MIN_TAIL = MINIMUM; static const bool HAS_TAIL = true
+#define SCHEMA_LAYOUT_END ; };
+
+// Message structs
+#define SCHEMA_STRUCT_MESSAGE(TYPE, ID_VALUE, LATEST_VALUE) \
+    struct TYPE : TYPE##Layout \
+    { \
+        static const uint32_t ID = ID_VALUE; \
+        static const bool LATEST = LATEST_VALUE;
+#define SCHEMA_STRUCT_FIELD(FIELD_TYPE, NAME) FIELD_TYPE NAME;
+#define SCHEMA_STRUCT_TAIL(NAME, MINIMUM) const uint8_t* NAME; size_t NAME##Size;
+#define SCHEMA_STRUCT_END \
+        bool decode(const uint8_t* payload, size_t size); \
+        size_t encode(uint8_t* buffer, size_t capacity) const; \
+        size_t getSize() const; \
+    };
+
+// decode()
+#define SCHEMA_DECODE_MESSAGE(TYPE, ID, LATEST) \
+    inline bool TYPE::decode(const uint8_t* payload, size_t size) \
+    { \
+        if (size < FIXED_SIZE + MIN_TAIL) \
+        { \
+            return false; \
+        } \
+        size_t offset = 0;
+#define SCHEMA_DECODE_FIELD(FIELD_TYPE, NAME) memcpy(&NAME, &payload[offset], sizeof(FIELD_TYPE)); offset += sizeof(FIELD_TYPE);
+#define SCHEMA_DECODE_TAIL(NAME, MINIMUM) NAME = &payload[offset]; NAME##Size = size - offset; offset = size;
+#define SCHEMA_DECODE_END \
+        (void) offset; \
+        return true; \
+    }
+
+// getSize()
+#define SCHEMA_SIZE_MESSAGE(TYPE, ID, LATEST) inline size_t TYPE::getSize() const { return sizeof(uint32_t) + FIXED_SIZE
+#define SCHEMA_SIZE_FIELD(FIELD_TYPE, NAME)
+#define SCHEMA_SIZE_TAIL(NAME, MINIMUM) + NAME##Size
+#define SCHEMA_SIZE_END ; }
+
+// encode()
+#define SCHEMA_ENCODE_MESSAGE(TYPE, ID_VALUE, LATEST) \
+    inline size_t TYPE::encode(uint8_t* buffer, size_t capacity) const \
+    { \
+        if (capacity < getSize()) \
+        { \
+            return 0; \
+        } \
+        const uint32_t id = ID; \
+        memcpy(buffer, &id, sizeof(uint32_t)); \
+        size_t offset = sizeof(uint32_t);
+#define SCHEMA_ENCODE_FIELD(FIELD_TYPE, NAME) memcpy(&buffer[offset], &NAME, sizeof(FIELD_TYPE)); offset += sizeof(FIELD_TYPE);
+#define SCHEMA_ENCODE_TAIL(NAME, MINIMUM) if (NAME##Size > 0) { memcpy(&buffer[offset], NAME, NAME##Size); } offset += NAME##Size;
+#define SCHEMA_ENCODE_END \
+        return offset; \
+    }
+
+#define SCHEMA_GENERATE(PASS) \
+    LED_PROTOCOL_REQUESTS(PASS##_MESSAGE, PASS##_FIELD, PASS##_TAIL, PASS##_END) \
+    LED_PROTOCOL_REPLIES(PASS##_MESSAGE, PASS##_FIELD, PASS##_TAIL, PASS##_END)
+
+SCHEMA_GENERATE(SCHEMA_LAYOUT)
+SCHEMA_GENERATE(SCHEMA_STRUCT)
+SCHEMA_GENERATE(SCHEMA_DECODE)
+SCHEMA_GENERATE(SCHEMA_SIZE)
+SCHEMA_GENERATE(SCHEMA_ENCODE)
+
+#undef SCHEMA_GENERATE
+#undef SCHEMA_LAYOUT_MESSAGE
+#undef SCHEMA_LAYOUT_FIELD
+#undef SCHEMA_LAYOUT_TAIL
+#undef SCHEMA_LAYOUT_END
+#undef SCHEMA_STRUCT_MESSAGE
+#undef SCHEMA_STRUCT_FIELD
+#undef SCHEMA_STRUCT_TAIL
+#undef SCHEMA_STRUCT_END
+#undef SCHEMA_DECODE_MESSAGE
+#undef SCHEMA_DECODE_FIELD
+#undef SCHEMA_DECODE_TAIL
+#undef SCHEMA_DECODE_END
+#undef SCHEMA_SIZE_MESSAGE
+#undef SCHEMA_SIZE_FIELD
+#undef SCHEMA_SIZE_TAIL
+#undef SCHEMA_SIZE_END
+#undef SCHEMA_ENCODE_MESSAGE
+#undef SCHEMA_ENCODE_FIELD
+#undef SCHEMA_ENCODE_TAIL
+#undef SCHEMA_ENCODE_END
+
+/// Size prefix of every message in a BatchMessage
+typedef uint16_t BatchEntrySize;
+
+/// Largest datagram the light receives (receive buffer of Connection), longer ones are cut off
+const size_t MAX_DATAGRAM = 512;
+
+/// ClipMessage::command
+enum ClipCommand
+{
+    CLIP_STOP = 0,
+    CLIP_PLAY_ONCE = 1,
+    CLIP_PLAY_LOOP = 2
+};
+
+} // namespace MessageSchema
+
+#endif // MESSAGE_SCHEMA_H
@@ -0,0 +1,36 @@
+#include "NodeAddress.h"
+
+NodeAddress::NodeAddress(uint8_t node, uint32_t groups)
+    : node(node)
+    , groups(groups)
+{}
+
+bool NodeAddress::matches(const MessageSchema::AddressedMessage& message) const
+{
+    const bool inNodes = node < MAX_NODES && ((message.nodes >> node) & 1) != 0;
+    return inNodes || (message.groups & groups) != 0;
+}
+
+bool NodeAddress::accept(const uint8_t*& buffer, size_t& size) const
+{
+    uint32_t id = 0;
+    if (size >= sizeof(uint32_t))
+    {
+        memcpy(&id, buffer, sizeof(uint32_t));
+    }
+    if (id != MessageSchema::AddressedMessage::ID)
+    {
+        return true;
+    }
+
+    // Invalid envelopes are dropped here, the parser would only log them
+    MessageSchema::AddressedMessage message = {};
+    if (!message.decode(&buffer[sizeof(uint32_t)], size - sizeof(uint32_t)) || !matches(message))
+    {
+        return false;
+    }
+
+    buffer = message.message;
+    size = message.messageSize;
+    return true;
+}
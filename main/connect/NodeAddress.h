@@ -0,0 +1,39 @@
+#ifndef NODE_ADDRESS_H
+#define NODE_ADDRESS_H
+
+#include "MessageSchema.h"
+
+#include <inttypes.h>
+#include <stddef.h>
+
+/// Identity of this light in a fleet that shares one multicast group (see Connection).
+/// A host reaches a subset of the fleet with a single datagram by wrapping the request in an AddressedMessage.
+/// The request applies to nodes that are in any of its groups or whose node ID bit is set in its node mask.
+/// Datagrams without the envelope apply to every node that receives them.
+class NodeAddress
+{
+public:
+    /// Node IDs are bits of the uint64 node mask
+    static const uint8_t MAX_NODES = 64;
+
+    /// @param node ID of this light, unique in the fleet [0, MAX_NODES)
+    /// @param groups Bit mask of the groups this light belongs to
+    NodeAddress(uint8_t node, uint32_t groups);
+
+    /// @return true if the addressed message is meant for this light
+    bool matches(const MessageSchema::AddressedMessage& message) const;
+
+    /// Drops datagrams for other nodes before they are parsed, called from the network task.
+    /// An AddressedMessage for this light is unwrapped: buffer and size are moved to the wrapped request.
+    /// @return false if the datagram is not for this light
+    bool accept(const uint8_t*& buffer, size_t& size) const;
+
+    uint8_t getNode() const { return node; }
+    uint32_t getGroups() const { return groups; }
+
+private:
+    const uint8_t node;
+    const uint32_t groups;
+};
+
+#endif
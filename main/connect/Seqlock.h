@@ -0,0 +1,77 @@
+#ifndef SEQLOCK_H
+#define SEQLOCK_H
+
+#include <inttypes.h>
+#include <stddef.h>
+#include <string.h>
+
+#include <atomic>
+#include <type_traits>
+
+/// Hands a value from one writer task to any number of reader tasks without ever blocking the writer.
+/// The writer bumps a sequence counter before and after every write. Readers copy the value and
+/// retry if the counter was odd (write in progress) or changed while they copied.
+/// The value is kept in atomic words, so a torn copy is never undefined behavior, only retried.
+/// Meant for small values written once per frame and read rarely, e.g. a status snapshot.
+template <typename T>
+class Seqlock
+{
+    static_assert(std::is_trivially_copyable<T>::value, "Seqlock values are copied word by word");
+
+public:
+    Seqlock() : sequence(0), words() {}
+
+    /// Replaces the value. Only ever call this from one task.
+    void write(const T& value)
+    {
+        uint32_t buffer[WORD_COUNT] = {};
+        memcpy(buffer, &value, sizeof(T));
+
+        const uint32_t start = sequence.load(std::memory_order_relaxed);
+        sequence.store(start + 1, std::memory_order_relaxed);
+        std::atomic_thread_fence(std::memory_order_release);
+
+        for (size_t i = 0; i < WORD_COUNT; ++i)
+        {
+            words[i].store(buffer[i], std::memory_order_relaxed);
+        }
+
+        sequence.store(start + 2, std::memory_order_release);
+    }
+
+    /// Copies the last written value. Spins while a write is in progress, which takes well below a microsecond.
+    /// @return false if nothing was written yet
+    bool read(T& value) const
+    {
+        uint32_t buffer[WORD_COUNT];
+        uint32_t start;
+
+        do
+        {
+            start = sequence.load(std::memory_order_acquire);
+            for (size_t i = 0; i < WORD_COUNT; ++i)
+            {
+                buffer[i] = words[i].load(std::memory_order_relaxed);
+            }
+            std::atomic_thread_fence(std::memory_order_acquire);
+        }
+        while ((start & 1) || start != sequence.load(std::memory_order_relaxed));
+
+        if (start == 0)
+        {
+            return false;
+        }
+
+        memcpy(&value, buffer, sizeof(T));
+        return true;
+    }
+
+private:
+    static const size_t WORD_COUNT = (sizeof(T) + sizeof(uint32_t) - 1) / sizeof(uint32_t);
+
+    /// Odd while a write is in progress
+    std::atomic<uint32_t> sequence;
+    std::atomic<uint32_t> words[WORD_COUNT];
+};
+
+#endif // SEQLOCK_H
@@ -0,0 +1,114 @@
+#include "TraceRecorder.h"
+
+#include <string.h>
+
+#include "MessageSchema.h"
+
+TraceRecorderBase::TraceRecorderBase(uint8_t* ring, size_t capacity)
+    : ring(ring)
+    , capacity(capacity)
+    , tail(0)
+    , used(0)
+    , recording(false)
+    , startFrame(0)
+    , frame(0)
+{}
+
+void TraceRecorderBase::record(const uint8_t* buffer, size_t size)
+{
+    const size_t recordSize = RECORD_HEADER_SIZE + size;
+    if (!recording || recordSize > capacity || size > UINT16_MAX)
+    {
+        return;
+    }
+
+    uint32_t id = 0;
+    if (size >= sizeof(uint32_t))
+    {
+        memcpy(&id, buffer, sizeof(uint32_t));
+    }
+    if (id == MessageSchema::TraceMessage::ID)
+    {
+        return;
+    }
+
+    // Drop the oldest records until the new one fits
+    while (capacity - used < recordSize)
+    {
+        uint16_t oldSize;
+        read(tail + sizeof(uint32_t), &oldSize, sizeof(uint16_t));
+        tail = (tail + RECORD_HEADER_SIZE + oldSize) % capacity;
+        used -= RECORD_HEADER_SIZE + oldSize;
+    }
+
+    const uint32_t recordFrame = frame.load(std::memory_order_relaxed) - startFrame;
+    const uint16_t recordDataSize = size;
+    const size_t head = tail + used;
+    write(head, &recordFrame, sizeof(uint32_t));
+    write(head + sizeof(uint32_t), &recordDataSize, sizeof(uint16_t));
+    write(head + RECORD_HEADER_SIZE, buffer, size);
+    used += recordSize;
+}
+
+void TraceRecorderBase::start()
+{
+    tail = 0;
+    used = 0;
+    startFrame = frame.load(std::memory_order_relaxed);
+    recording = true;
+}
+
+void TraceRecorderBase::stop()
+{
+    recording = false;
+}
+
+bool TraceRecorderBase::isRecording() const
+{
+    return recording;
+}
+
+void TraceRecorderBase::dump(const std::function<void (const uint8_t*, size_t)>& send) const
+{
+    uint8_t data[DUMP_CHUNK];
+    uint8_t buffer[sizeof(uint32_t) + MessageSchema::TraceChunkReply::FIXED_SIZE + DUMP_CHUNK];
+
+    MessageSchema::TraceChunkReply reply;
+    reply.chunkCount = (used + DUMP_CHUNK - 1) / DUMP_CHUNK;
+    reply.data = data;
+
+    for (reply.chunk = 0; reply.chunk < reply.chunkCount; ++reply.chunk)
+    {
+        const size_t offset = reply.chunk * DUMP_CHUNK;
+        reply.dataSize = used - offset < DUMP_CHUNK ? used - offset : DUMP_CHUNK;
+
+        read(tail + offset, data, reply.dataSize);
+        send(buffer, reply.encode(buffer, sizeof(buffer)));
+    }
+}
+
+void TraceRecorderBase::nextFrame()
+{
+    frame.fetch_add(1, std::memory_order_relaxed);
+}
+
+size_t TraceRecorderBase::getSize() const
+{
+    return used;
+}
+
+void TraceRecorderBase::write(size_t offset, const void* source, size_t size)
+{
+    offset %= capacity;
+    const size_t first = size < capacity - offset ? size : capacity - offset;
+    memcpy(&ring[offset], source, first);
+    memcpy(ring, static_cast<const uint8_t*>(source) + first, size - first);
+}
+
+void TraceRecorderBase::read(size_t offset, void* destination, size_t size) const
+{
+    offset %= capacity;
+    const size_t first = size < capacity - offset ? size : capacity - offset;
+    memcpy(destination, &ring[offset], first);
+    memcpy(static_cast<uint8_t*>(destination) + first, ring, size - first);
+}
@@ -0,0 +1,91 @@
+#ifndef TRACE_RECORDER_H
+#define TRACE_RECORDER_H
+
+#include <inttypes.h>
+#include <stddef.h>
+
+#include <array>
+#include <atomic>
+#include <functional>
+
+/// Records received datagrams together with the frame they arrived in, so a session can be replayed on the host
+/// (tools/trace_replay.cpp). Keeps the newest records in a RAM ring and drops the oldest ones when it is full.
+/// Recording and dumping both run on the network task, so neither needs a lock.
+/// Use TraceRecorder<Capacity> to get a recorder with its own ring.
+///
+/// Trace format (little endian), oldest record first:
+///   Record: uint32 frame (since start()), uint16 size, datagram[size]
+///
+/// Controlled with TraceMessage (see Command). DUMP is answered with TraceChunkReplies of up to DUMP_CHUNK bytes.
+class TraceRecorderBase
+{
+public:
+    enum Command
+    {
+        STOP = 0,
+        START = 1,  // Clears the trace
+        DUMP = 2
+    };
+
+    /// Trace bytes per dump message
+    static const size_t DUMP_CHUNK = 512;
+    static const size_t RECORD_HEADER_SIZE = sizeof(uint32_t) + sizeof(uint16_t);
+
+    /// Appends a datagram. Called from the network task before it is parsed. Control messages are not recorded.
+    void record(const uint8_t* buffer, size_t size);
+
+    /// Clears the trace and starts recording at frame 0
+    void start();
+    void stop();
+    bool isRecording() const;
+
+    /// Sends the whole trace in chunks. Called from the network task.
+    void dump(const std::function<void (const uint8_t*, size_t)>& send) const;
+
+    /// Called from the render task at the start of every frame
+    void nextFrame();
+
+    /// Bytes of the trace
+    size_t getSize() const;
+
+protected:
+    /// Storage is owned by the derived class
+    TraceRecorderBase(uint8_t* ring, size_t capacity);
+
+private:
+    /// Copies between the ring and linear memory, wrapping around the end of the ring
+    void write(size_t offset, const void* source, size_t size);
+    void read(size_t offset, void* destination, size_t size) const;
+
+    uint8_t* ring;
+    const size_t capacity;
+
+    /// Oldest record
+    size_t tail;
+    size_t used;
+
+    bool recording;
+    uint32_t startFrame;
+
+    /// Frames started by the render task
+    std::atomic<uint32_t> frame;
+};
+
+template <size_t Capacity>
+struct TraceRecorderStorage
+{
+    std::array<uint8_t, Capacity> traceRing;
+};
+
+/// Trace recorder with a ring of Capacity bytes
+template <size_t Capacity>
+class TraceRecorder : private TraceRecorderStorage<Capacity>, public TraceRecorderBase
+{
+public:
+    TraceRecorder()
+        : TraceRecorderStorage<Capacity>()
+        , TraceRecorderBase(this->traceRing.data(), Capacity)
+    {}
+};
+
+#endif // TRACE_RECORDER_H
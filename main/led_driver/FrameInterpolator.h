@@ -0,0 +1,60 @@
+#ifndef FRAME_INTERPOLATOR_H
+#define FRAME_INTERPOLATOR_H
+
+#include <inttypes.h>
+#include <stddef.h>
+
+#include <array>
+
+/// Blends the last two rendered keyframes for every output frame.
+/// Lets the effects render at a low rate while the strip is refreshed at a high rate.
+/// Works directly on wire format bytes in integer math, so it does not care about channel order.
+/// Adds one keyframe of latency: we move from the previous to the latest keyframe while the next one is rendered.
+/// @tparam Size Size of one frame in bytes (e.g. LEDDriver<N>::BUFFER_SIZE)
+template <size_t Size>
+class FrameInterpolator
+{
+public:
+    /// Phase of a blend that shows the latest keyframe
+    static const uint16_t PHASE_ONE = 256;
+
+    FrameInterpolator()
+        : frames()
+        , latest(0)
+    {}
+
+    /// Buffer to render the next keyframe into. Becomes the latest keyframe with pushKeyframe().
+    uint8_t* nextKeyframe()
+    {
+        return frames[1 - latest].data();
+    }
+
+    /// Makes the buffer returned by nextKeyframe() the latest keyframe
+    void pushKeyframe()
+    {
+        latest = 1 - latest;
+    }
+
+    /// Writes the blend of the previous and the latest keyframe
+    /// @param out Output frame (e.g. LEDDriver::getBuffer())
+    /// @param phase 0 = previous keyframe, PHASE_ONE = latest keyframe
+    void blend(uint8_t* __restrict out, uint16_t phase) const
+    {
+        const uint8_t* __restrict from = frames[1 - latest].data();
+        const uint8_t* __restrict to = frames[latest].data();
+        const int16_t weight = phase;
+
+        for (size_t i = 0; i < Size; ++i)
+        {
+            out[i] = from[i] + (((to[i] - from[i]) * weight) >> 8);
+        }
+    }
+
+private:
+    std::array<std::array<uint8_t, Size>, 2> frames;
+
+    /// Index of the latest keyframe in frames
+    size_t latest;
+};
+
+#endif // FRAME_INTERPOLATOR_H
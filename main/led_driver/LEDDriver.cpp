@@ -1,17 +1,9 @@
 #include "LEDDriver.h"
 
-#include <cstring>
 #include <esp_system.h>
 
-LEDDriver::LEDDriver(gpio_num_t pin, size_t leds)
-    : LED_COUNT(leds)
-    , colorBuffer(NULL)
+LEDDriverBase::LEDDriverBase(gpio_num_t pin)
 {
-    const int CHANNELS = 5; // Red, Green, Blue, Cold white, Warm white
-    const int CHANNEL_BYTES = 1;
-
-    colorBuffer = new uint8_t[LED_COUNT * CHANNELS * CHANNEL_BYTES];
-
     const int RESOLUTION_HZ = 20000000; // 20 MHz
     const int RESOLUTION_NS = 50; // [ns] (=1/20 MHZ)
 
@@ -54,77 +46,27 @@ LEDDriver::LEDDriver(gpio_num_t pin, size_t leds)
     ledEncoder.resetWord.level1 = 0;
 
     // We also act as an encoder. We are the first instance that the rmt library calls. We then manage the two other encoders accordingly.
-    ledEncoder.parentEncoder.encode = &LEDDriver::encoderEncode;
-    ledEncoder.parentEncoder.reset = &LEDDriver::encoderReset;
-    ledEncoder.parentEncoder.del = &LEDDriver::encoderDelete;
+    ledEncoder.parentEncoder.encode = &LEDDriverBase::encoderEncode;
+    ledEncoder.parentEncoder.reset = &LEDDriverBase::encoderReset;
+    ledEncoder.parentEncoder.del = &LEDDriverBase::encoderDelete;
 
     ledEncoder.state = RMT_ENCODING_RESET;
 }
 
-void LEDDriver::set(size_t index, uint64_t color)
-{
-    const int BYTES_PER_LED = 5;
-    memcpy(&colorBuffer[index * BYTES_PER_LED], &color, BYTES_PER_LED);
-}
-
-void LEDDriver::set(uint64_t color)
-{
-    const int BYTES_PER_LED = 5;
-    for (size_t i = 0; i < LED_COUNT; ++i)
-    {
-        memcpy(&colorBuffer[i * BYTES_PER_LED], &color, BYTES_PER_LED);
-    }
-    rmt_transmit_config_t transmitConfig;
-    transmitConfig.loop_count = 0;
-    transmitConfig.flags.eot_level = 0;
-    rmt_transmit(channel, &ledEncoder.parentEncoder, colorBuffer, BYTES_PER_LED * LED_COUNT, &transmitConfig);
-}
-
-void LEDDriver::set(uint8_t red, uint8_t green, uint8_t blue, uint8_t warm, uint8_t cold)
-{
-    const int BYTES_PER_LED = 5;
-    for (size_t i = 0; i < LED_COUNT; ++i)
-    {
-        memcpy(&colorBuffer[i * BYTES_PER_LED], &green, sizeof(uint8_t));
-        memcpy(&colorBuffer[i * BYTES_PER_LED + 1], &red, sizeof(uint8_t));
-        memcpy(&colorBuffer[i * BYTES_PER_LED + 2], &blue, sizeof(uint8_t));
-        memcpy(&colorBuffer[i * BYTES_PER_LED + 3], &warm, sizeof(uint8_t));
-        memcpy(&colorBuffer[i * BYTES_PER_LED + 4], &cold, sizeof(uint8_t));
-    }
-    rmt_transmit_config_t transmitConfig;
-    transmitConfig.loop_count = 0;
-    transmitConfig.flags.eot_level = 0;
-    rmt_transmit(channel, &ledEncoder.parentEncoder, colorBuffer, BYTES_PER_LED * LED_COUNT, &transmitConfig);
-}
-
-void LEDDriver::set(size_t index, uint8_t red, uint8_t green, uint8_t blue, uint8_t warm, uint8_t cold)
-{
-    const int BYTES_PER_LED = 5;
-    if (index < LED_COUNT)
-    {
-        memcpy(&colorBuffer[index * BYTES_PER_LED], &green, sizeof(uint8_t));
-        memcpy(&colorBuffer[index * BYTES_PER_LED + 1], &red, sizeof(uint8_t));
-        memcpy(&colorBuffer[index * BYTES_PER_LED + 2], &blue, sizeof(uint8_t));
-        memcpy(&colorBuffer[index * BYTES_PER_LED + 3], &warm, sizeof(uint8_t));
-        memcpy(&colorBuffer[index * BYTES_PER_LED + 4], &cold, sizeof(uint8_t));
-    }
-}
-
-void LEDDriver::refresh()
+void LEDDriverBase::transmit(const uint8_t* data, size_t size)
 {
-    const int BYTES_PER_LED = 5;
     rmt_transmit_config_t transmitConfig;
     transmitConfig.loop_count = 0;
     transmitConfig.flags.eot_level = 0;
-    rmt_transmit(channel, &ledEncoder.parentEncoder, colorBuffer, BYTES_PER_LED * LED_COUNT, &transmitConfig);
+    rmt_transmit(channel, &ledEncoder.parentEncoder, data, size, &transmitConfig);
 }
 
-void LEDDriver::wait()
+void LEDDriverBase::wait()
 {
     rmt_tx_wait_all_done(channel, -1);
 }
 
-size_t IRAM_ATTR LEDDriver::encoderEncode(rmt_encoder_t* encoder, rmt_channel_handle_t tx_channel, const void* primary_data, size_t data_size, rmt_encode_state_t* ret_state)
+size_t IRAM_ATTR LEDDriverBase::encoderEncode(rmt_encoder_t* encoder, rmt_channel_handle_t tx_channel, const void* primary_data, size_t data_size, rmt_encode_state_t* ret_state)
 {
     EncoderContainer* instance = __containerof(encoder, EncoderContainer, parentEncoder);
     rmt_encode_state_t resultState = RMT_ENCODING_RESET;
@@ -163,7 +105,7 @@ size_t IRAM_ATTR LEDDriver::encoderEncode(rmt_encoder_t* encoder, rmt_channel_ha
     return encoded;
 }
 
-esp_err_t LEDDriver::encoderReset(rmt_encoder_t* encoder)
+esp_err_t LEDDriverBase::encoderReset(rmt_encoder_t* encoder)
 {
     EncoderContainer* container = __containerof(encoder, EncoderContainer, parentEncoder);
     esp_err_t error = ESP_OK;
@@ -173,7 +115,7 @@ esp_err_t LEDDriver::encoderReset(rmt_encoder_t* encoder)
     return error;
 }
 
-esp_err_t LEDDriver::encoderDelete(rmt_encoder_t* encoder)
+esp_err_t LEDDriverBase::encoderDelete(rmt_encoder_t* encoder)
 {
     return ESP_OK;
 }
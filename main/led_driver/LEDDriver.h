@@ -3,41 +3,30 @@
 
 #include <driver/rmt_tx.h>
 
-class LEDDriver
-{
-public:
-    LEDDriver(gpio_num_t pin, size_t leds);
-
-    /// Sends given data (40 bit of it) to all LEDs
-    /// @param color Color data to send to all LEDs. We use the 40 least significant bits. 8 bit per color.
-    void set(uint64_t color);
+#include <array>
 
-    /// Set single Pixel/LED color at index without writing to LEDs
-    void set(size_t index, uint64_t color);
+#include "WireFormat.h"
 
-    /// Sets all LEDs the given color
-    void set(uint8_t red, uint8_t green, uint8_t blue, uint8_t warm, uint8_t cold);
-
-    /// Sets single LED. Does not actually write it to the LED.
-    void set(size_t index, uint8_t red, uint8_t green, uint8_t blue, uint8_t warm, uint8_t cold);
-
-    /// Writes currently set colors to all LEDs
-    void refresh();
+/// Everything of the driver that does not depend on LED count and wire format: RMT channel and encoders.
+/// Use LEDDriver<N, Format> to get a driver with its own color buffer.
+class LEDDriverBase
+{
+public:
+    LEDDriverBase(gpio_num_t pin);
 
     /// Wait (block) until rmt transmission is finished
     void wait();
 
+protected:
+    /// Starts transmitting raw color data. The data must stay valid until the transmission is done.
+    void transmit(const uint8_t* data, size_t size);
+
 private:
     static size_t encoderEncode(rmt_encoder_t* encoder, rmt_channel_handle_t tx_channel, const void* primary_data, size_t data_size, rmt_encode_state_t* ret_state);
     static esp_err_t encoderReset(rmt_encoder_t* encoder);
     static esp_err_t encoderDelete(rmt_encoder_t* encoder);
 
 private:
-    const size_t LED_COUNT;
-
-    /// Contains raw color data for all LEDs
-    uint8_t* colorBuffer;
-
     rmt_channel_handle_t channel;
 
     struct EncoderContainer
@@ -63,4 +52,78 @@ private:
     } ledEncoder;
 };
 
+/// Drives N LEDs with the given wire format (see WireFormat.h).
+/// The color buffer is part of the object, nothing is allocated on the heap.
+/// The RMT encoder reads the buffer from its interrupt, so keep the object in internal RAM.
+template <size_t N, typename Format = WireFormat::GRBWC>
+class LEDDriver : public LEDDriverBase
+{
+public:
+    typedef Format PixelFormat;
+
+    static const size_t LED_COUNT = N;
+    static const size_t BUFFER_SIZE = N * Format::BYTES_PER_LED;
+
+    LEDDriver(gpio_num_t pin)
+        : LEDDriverBase(pin)
+        , colorBuffer()
+    {}
+
+    /// Sends given data (40 bit of it) to all LEDs
+    /// @param color Color data to send to all LEDs. Format 0xCWWWBBRRGG. 8 bit per color.
+    void set(uint64_t color)
+    {
+        for (size_t i = 0; i < N; ++i)
+        {
+            set(i, color);
+        }
+        refresh();
+    }
+
+    /// Set single Pixel/LED color at index without writing to LEDs
+    /// @param color Format 0xCWWWBBRRGG
+    void set(size_t index, uint64_t color)
+    {
+        if (index < N)
+        {
+            WireFormat::pack<Format>(&colorBuffer[index * Format::BYTES_PER_LED], color);
+        }
+    }
+
+    /// Sets all LEDs the given color
+    void set(uint8_t red, uint8_t green, uint8_t blue, uint8_t warm, uint8_t cold)
+    {
+        for (size_t i = 0; i < N; ++i)
+        {
+            set(i, red, green, blue, warm, cold);
+        }
+        refresh();
+    }
+
+    /// Sets single LED. Does not actually write it to the LED.
+    void set(size_t index, uint8_t red, uint8_t green, uint8_t blue, uint8_t warm, uint8_t cold)
+    {
+        if (index < N)
+        {
+            WireFormat::pack<Format>(&colorBuffer[index * Format::BYTES_PER_LED], red, green, blue, warm, cold);
+        }
+    }
+
+    /// Writes currently set colors to all LEDs
+    void refresh()
+    {
+        transmit(colorBuffer.data(), BUFFER_SIZE);
+    }
+
+    /// Raw color data in wire format. Writing to it directly is the fastest way to set all LEDs at once.
+    uint8_t* getBuffer()
+    {
+        return colorBuffer.data();
+    }
+
+private:
+    /// Contains raw color data for all LEDs
+    std::array<uint8_t, BUFFER_SIZE> colorBuffer;
+};
+
 #endif // LEDDRIVER_H
@@ -0,0 +1,68 @@
+#ifndef WIRE_FORMAT_H
+#define WIRE_FORMAT_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+/// Byte layout of one LED on the wire.
+/// Each format lists the byte offset of every channel inside the LED's data, -1 if the LED does not have the channel.
+namespace WireFormat
+{
+
+/// RGB + cold/warm white LEDs. Byte order green red blue warm cold.
+struct GRBWC
+{
+    static const size_t BYTES_PER_LED = 5;
+
+    static const int GREEN = 0;
+    static const int RED = 1;
+    static const int BLUE = 2;
+    static const int WARM = 3;
+    static const int COLD = 4;
+};
+
+/// Plain RGB LEDs (e.g. WS2812). Byte order green red blue.
+struct GRB
+{
+    static const size_t BYTES_PER_LED = 3;
+
+    static const int GREEN = 0;
+    static const int RED = 1;
+    static const int BLUE = 2;
+    static const int WARM = -1;
+    static const int COLD = -1;
+};
+
+/// Writes the channel to its offset in the LED's data. Does nothing if the format does not have the channel.
+template <int Offset>
+inline void setChannel(uint8_t* led, uint8_t value)
+{
+    if constexpr (Offset >= 0)
+    {
+        led[Offset] = value;
+    }
+}
+
+/// Writes one LED in the given format
+/// @param led First byte of the LED's data
+template <typename Format>
+inline void pack(uint8_t* led, uint8_t red, uint8_t green, uint8_t blue, uint8_t warm, uint8_t cold)
+{
+    setChannel<Format::RED>(led, red);
+    setChannel<Format::GREEN>(led, green);
+    setChannel<Format::BLUE>(led, blue);
+    setChannel<Format::WARM>(led, warm);
+    setChannel<Format::COLD>(led, cold);
+}
+
+/// Writes one LED in the given format
+/// @param color Format 0xCWWWBBRRGG
+template <typename Format>
+inline void pack(uint8_t* led, uint64_t color)
+{
+    pack<Format>(led, color >> 8, color, color >> 16, color >> 24, color >> 32);
+}
+
+} // namespace WireFormat
+
+#endif // WIRE_FORMAT_H
@@ -1,49 +1,432 @@
 #include <freertos/FreeRTOS.h>
+#include <freertos/task.h>
+#include <freertos/semphr.h>
 
 #include "WifiCredentials.h"
 
-#include "animation/colors/GammaCorrection.h"
-#include "animation/CarLight.h"
+#include "animation/colors/LightTable.h"
+#include "animation/colors/Palette.h"
+#include "animation/colors/TemporalDither.h"
+#include "animation/clip/ClipPartition.h"
+#include "animation/clip/ClipPlayer.h"
+#include "animation/FrameGovernor.h"
+#include "animation/IndexedFrame.h"
+#include "animation/layout/PixelMap.h"
+#include "animation/parallel/ParallelFor.h"
+#include "animation/SegmentedLight.h"
+#include "animation/shader/PixelShader.h"
+#include "animation/timeline/Timeline.h"
 #include "connect/Connection.h"
+#include "connect/FrameStream.h"
+#include "connect/LatencyProbe.h"
 #include "connect/LEDProtocol.h"
+#include "connect/LightStatus.h"
+#include "connect/NodeAddress.h"
+#include "connect/Seqlock.h"
+#include "connect/TraceRecorder.h"
+#include "led_driver/FrameInterpolator.h"
 #include "led_driver/LEDDriver.h"
+#include "storage/LightState.h"
+#include "storage/StateStore.h"
 
+#include <esp_attr.h>
 #include <esp_timer.h>
 #include <esp_log.h>
 
-// We are limited by the RTOS tick frequency which is 100 Hz by default on the ESP32.
-// Choose the frequency so the period is a multiple of one tick because we cannot delay for fractions of a tick.
+#include <math.h>
+
+// We are limited by the RTOS tick frequency (CONFIG_FREERTOS_HZ, 1000 Hz in our sdkconfig).
+// Choose the frequencies so the periods are a multiple of one tick because we cannot delay for fractions of a tick.
 const double FREQUENCY = 50; // [Hz]
 const double PERIOD = 1 / FREQUENCY; // seconds
 const int64_t PERIOD_MILLIS = PERIOD * 1000; // ms
 
-#define LED_COUNT 20
+// The strip is refreshed several times per rendered frame. Must be a multiple of FREQUENCY.
+// One refresh has to fit into the output period: 50 us per LED (40 bit of 1.25 us) + 300 us reset.
+// That allows at most (OUTPUT_FRAMES_PER_STEP at 50 Hz):
+//   1 (50 Hz): 394 LEDs, 2 (100 Hz): 194 LEDs, 4 (200 Hz): 94 LEDs
+// tools/dither_bench.cpp measures the CPU the dithered refreshes cost on top of rendering.
+const double OUTPUT_FREQUENCY = 200; // [Hz]
+const int OUTPUT_FRAMES_PER_STEP = OUTPUT_FREQUENCY / FREQUENCY;
+const int64_t OUTPUT_PERIOD_MILLIS = 1000 / OUTPUT_FREQUENCY; // ms
+
+// What we do with the output frames in between rendered frames:
+// false: Temporal dithering of the rendered frame for more than 8 bit depth.
+// true:  Treat rendered frames as keyframes and blend between them. Lower FREQUENCY to save render CPU on large strips.
+const bool INTERPOLATE_FRAMES = false;
+
+// false: Render every pixel with CarLight (+ timeline and shader) in full color depth.
+// true:  Indexed framebuffer. One palette index per LED, set through LEDProtocol. The per pixel state of the
+//        rendered path and the reference frames of streams and clips shrink to a single pixel, which lets strips with
+//        thousands of LEDs fit into internal RAM. Their refresh has to fit into PERIOD (394 LEDs at 50 Hz), lower
+//        FREQUENCY for more. The palette is expanded to wire format once per rendered frame, without dithering or
+//        interpolation. The light is not rendered: on/off and dim scale the whole palette, color, white, filter,
+//        timeline, shader and segment requests are ignored, and so are streams and clips (see
+//        LEDProtocol::setIndexed()). Set colors through the palette.
+const bool INDEXED_FRAMEBUFFER = false;
+
+// Frames streamed by a host (LEDProtocol 0x10D) replace the rendered output until none arrived for this long
+const unsigned STREAM_TIMEOUT_FRAMES = FREQUENCY; // 1 s
+
+// Flash partition (see partitions.csv) holding a clip rendered offline. Played with LEDProtocol 0x10E.
+const char* CLIP_PARTITION = "clips";
+
+// Record received messages into a RAM ring from boot on, to be dumped with LEDProtocol 0x111 and replayed with
+// tools/trace_replay. Recording can also be started later, but only fills a ring of TRACE_BUFFER_SIZE bytes.
+const bool RECORD_TRACE = false;
+const size_t TRACE_BUFFER_SIZE = RECORD_TRACE ? 16 * 1024 : 1;
+
+// Fleet addressing (see NodeAddress.h). Every light joins MULTICAST_GROUP, NULL keeps it on unicast only.
+// NODE_ID must be unique in the fleet, NODE_GROUPS is a bit mask of the groups this light belongs to.
+const char* MULTICAST_GROUP = "239.255.0.1";
+const uint8_t NODE_ID = 0;
+const uint32_t NODE_GROUPS = 1 << 0;
+
+// Only render when something changes: while all effects sleep and no filter, timeline or shader is running,
+// the render task sleeps until the next effect deadline or the next received command.
+// With temporal dithering the output keeps being refreshed in between, just without rendering.
+const bool RENDER_ON_DEMAND = true;
+
+// Trade rendering quality for time when rendered frames get close to their period (see FrameGovernor.h),
+// instead of letting frames slip while WiFi is busy or the strip is too big for the frequency
+const bool ADAPTIVE_QUALITY = true;
+
+const size_t LED_COUNT = 20;
+
+// The rendered path refreshes the strip OUTPUT_FRAMES_PER_STEP times per frame (see OUTPUT_FREQUENCY),
+// the indexed framebuffer once per frame
+const int64_t LED_WIRE_NANOS = 8 * WireFormat::GRBWC::BYTES_PER_LED * 1250;
+const int64_t RESET_NANOS = 300000;
+const int64_t REFRESH_PERIOD_NANOS = (INDEXED_FRAMEBUFFER ? PERIOD_MILLIS : OUTPUT_PERIOD_MILLIS) * 1000000;
+static_assert(LED_COUNT * LED_WIRE_NANOS + RESET_NANOS <= REFRESH_PERIOD_NANOS,
+              "A refresh of LED_COUNT LEDs takes longer than its period, lower OUTPUT_FREQUENCY (FREQUENCY if indexed)");
+
+// Logical framebuffer the effects render into and how the LEDs are wired to it (see PixelMap.h).
+// E.g. a 16 x 16 serpentine panel: LAYOUT_WIDTH 16, LAYOUT_HEIGHT 16, LAYOUT_WIRING PixelMapBase::SERPENTINE.
+const size_t LAYOUT_WIDTH = LED_COUNT;
+const size_t LAYOUT_HEIGHT = 1;
+const int LAYOUT_WIRING = PixelMapBase::ROWS;
+
+// Independent zones of the light (see SegmentedLight.h), each with its own effects, brightness and filters.
+// Pixel ranges {first, count} of the layout. A zone that does not change is not rendered again.
+// Commands apply to all zones unless they are wrapped in a SegmentMessage (LEDProtocol 0x114, 1 = first zone).
+// E.g. blinker | brake light | blinker: {{0, 6}, {6, 8}, {14, 6}}
+constexpr LightSegment SEGMENTS[] = {{0, LAYOUT_WIDTH * LAYOUT_HEIGHT}};
+
+// Pixel storage only the selected mode needs. The other one is shrunk to a single pixel.
+const size_t RENDERED_PIXEL_COUNT = INDEXED_FRAMEBUFFER ? 1 : LAYOUT_WIDTH * LAYOUT_HEIGHT;
+const size_t RENDERED_LED_COUNT = INDEXED_FRAMEBUFFER ? 1 : LED_COUNT;
+const size_t INDEXED_LED_COUNT = INDEXED_FRAMEBUFFER ? LED_COUNT : 1;
+
+// All pixel storage is static so nothing is allocated at boot and the heap does not fragment.
+// Pixel state goes to PSRAM if the sdkconfig allows .bss there, otherwise it stays in internal DRAM.
+#ifdef CONFIG_SPIRAM_ALLOW_BSS_SEG_EXTERNAL_MEMORY
+#define PIXEL_STORAGE_ATTR EXT_RAM_BSS_ATTR
+#else
+#define PIXEL_STORAGE_ATTR
+#endif
 
 extern "C" void app_main(void)
 {
-    LEDDriver driver(GPIO_NUM_4, LED_COUNT);
+    // Everything up to the first frame is on the critical path when the car is started.
+    // Only the light and its restored state come before it, network and clips are brought up afterwards.
+    const int64_t appStart = esp_timer_get_time();
+
+    // The RMT interrupt reads the driver's buffer, so it always stays in internal RAM
+    typedef LEDDriver<LED_COUNT> Driver;
+    static Driver driver(GPIO_NUM_4);
+    const size_t PLAYED_FRAME_SIZE = INDEXED_FRAMEBUFFER ? Driver::PixelFormat::BYTES_PER_LED : Driver::BUFFER_SIZE;
     ColorConverter::hsvcct color(ColorConverter::hsv(0, 0, 0), 4000, 1);
-    CarLight light(PERIOD, LED_COUNT, ColorConverter::hsv2rgb(color));
-    Connection conn(WIFI_SSID, WIFI_PASSWORD, "192.168.0.83");
-    LEDProtocol ledProtocol(&light);
+    PIXEL_STORAGE_ATTR static SegmentedLight<RENDERED_PIXEL_COUNT, SEGMENTS> light(PERIOD, ColorConverter::hsv2rgb(color));
+
+    StateStore::init();
+    static StateStore stateStore;
+    LightState state;
+    const int64_t loadStart = esp_timer_get_time();
+    if (stateStore.load(state))
+    {
+        for (size_t i = 0; i < light.getSegmentCount(); ++i)
+        {
+            state.apply(light.getSegment(i));
+        }
+        ESP_LOGI("main", "State restored in %" PRId64 " us", esp_timer_get_time() - loadStart);
+    }
+    if (RENDERED_PIXEL_COUNT >= CarLightBase::MIN_PARALLEL_PIXELS)
+    {
+        // We run on core 0 together with WiFi, the second half of the pixels is rendered on core 1
+        static ParallelFor parallel(1, uxTaskPriorityGet(NULL));
+        light.setParallel(&parallel);
+    }
+    Connection conn(WIFI_SSID, WIFI_PASSWORD, "192.168.0.83", MULTICAST_GROUP);
+    static NodeAddress address(NODE_ID, NODE_GROUPS);
+    static Timeline timeline;
+    static PixelShader shader;
+    static Palette palette;
+    static IndexedFrame<INDEXED_LED_COUNT> indexedFrame;
+    static FrameStream<PLAYED_FRAME_SIZE, Driver::PixelFormat::BYTES_PER_LED> stream(STREAM_TIMEOUT_FRAMES);
+    static ClipPlayer<PLAYED_FRAME_SIZE, Driver::PixelFormat::BYTES_PER_LED> clip;
+    static ClipPartition clipPartition;
+    static Seqlock<LightStatus> status;
+    static LatencyProbe latency;
+    static TraceRecorder<TRACE_BUFFER_SIZE> trace;
+    if (RECORD_TRACE)
+    {
+        trace.start();
+    }
+    LEDProtocol ledProtocol(&light.getSegment(0), &timeline, &shader, &palette, &indexedFrame, &stream, &clip, &status, &latency, &trace, &address);
+    ledProtocol.setSegments(light.getSegments(), light.getSegmentCount());
+    ledProtocol.setIndexed(INDEXED_FRAMEBUFFER);
+    static LightTable lightTable;
+    static PixelMap<RENDERED_LED_COUNT> layout;
+    layout.makeMatrix(LAYOUT_WIDTH, LAYOUT_HEIGHT, LAYOUT_WIRING);
+    const ColorConverter::rgbcct BLACK = {};
+    PIXEL_STORAGE_ATTR static TemporalDither<RENDERED_LED_COUNT> dither;
+    typedef FrameInterpolator<INTERPOLATE_FRAMES && !INDEXED_FRAMEBUFFER ? Driver::BUFFER_SIZE : 1> Interpolator;
+    static Interpolator interpolator;
+    static FrameGovernor governor;
+
+    // Given for every received command, wakes the render task if it sleeps (see RENDER_ON_DEMAND)
+    static StaticSemaphore_t wakeupBuffer;
+    SemaphoreHandle_t wakeup = xSemaphoreCreateBinaryStatic(&wakeupBuffer);
+
+    conn.packetHandler = [&](const uint8_t* buffer, size_t size)
+    {
+        // Datagrams addressed to other lights of the group end here
+        if (!address.accept(buffer, size))
+        {
+            return;
+        }
+        trace.record(buffer, size);
+        ledProtocol.parse(buffer, size);
+        xSemaphoreGive(wakeup);
+    };
+    ledProtocol.replyHandler = std::bind(&Connection::reply, &conn, std::placeholders::_1, std::placeholders::_2);
+    stream.ackHandler = std::bind(&LEDProtocol::acknowledgeFrame, &ledProtocol, std::placeholders::_1);
+    latency.echoHandler = std::bind(&Connection::reply, &conn, std::placeholders::_1, std::placeholders::_2);
+    ledProtocol.stateChangedHandler = []()
+    {
+        // Only commands to all segments are kept, so the first segment has the state of the whole light
+        stateStore.update(LightState::capture(light.getSegment(0)));
+    };
+
+    // Sends the driver buffer. The first time, it also reports the boot time and starts everything we held back for it.
+    bool firstFrameSent = false;
+    auto refresh = [&]()
+    {
+        // A frame carrying a latency probe waits for its own transmission, the next driver.wait() would block as long
+        if (latency.rendered(esp_timer_get_time()))
+        {
+            driver.refresh();
+            driver.wait();
+            latency.transmitted(esp_timer_get_time());
+        }
+        else
+        {
+            driver.refresh();
+        }
 
-    conn.packetHandler = std::bind(&LEDProtocol::parse, &ledProtocol, std::placeholders::_1, std::placeholders::_2);
+        if (!firstFrameSent)
+        {
+            firstFrameSent = true;
+            const int64_t now = esp_timer_get_time();
+            ESP_LOGI("main", "First frame %" PRId64 " ms after boot (%" PRId64 " ms after app_main)", now / 1000, (now - appStart) / 1000);
+
+            conn.start();
+            stateStore.start();
+
+            if (!INDEXED_FRAMEBUFFER && clipPartition.map(CLIP_PARTITION))
+            {
+                bool opened = clip.open(clipPartition.getData(), clipPartition.getSize());
+                ESP_LOGI("main", "Clip in partition %s %s", CLIP_PARTITION, opened ? "opened" : "is missing or invalid");
+            }
+        }
+    };
+
+    // Publishes what the host can query (LEDProtocol 0x10F). Called once per rendered frame, the network task reads it without locking.
+    uint32_t renderedFrames = 0;
+    auto publishStatus = [&](LightStatus::Mode mode)
+    {
+        LightStatus snapshot = {};
+        snapshot.frame = renderedFrames++;
+        snapshot.mode = mode;
+        const uint8_t flags = (timeline.isPlaying() ? LightStatus::TIMELINE_PLAYING : 0) |
+                              (shader.isActive() ? LightStatus::SHADER_ACTIVE : 0);
+        snapshot.channelCount = 1;
+        snapshot.channels[0] = LightStatus::captureChannel(light.getSegment(0), flags);
+        snapshot.segmentCount = light.getSegmentCount();
+        for (size_t i = 0; i < light.getSegmentCount(); ++i)
+        {
+            snapshot.segments[i].range = light.getRange(i);
+            snapshot.segments[i].settings = LightStatus::captureChannel(light.getSegment(i), flags);
+        }
+        snapshot.stripCount = 1;
+        snapshot.strips[0].first = 0;
+        snapshot.strips[0].count = LED_COUNT;
+        snapshot.quality = governor.getQuality();
+        snapshot.qualityChanges = governor.getChanges();
+        status.write(snapshot);
+    };
 
     TickType_t previousWake = xTaskGetTickCount();
+    bool renderNext = true;
+
+    // The shader writes into the pixels of the light, segments that are not rendered again would be shaded twice
+    bool shaded = false;
 
     while (true)
     {
-        light.step();
+        // The stream decodes straight into the driver buffer, so wait until the previous refresh is done
+        driver.wait();
+        latency.beginFrame();
+        trace.nextFrame();
+        stream.decode(driver.getBuffer());
+        if (stream.isActive())
+        {
+            publishStatus(LightStatus::STREAM);
+            refresh();
+
+            xTaskDelayUntil(&previousWake, pdMS_TO_TICKS(PERIOD_MILLIS));
+            continue;
+        }
+
+        // A playing clip replaces the rendered output. Its next frame is pulled into the flash cache while we wait.
+        if (clip.step(PERIOD, driver.getBuffer()) || clip.isPlaying())
+        {
+            publishStatus(LightStatus::CLIP);
+            refresh();
+            clip.prefetch();
+
+            xTaskDelayUntil(&previousWake, pdMS_TO_TICKS(PERIOD_MILLIS));
+            continue;
+        }
+
+        if (INDEXED_FRAMEBUFFER)
+        {
+            publishStatus(LightStatus::INDEXED);
+
+            // The light is not rendered, its on/off state and dim level scale the whole palette instead
+            const CarLightBase& master = light.getSegment(0);
+            lightTable.setBrightness(master.isOn() ? master.getColorBrightness() : 0);
+            palette.update(lightTable);
+
+            driver.wait();
+            palette.expand<Driver::PixelFormat>(indexedFrame.getIndices(), LED_COUNT, driver.getBuffer());
+            refresh();
+
+            xTaskDelayUntil(&previousWake, pdMS_TO_TICKS(PERIOD_MILLIS));
+            continue;
+        }
+
+        // Nothing changes before the next effect deadline, so sleep until the step that is due then instead of rendering
+        // the same frame again. A command wakes us up earlier. The step after waking up is always rendered, the command
+        // may have changed the light.
+        const double idleTime = timeline.isPlaying() || shader.isActive() ? 0 : light.getTimeUntilChange() - PERIOD;
+        if (RENDER_ON_DEMAND && !renderNext && idleTime >= PERIOD)
+        {
+            const TickType_t idleStart = xTaskGetTickCount();
+            const TickType_t timeout = isinf(idleTime) ? portMAX_DELAY : pdMS_TO_TICKS(idleTime * 1000);
+            if (INTERPOLATE_FRAMES || dither.isExact())
+            {
+                xSemaphoreTake(wakeup, timeout);
+            }
+            else
+            {
+                // The dithered frame only shows its full depth over several refreshes
+                do
+                {
+                    driver.wait();
+                    for (size_t i = 0; i < RENDERED_LED_COUNT; ++i)
+                    {
+                        driver.set(i, dither.next8BitWWBRG(i));
+                    }
+                    refresh();
+                }
+                while (xSemaphoreTake(wakeup, pdMS_TO_TICKS(OUTPUT_PERIOD_MILLIS)) != pdTRUE && xTaskGetTickCount() - idleStart < timeout);
+            }
+
+            const TickType_t idleTicks = xTaskGetTickCount() - idleStart;
+            light.skip(pdTICKS_TO_MS(idleTicks) / 1000.0);
+
+            // Trace frames stay in wall clock time, so a replay sees the commands at the same time
+            for (TickType_t frame = pdMS_TO_TICKS(PERIOD_MILLIS); frame < idleTicks; frame += pdMS_TO_TICKS(PERIOD_MILLIS))
+            {
+                trace.nextFrame();
+            }
+
+            previousWake = xTaskGetTickCount();
+            renderNext = true;
+            continue;
+        }
+        renderNext = false;
+
+        // At half rate one rendered frame covers two periods
+        const int stepsPerFrame = governor.getQuality() >= FrameGovernor::HALF_RATE ? 2 : 1;
+        const double frameTime = stepsPerFrame * PERIOD;
+        const int64_t renderStart = esp_timer_get_time();
+
+        timeline.step(frameTime, light.getSegments(), light.getSegmentCount());
+        light.step(!shaded && !shader.isActive());
         ColorConverter::rgbcct* colors = light.getPixels();
+        shader.run(colors, RENDERED_PIXEL_COUNT, frameTime, light.getSegment(0).getColorBrightness());
+        shaded = shader.isActive();
+        publishStatus(LightStatus::RENDERED);
 
-        for (int i = 0; i < LED_COUNT; ++i)
+        // Every LED reads its pixel through the layout in the same pass as the output value lookup
+        if (INTERPOLATE_FRAMES)
+        {
+            uint8_t* keyframe = interpolator.nextKeyframe();
+            for (size_t i = 0; i < RENDERED_LED_COUNT; ++i)
+            {
+                const uint16_t pixel = layout[i];
+                const ColorConverter::rgbcct& source = pixel < RENDERED_PIXEL_COUNT ? colors[pixel] : BLACK;
+                WireFormat::pack<Driver::PixelFormat>(&keyframe[i * Driver::PixelFormat::BYTES_PER_LED], lightTable.to8BitWWBRG(source));
+            }
+            interpolator.pushKeyframe();
+        }
+        else
         {
-            driver.set(i, ColorConverter::to8BitWWBRG(colors[i]));
+            for (size_t i = 0; i < RENDERED_LED_COUNT; ++i)
+            {
+                const uint16_t pixel = layout[i];
+                dither.set(i, lightTable, pixel < RENDERED_PIXEL_COUNT ? colors[pixel] : BLACK);
+            }
         }
+        int64_t workTime = esp_timer_get_time() - renderStart;
 
-        driver.wait();
-        driver.refresh();
+        const int outputFrames = OUTPUT_FRAMES_PER_STEP * stepsPerFrame;
+        for (int frame = 0; frame < outputFrames; ++frame)
+        {
+            driver.wait();
+
+            // Only the CPU work counts against the frame. Waiting for the wire does not get shorter at lower quality.
+            const int64_t outputStart = esp_timer_get_time();
+            if (INTERPOLATE_FRAMES)
+            {
+                interpolator.blend(driver.getBuffer(), (frame + 1) * Interpolator::PHASE_ONE / outputFrames);
+            }
+            else
+            {
+                for (size_t i = 0; i < RENDERED_LED_COUNT; ++i)
+                {
+                    driver.set(i, dither.next8BitWWBRG(i));
+                }
+            }
+            workTime += esp_timer_get_time() - outputStart;
 
-        xTaskDelayUntil(&previousWake, pdMS_TO_TICKS(PERIOD_MILLIS));
+            refresh();
+
+            xTaskDelayUntil(&previousWake, pdMS_TO_TICKS(OUTPUT_PERIOD_MILLIS));
+        }
+
+        if (ADAPTIVE_QUALITY && governor.update(workTime / 1e6, frameTime))
+        {
+            const FrameGovernor::Quality quality = governor.getQuality();
+            light.setRenderQuality(quality >= FrameGovernor::NO_FILTERS, quality >= FrameGovernor::SPANS,
+                                   quality >= FrameGovernor::HALF_RATE ? 2 : 1);
+
+            const char* QUALITY_NAMES[] = {"full", "no filters", "spans", "half rate"};
+            ESP_LOGI("main", "Quality %s at %.0f %% load (%" PRIu32 " changes)", QUALITY_NAMES[quality], governor.getLoad() * 100,
+                     governor.getChanges());
+        }
     }
 }
@@ -0,0 +1,26 @@
+#include "LightState.h"
+
+LightState LightState::capture(const CarLightBase& light)
+{
+    LightState state;
+
+    const ColorConverter::rgb color = light.getColor();
+    state.red = color.r;
+    state.green = color.g;
+    state.blue = color.b;
+    state.whiteTemperature = light.getWhiteTemperature();
+    state.colorBrightness = light.getColorBrightness();
+    state.whiteBrightness = light.getWhiteBrightness();
+    state.on = light.isOn();
+
+    return state;
+}
+
+void LightState::apply(CarLightBase& light) const
+{
+    light.setColor(red, green, blue);
+    light.setWhiteTemperature(whiteTemperature);
+    light.setColorBrightness(colorBrightness);
+    light.setWhiteBrightness(whiteBrightness);
+    on ? light.turnOn() : light.turnOff();
+}
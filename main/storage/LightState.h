@@ -0,0 +1,28 @@
+#ifndef LIGHT_STATE_H
+#define LIGHT_STATE_H
+
+#include <inttypes.h>
+
+#include "../animation/CarLight.h"
+
+/// Settings of a car light that survive a reboot
+struct LightState
+{
+    float red;
+    float green;
+    float blue;
+    float whiteTemperature;     // Kelvin
+    float colorBrightness;
+    float whiteBrightness;
+    bool on;
+
+    /// Reads the current settings of the light
+    static LightState capture(const CarLightBase& light);
+
+    /// Applies the settings to the light
+    void apply(CarLightBase& light) const;
+
+    bool operator==(const LightState& other) const = default;
+};
+
+#endif // LIGHT_STATE_H
@@ -0,0 +1,157 @@
+#include "StateStore.h"
+
+#include <freertos/task.h>
+#include <nvs.h>
+#include <nvs_flash.h>
+#include <esp_log.h>
+#include <esp_timer.h>
+
+static const char* NAMESPACE = "light";
+static const char* KEY = "state";
+
+StateStore::StateStore()
+    : lockBuffer()
+    , lock(xSemaphoreCreateMutexStatic(&lockBuffer))
+    , shadow()
+    , stored()
+    , dirty(false)
+    , lastChange(0)
+    , writeTokens(MAX_WRITES_PER_HOUR)
+    , lastRefill(0)
+{}
+
+void StateStore::init()
+{
+    esp_err_t ret = nvs_flash_init();
+    if (ret == ESP_ERR_NVS_NO_FREE_PAGES || ret == ESP_ERR_NVS_NEW_VERSION_FOUND)
+    {
+        nvs_flash_erase();
+        nvs_flash_init();
+    }
+}
+
+bool StateStore::load(LightState& state)
+{
+    nvs_handle_t handle;
+    if (nvs_open(NAMESPACE, NVS_READONLY, &handle) != ESP_OK)
+    {
+        return false;
+    }
+
+    Record record;
+    size_t size = sizeof(record);
+    esp_err_t ret = nvs_get_blob(handle, KEY, &record, &size);
+    nvs_close(handle);
+
+    if (ret != ESP_OK || size != sizeof(record) || record.version != VERSION)
+    {
+        return false;
+    }
+
+    xSemaphoreTake(lock, portMAX_DELAY);
+    shadow = record.state;
+    stored = record.state;
+    dirty = false;
+    xSemaphoreGive(lock);
+
+    state = record.state;
+    return true;
+}
+
+void StateStore::update(const LightState& state)
+{
+    xSemaphoreTake(lock, portMAX_DELAY);
+    if (!(state == shadow))
+    {
+        shadow = state;
+        dirty = true;
+        lastChange = esp_timer_get_time();
+    }
+    xSemaphoreGive(lock);
+}
+
+void StateStore::start()
+{
+    lastRefill = esp_timer_get_time();
+    xTaskCreate(&StateStore::task, "stateStore", 3072, this, tskIDLE_PRIORITY + 1, NULL);
+}
+
+void StateStore::task(void* args)
+{
+    StateStore* instance = static_cast<StateStore*>(args);
+
+    while (true)
+    {
+        vTaskDelay(pdMS_TO_TICKS(POLL_PERIOD_MILLIS));
+        instance->poll(esp_timer_get_time());
+    }
+}
+
+void StateStore::poll(int64_t now)
+{
+    const int64_t HOUR = 3600LL * 1000 * 1000;
+
+    xSemaphoreTake(lock, portMAX_DELAY);
+
+    writeTokens += static_cast<double>(now - lastRefill) * MAX_WRITES_PER_HOUR / HOUR;
+    writeTokens = writeTokens > MAX_WRITES_PER_HOUR ? MAX_WRITES_PER_HOUR : writeTokens;
+    lastRefill = now;
+
+    if (!dirty || now - lastChange < QUIET_PERIOD || writeTokens < 1)
+    {
+        xSemaphoreGive(lock);
+        return;
+    }
+
+    const LightState state = shadow;
+    dirty = false;
+    if (state == stored)
+    {
+        // Changed back to what is in flash already
+        xSemaphoreGive(lock);
+        return;
+    }
+    writeTokens -= 1;
+
+    xSemaphoreGive(lock);
+
+    // Written outside the lock, so update() never waits for flash
+    if (save(state))
+    {
+        xSemaphoreTake(lock, portMAX_DELAY);
+        stored = state;
+        xSemaphoreGive(lock);
+    }
+    else
+    {
+        xSemaphoreTake(lock, portMAX_DELAY);
+        dirty = true;
+        xSemaphoreGive(lock);
+    }
+}
+
+bool StateStore::save(const LightState& state)
+{
+    nvs_handle_t handle;
+    if (nvs_open(NAMESPACE, NVS_READWRITE, &handle) != ESP_OK)
+    {
+        return false;
+    }
+
+    Record record;
+    record.version = VERSION;
+    record.state = state;
+
+    esp_err_t ret = nvs_set_blob(handle, KEY, &record, sizeof(record));
+    if (ret == ESP_OK)
+    {
+        ret = nvs_commit(handle);
+    }
+    nvs_close(handle);
+
+    if (ret != ESP_OK)
+    {
+        ESP_LOGI("StateStore", "Saving state failed (%d)", ret);
+    }
+    return ret == ESP_OK;
+}
@@ -0,0 +1,79 @@
+#ifndef STATE_STORE_H
+#define STATE_STORE_H
+
+#include <freertos/FreeRTOS.h>
+#include <freertos/semphr.h>
+
+#include <inttypes.h>
+
+#include "LightState.h"
+
+/// Keeps the light state in NVS so it can be restored at boot.
+/// Changes only go to an in-RAM shadow copy, which is cheap enough to do for every network command.
+/// A low priority task writes the shadow to NVS once it did not change for QUIET_PERIOD, and never
+/// more than MAX_WRITES_PER_HOUR times per hour. This keeps flash wear and NVS stalls away from the
+/// network and render tasks. Changes younger than QUIET_PERIOD are lost on power off.
+class StateStore
+{
+public:
+    /// Time without changes before the shadow is written [us]
+    static const int64_t QUIET_PERIOD = 5 * 1000 * 1000;
+
+    /// Writes allowed per hour. Unused writes accumulate up to this many.
+    static const unsigned MAX_WRITES_PER_HOUR = 20;
+
+    StateStore();
+
+    /// Initializes the NVS flash partition. Call once at boot before anything uses NVS (also WiFi).
+    /// Erases the partition if its layout is outdated or full.
+    static void init();
+
+    /// Reads the stored state with a single NVS read, well below a millisecond. Call once at boot.
+    /// @return false if there is none or it was written by an incompatible firmware
+    bool load(LightState& state);
+
+    /// Replaces the shadow copy. Never touches flash, can be called from any task.
+    void update(const LightState& state);
+
+    /// Starts the task that writes the shadow to NVS
+    void start();
+
+private:
+    /// Stored in front of the state, changes whenever LightState changes
+    static const uint32_t VERSION = 1;
+
+    /// How often the task checks the shadow [ms]
+    static const uint32_t POLL_PERIOD_MILLIS = 500;
+
+    struct Record
+    {
+        uint32_t version;
+        LightState state;
+    };
+
+    static void task(void* args);
+
+    /// Writes the shadow if it is due
+    /// @param now [us]
+    void poll(int64_t now);
+
+    /// Blocks until the state is in flash
+    bool save(const LightState& state);
+
+    StaticSemaphore_t lockBuffer;
+    /// Guards everything below
+    SemaphoreHandle_t lock;
+
+    LightState shadow;
+    /// What is in flash
+    LightState stored;
+    bool dirty;
+    /// Time of the last change of the shadow [us]
+    int64_t lastChange;
+
+    /// Token bucket for the write limit
+    double writeTokens;
+    int64_t lastRefill;
+};
+
+#endif // STATE_STORE_H
@@ -0,0 +1,188 @@
+#include "LEDClient.h"
+
+#include <arpa/inet.h>
+#include <poll.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include <cstring>
+#include <thread>
+
+LEDClient::LEDClient(const char* host, uint16_t port, double maxDatagramsPerSecond)
+    : sock(socket(AF_INET, SOCK_DGRAM, 0))
+    , target()
+    , valid(false)
+    , addressed(false)
+    , groups(0)
+    , nodes(0)
+    , segment(0)
+    , interval(std::chrono::duration_cast<std::chrono::steady_clock::duration>(std::chrono::duration<double>(1 / maxDatagramsPerSecond)))
+    , nextSend(std::chrono::steady_clock::now())
+    , received(MAX_DATAGRAM)
+{
+    target.sin_family = AF_INET;
+    target.sin_port = htons(port);
+    valid = sock >= 0 && inet_pton(AF_INET, host, &target.sin_addr) == 1;
+}
+
+LEDClient::~LEDClient()
+{
+    if (sock >= 0)
+    {
+        close(sock);
+    }
+}
+
+bool LEDClient::isOpen() const
+{
+    return valid;
+}
+
+size_t LEDClient::getCapacity() const
+{
+    return MAX_DATAGRAM - (addressed ? sizeof(uint32_t) + MessageSchema::AddressedMessage::FIXED_SIZE : 0);
+}
+
+void LEDClient::enqueue(uint32_t id, uint8_t channel, uint8_t segment, bool latest, const std::vector<uint8_t>& encoded)
+{
+    if (latest)
+    {
+        for (Pending& queued : pending)
+        {
+            if (queued.id == id && queued.channel == channel && queued.segment == segment)
+            {
+                queued.encoded = encoded;
+                return;
+            }
+        }
+    }
+
+    Pending message;
+    message.id = id;
+    message.channel = channel;
+    message.segment = segment;
+    message.latest = latest;
+    message.encoded = encoded;
+    pending.push_back(message);
+}
+
+std::vector<uint8_t> LEDClient::wrapSegment(uint8_t channel, const std::vector<uint8_t>& encoded) const
+{
+    MessageSchema::SegmentMessage message = {};
+    message.channel = channel;
+    message.segment = segment;
+    message.message = encoded.data();
+    message.messageSize = encoded.size();
+    std::vector<uint8_t> wrapped(message.getSize());
+    message.encode(wrapped.data(), wrapped.size());
+    return wrapped;
+}
+
+void LEDClient::setSegment(uint8_t segment)
+{
+    this->segment = segment;
+}
+
+void LEDClient::setAddress(uint32_t groups, uint64_t nodes)
+{
+    this->addressed = groups != 0 || nodes != 0;
+    this->groups = groups;
+    this->nodes = nodes;
+}
+
+size_t LEDClient::flush()
+{
+    const size_t BATCH_HEADER = sizeof(uint32_t) + sizeof(uint8_t);
+    const size_t ENTRY_HEADER = sizeof(MessageSchema::BatchEntrySize);
+    const size_t capacity = getCapacity();
+
+    size_t datagrams = 0;
+    size_t next = 0;
+    while (next < pending.size())
+    {
+        // As many messages as fit into one batch, in queue order
+        size_t end = next;
+        size_t size = BATCH_HEADER;
+        while (end < pending.size() && size + ENTRY_HEADER + pending[end].encoded.size() <= capacity)
+        {
+            size += ENTRY_HEADER + pending[end].encoded.size();
+            ++end;
+        }
+
+        // Single messages go out as they are, without the batch overhead
+        if (end - next <= 1)
+        {
+            send(pending[next].encoded.data(), pending[next].encoded.size());
+            ++next;
+            ++datagrams;
+            continue;
+        }
+
+        std::vector<uint8_t> entries;
+        for (size_t i = next; i < end; ++i)
+        {
+            const MessageSchema::BatchEntrySize entrySize = pending[i].encoded.size();
+            const uint8_t* sizeBytes = reinterpret_cast<const uint8_t*>(&entrySize);
+            entries.insert(entries.end(), sizeBytes, sizeBytes + sizeof(entrySize));
+            entries.insert(entries.end(), pending[i].encoded.begin(), pending[i].encoded.end());
+        }
+
+        MessageSchema::BatchMessage batch = {};
+        batch.messages = entries.data();
+        batch.messagesSize = entries.size();
+        std::vector<uint8_t> buffer(batch.getSize());
+        batch.encode(buffer.data(), buffer.size());
+        send(buffer.data(), buffer.size());
+
+        next = end;
+        ++datagrams;
+    }
+
+    pending.clear();
+    return datagrams;
+}
+
+void LEDClient::send(const uint8_t* buffer, size_t size)
+{
+    std::vector<uint8_t> envelope;
+    if (addressed)
+    {
+        MessageSchema::AddressedMessage message = {};
+        message.groups = groups;
+        message.nodes = nodes;
+        message.message = buffer;
+        message.messageSize = size;
+        envelope.resize(message.getSize());
+        message.encode(envelope.data(), envelope.size());
+        buffer = envelope.data();
+        size = envelope.size();
+    }
+
+    std::this_thread::sleep_until(nextSend);
+    const std::chrono::steady_clock::time_point now = std::chrono::steady_clock::now();
+    nextSend = (nextSend > now ? nextSend : now) + interval;
+
+    sendto(sock, buffer, size, 0, reinterpret_cast<const sockaddr*>(&target), sizeof(target));
+}
+
+bool LEDClient::receiveDatagram(int timeoutMillis, uint32_t& id)
+{
+    pollfd descriptor = {sock, POLLIN, 0};
+    if (poll(&descriptor, 1, timeoutMillis) <= 0)
+    {
+        return false;
+    }
+
+    received.resize(MAX_DATAGRAM);
+    const ssize_t size = recv(sock, received.data(), received.size(), 0);
+    if (size < static_cast<ssize_t>(sizeof(uint32_t)))
+    {
+        received.clear();
+        id = 0;
+        return size >= 0;
+    }
+
+    received.resize(size);
+    memcpy(&id, received.data(), sizeof(uint32_t));
+    return true;
+}
@@ -0,0 +1,148 @@
+// Host client for LEDProtocol, built on the same message schema as the firmware parser (main/connect/MessageSchema.h).
+//
+// Build: add tools/client/LEDClient.cpp to the tool and -Imain -Itools/client
+//
+//   LEDClient client("192.168.0.83");
+//   MessageSchema::DimMessage dim = {};
+//   dim.dim = 0x8000;
+//   client.queue(dim);
+//   client.flush();
+//
+// queue() only collects messages. flush() packs them into as few datagrams as possible (BatchMessage) and paces
+// the datagrams so the light's receive queue is not flooded. Queued messages whose type is LATEST replace an
+// earlier queued message of the same type and channel in place, so a slider sends only its last position.
+//
+// To control a fleet, pass the multicast group of the lights as host and pick the lights with setAddress().
+// Every datagram is then wrapped in an AddressedMessage, the lights that are not addressed drop it.
+//
+// Lights that are split into segments (main/animation/SegmentedLight.h) apply requests to all segments.
+// After setSegment() the queued requests are wrapped in a SegmentMessage and only change that segment.
+
+#ifndef LED_CLIENT_H
+#define LED_CLIENT_H
+
+#include "connect/MessageSchema.h"
+
+#include <netinet/in.h>
+
+#include <chrono>
+#include <stddef.h>
+#include <stdint.h>
+#include <vector>
+
+class LEDClient
+{
+public:
+    /// Largest datagram the light receives
+    static const size_t MAX_DATAGRAM = MessageSchema::MAX_DATAGRAM;
+    static const uint16_t DEFAULT_PORT = 8002;
+
+    /// @param host IPv4 address of the light
+    /// @param maxDatagramsPerSecond Pacing of flush()
+    LEDClient(const char* host, uint16_t port = DEFAULT_PORT, double maxDatagramsPerSecond = 200);
+    ~LEDClient();
+
+    LEDClient(const LEDClient&) = delete;
+    LEDClient& operator=(const LEDClient&) = delete;
+
+    /// @return false if host is not an IPv4 address or there is no socket
+    bool isOpen() const;
+
+    /// Queues a request
+    /// @return false if it does not fit into a datagram (with the current address)
+    template <typename Message>
+    bool queue(const Message& message)
+    {
+        std::vector<uint8_t> encoded(message.getSize());
+        if (message.encode(encoded.data(), encoded.size()) == 0)
+        {
+            return false;
+        }
+        if (segment != 0)
+        {
+            encoded = wrapSegment(message.channel, encoded);
+        }
+        if (encoded.size() > getCapacity())
+        {
+            return false;
+        }
+        enqueue(Message::ID, message.channel, segment, Message::LATEST, encoded);
+        return true;
+    }
+
+    /// Sends the following queued requests to one segment of the light (1 = first). 0 sends them to all segments.
+    void setSegment(uint8_t segment);
+
+    /// Addresses the following datagrams to the lights in any of groups or with their node ID bit set in nodes
+    /// (see main/connect/NodeAddress.h). Both 0 turns addressing off, the datagrams apply to every light again.
+    void setAddress(uint32_t groups, uint64_t nodes);
+
+    /// Sends everything queued. Blocks while pacing.
+    /// @return Number of datagrams sent
+    size_t flush();
+
+    /// Waits for a reply of type Reply. Other replies are dropped.
+    /// Tails of the reply point into the client and stay valid until the next receive().
+    /// @return false on timeout
+    template <typename Reply>
+    bool receive(Reply& reply, int timeoutMillis)
+    {
+        const std::chrono::steady_clock::time_point end = std::chrono::steady_clock::now() + std::chrono::milliseconds(timeoutMillis);
+        while (true)
+        {
+            const int remaining = std::chrono::duration_cast<std::chrono::milliseconds>(end - std::chrono::steady_clock::now()).count();
+            uint32_t id;
+            if (remaining <= 0 || !receiveDatagram(remaining, id))
+            {
+                return false;
+            }
+            if (id == Reply::ID && reply.decode(&received[sizeof(uint32_t)], received.size() - sizeof(uint32_t)))
+            {
+                return true;
+            }
+        }
+    }
+
+private:
+    struct Pending
+    {
+        uint32_t id;
+        uint8_t channel;
+        uint8_t segment;
+        bool latest;
+        std::vector<uint8_t> encoded;
+    };
+
+    /// Bytes of a datagram left for the request after the AddressedMessage header
+    size_t getCapacity() const;
+
+    void enqueue(uint32_t id, uint8_t channel, uint8_t segment, bool latest, const std::vector<uint8_t>& encoded);
+
+    /// @return the encoded request wrapped in a SegmentMessage for the current segment
+    std::vector<uint8_t> wrapSegment(uint8_t channel, const std::vector<uint8_t>& encoded) const;
+
+    /// Wraps the datagram if it is addressed, waits for the pacing and sends it
+    void send(const uint8_t* buffer, size_t size);
+
+    /// @return false on timeout
+    bool receiveDatagram(int timeoutMillis, uint32_t& id);
+
+    int sock;
+    sockaddr_in target;
+    bool valid;
+
+    bool addressed;
+    uint32_t groups;
+    uint64_t nodes;
+
+    /// See setSegment()
+    uint8_t segment;
+
+    const std::chrono::steady_clock::duration interval;
+    std::chrono::steady_clock::time_point nextSend;
+
+    std::vector<Pending> pending;
+    std::vector<uint8_t> received;
+};
+
+#endif // LED_CLIENT_H
@@ -0,0 +1,199 @@
+// Host side tool for flash clips (main/animation/clip/ClipPlayer.h).
+//
+// Build: g++ -std=gnu++20 -O2 -Imain tools/clip_tool.cpp main/animation/clip/ClipPlayer.cpp main/connect/FrameCodec.cpp -o clip_tool
+//
+// A session is a recording of raw wire format frames (LEDS * STRIDE bytes each), concatenated
+// (see tools/frame_codec.cpp, which can also synthesise one).
+//
+// Usage:
+//   clip_tool make LEDS STRIDE FPS [delta] < session.bin > clip.bin   Creates a clip, delta codes frames against their predecessor
+//   clip_tool play LEDS STRIDE clip.bin > session.bin                 Plays the clip with the firmware player, writes every frame
+//   clip_tool info clip.bin
+//
+// Flash the clip into the clips partition (see partitions.csv) with
+//   parttool.py write_partition --partition-name clips --input clip.bin
+
+#include "animation/clip/ClipPlayer.h"
+#include "connect/FrameCodec.h"
+
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <vector>
+
+namespace
+{
+
+/// ClipPlayer with its frame size chosen at runtime
+class HostClipPlayer : public ClipPlayerBase
+{
+public:
+    HostClipPlayer(size_t size, size_t stride)
+        : HostClipPlayer(std::vector<uint8_t>(size), stride)
+    {}
+
+private:
+    HostClipPlayer(std::vector<uint8_t>&& storage, size_t stride)
+        : ClipPlayerBase(storage.data(), storage.size(), stride)
+        , referenceFrame(std::move(storage))
+    {}
+
+    std::vector<uint8_t> referenceFrame;
+};
+
+std::vector<uint8_t> readAll(FILE* file)
+{
+    std::vector<uint8_t> data;
+    uint8_t buffer[4096];
+    size_t read;
+    while ((read = fread(buffer, 1, sizeof(buffer), file)) > 0)
+    {
+        data.insert(data.end(), buffer, buffer + read);
+    }
+    return data;
+}
+
+bool readFile(const char* path, std::vector<uint8_t>& data)
+{
+    FILE* file = fopen(path, "rb");
+    if (!file)
+    {
+        fprintf(stderr, "cannot open %s\n", path);
+        return false;
+    }
+    data = readAll(file);
+    fclose(file);
+    return true;
+}
+
+template <typename T>
+void append(std::vector<uint8_t>& out, T value)
+{
+    const uint8_t* bytes = reinterpret_cast<const uint8_t*>(&value);
+    out.insert(out.end(), bytes, bytes + sizeof(T));
+}
+
+int make(size_t leds, size_t stride, unsigned frameRate, bool delta)
+{
+    const size_t frameSize = leds * stride;
+    std::vector<uint8_t> session = readAll(stdin);
+    const size_t frameCount = session.size() / frameSize;
+    if (frameCount == 0)
+    {
+        fprintf(stderr, "session has no complete frame\n");
+        return 1;
+    }
+
+    ClipPlayerBase::Header header = {};
+    header.magic = ClipPlayerBase::MAGIC;
+    header.version = ClipPlayerBase::VERSION;
+    header.flags = delta ? ClipPlayerBase::DELTA : 0;
+    header.bytesPerLED = stride;
+    header.frameSize = frameSize;
+    header.frameCount = frameCount;
+    header.frameRate = frameRate;
+
+    std::vector<uint8_t> clip;
+    append(clip, header);
+
+    std::vector<uint8_t> payload(frameSize * 2 + 16);
+    for (size_t f = 0; f < frameCount; ++f)
+    {
+        const uint8_t* frame = &session[f * frameSize];
+        if (delta)
+        {
+            size_t size = 0;
+            FrameCodec::encode(frame, f > 0 ? frame - frameSize : nullptr, frameSize, stride, payload.data(), payload.size(), size);
+            append<uint32_t>(clip, size);
+            clip.insert(clip.end(), payload.begin(), payload.begin() + size);
+        }
+        else
+        {
+            clip.insert(clip.end(), frame, frame + frameSize);
+        }
+    }
+
+    fwrite(clip.data(), 1, clip.size(), stdout);
+    fprintf(stderr, "%zu frames, %zu bytes (%.1f%% of raw)\n", frameCount, clip.size(), 100.0 * clip.size() / session.size());
+    return 0;
+}
+
+int play(size_t leds, size_t stride, const char* path)
+{
+    std::vector<uint8_t> clip;
+    if (!readFile(path, clip))
+    {
+        return 1;
+    }
+
+    HostClipPlayer player(leds * stride, stride);
+    if (!player.open(clip.data(), clip.size()))
+    {
+        fprintf(stderr, "%s is not a valid clip for %zu LEDs with %zu bytes each\n", path, leds, stride);
+        return 1;
+    }
+
+    ClipPlayerBase::Header header;
+    memcpy(&header, clip.data(), sizeof(header));
+
+    // Step exactly one frame at a time, so every frame is written
+    std::vector<uint8_t> out(leds * stride);
+    const double dt = 1.0 / header.frameRate;
+    player.play(false);
+    for (bool first = true; player.step(first ? 0 : dt, out.data()); first = false)
+    {
+        player.prefetch();
+        fwrite(out.data(), 1, out.size(), stdout);
+    }
+    return 0;
+}
+
+int info(const char* path)
+{
+    std::vector<uint8_t> clip;
+    if (!readFile(path, clip))
+    {
+        return 1;
+    }
+
+    ClipPlayerBase::Header header;
+    if (clip.size() < sizeof(header))
+    {
+        fprintf(stderr, "%s is too short\n", path);
+        return 1;
+    }
+    memcpy(&header, clip.data(), sizeof(header));
+
+    printf("magic        %s\n", header.magic == ClipPlayerBase::MAGIC ? "ok" : "wrong");
+    printf("version      %u\n", header.version);
+    printf("delta        %s\n", header.flags & ClipPlayerBase::DELTA ? "yes" : "no");
+    printf("LEDs         %u x %u bytes\n", header.bytesPerLED ? header.frameSize / header.bytesPerLED : 0, header.bytesPerLED);
+    printf("frames       %u at %u Hz (%.1f s)\n", header.frameCount, header.frameRate, header.frameRate ? double(header.frameCount) / header.frameRate : 0.0);
+    printf("size         %zu bytes\n", clip.size());
+
+    HostClipPlayer player(header.frameSize, header.bytesPerLED);
+    printf("valid        %s\n", player.open(clip.data(), clip.size()) ? "yes" : "no");
+    return 0;
+}
+
+} // namespace
+
+int main(int argc, char** argv)
+{
+    if (argc == 3 && strcmp(argv[1], "info") == 0)
+    {
+        return info(argv[2]);
+    }
+    if (argc >= 5 && strcmp(argv[1], "make") == 0)
+    {
+        return make(strtoul(argv[2], nullptr, 10), strtoul(argv[3], nullptr, 10), strtoul(argv[4], nullptr, 10),
+                    argc > 5 && strcmp(argv[5], "delta") == 0);
+    }
+    if (argc == 5 && strcmp(argv[1], "play") == 0)
+    {
+        return play(strtoul(argv[2], nullptr, 10), strtoul(argv[3], nullptr, 10), argv[4]);
+    }
+
+    fprintf(stderr, "usage: %s make LEDS STRIDE FPS [delta] | play LEDS STRIDE clip | info clip\n", argv[0]);
+    return 2;
+}
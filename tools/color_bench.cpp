@@ -0,0 +1,377 @@
+// Host side accuracy check and benchmark of the color conversions (main/animation/colors/ColorConverter.h).
+//
+// Build: g++ -std=gnu++20 -O2 -Imain tools/color_bench.cpp main/animation/colors/ColorConverter.cpp -o color_bench
+//
+// Usage: color_bench [VALUES]
+// Converts the same random colors (4096 by default) with the double implementation ColorConverter had before it was
+// templated (copied below) and with the current conversions: one value at a time and batched in double, float and
+// Q16. Prints the largest difference to the old implementation and the throughput of every variant.
+// Fails if a double conversion differs from the old one by more than rounding.
+
+#include "animation/colors/ColorConverter.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <random>
+#include <vector>
+
+using namespace ColorConverter;
+
+namespace
+{
+
+/// ColorConverter before the scalar templates, the reference for accuracy and speed
+namespace baseline
+{
+
+hsv rgb2hsv(rgb in)
+{
+    hsv         out;
+    double      min, max, delta;
+
+    min = in.r < in.g ? in.r : in.g;
+    min = min  < in.b ? min  : in.b;
+
+    max = in.r > in.g ? in.r : in.g;
+    max = max  > in.b ? max  : in.b;
+
+    out.v = max;
+    delta = max - min;
+    if (delta < 0.00001)
+    {
+        out.s = 0;
+        out.h = 0;
+        return out;
+    }
+    if( max > 0.0 ) {
+        out.s = (delta / max);
+    } else {
+        out.s = 0.0;
+        out.h = NAN;
+        return out;
+    }
+    if( in.r >= max )
+        out.h = ( in.g - in.b ) / delta;
+    else
+    if( in.g >= max )
+        out.h = 2.0 + ( in.b - in.r ) / delta;
+    else
+        out.h = 4.0 + ( in.r - in.g ) / delta;
+
+    out.h *= 60.0;
+
+    if( out.h < 0.0 )
+        out.h += 360.0;
+
+    return out;
+}
+
+hsvcct rgb2hsv(rgbcct in)
+{
+    hsvcct ret;
+    ret.color = rgb2hsv(in.color);
+    ret.whiteValue = std::min(in.cw + in.ww, 1.0);
+
+    double coldAmount = COLD_TEMPERATURE * in.cw;
+    double warmAmount = WARM_TEMPERATURE * in.ww;
+
+    // Divides by zero without white, the inputs below always have some
+    ret.whiteTemp = (coldAmount + warmAmount) / (in.cw + in.ww);
+
+    return ret;
+}
+
+rgb hsv2rgb(hsv in)
+{
+    double      hh, p, q, t, ff;
+    long        i;
+    rgb         out;
+
+    if(in.s <= 0.0) {
+        out.r = in.v;
+        out.g = in.v;
+        out.b = in.v;
+        return out;
+    }
+    hh = in.h;
+    if(hh >= 360.0) hh = 0.0;
+    hh /= 60.0;
+    i = (long)hh;
+    ff = hh - i;
+    p = in.v * (1.0 - in.s);
+    q = in.v * (1.0 - (in.s * ff));
+    t = in.v * (1.0 - (in.s * (1.0 - ff)));
+
+    switch(i) {
+    case 0:
+        out.r = in.v;
+        out.g = t;
+        out.b = p;
+        break;
+    case 1:
+        out.r = q;
+        out.g = in.v;
+        out.b = p;
+        break;
+    case 2:
+        out.r = p;
+        out.g = in.v;
+        out.b = t;
+        break;
+    case 3:
+        out.r = p;
+        out.g = q;
+        out.b = in.v;
+        break;
+    case 4:
+        out.r = t;
+        out.g = p;
+        out.b = in.v;
+        break;
+    case 5:
+    default:
+        out.r = in.v;
+        out.g = p;
+        out.b = q;
+        break;
+    }
+    return out;
+}
+
+rgbcct hsv2rgb(hsvcct in)
+{
+    rgbcct ret;
+    ret.color = hsv2rgb(in.color);
+
+    double temperatureRange = COLD_TEMPERATURE - WARM_TEMPERATURE;
+
+    ret.cw = (in.whiteTemp - WARM_TEMPERATURE) / temperatureRange;
+    ret.ww = (COLD_TEMPERATURE - in.whiteTemp) / temperatureRange;
+
+    ret.cw *= in.whiteValue;
+    ret.ww *= in.whiteValue;
+
+    return ret;
+}
+
+} // namespace baseline
+
+const int RUNS = 200;
+
+/// Keeps the optimizer from dropping conversions whose results are not used otherwise
+volatile double sink;
+
+template <typename T>
+double toDouble(T value)
+{
+    return static_cast<double>(value);
+}
+
+template <typename To, typename From>
+rgbcctT<To> convert(const rgbcctT<From>& in)
+{
+    return rgbcctT<To>{{To(toDouble(in.color.r)), To(toDouble(in.color.g)), To(toDouble(in.color.b))},
+                       To(toDouble(in.ww)), To(toDouble(in.cw))};
+}
+
+template <typename To, typename From>
+hsvcctT<To> convert(const hsvcctT<From>& in)
+{
+    return hsvcctT<To>{{To(toDouble(in.color.h)), To(toDouble(in.color.s)), To(toDouble(in.color.v))},
+                       To(toDouble(in.whiteTemp)), To(toDouble(in.whiteValue))};
+}
+
+template <typename T>
+double difference(const rgbcctT<T>& value, const rgbcct& reference)
+{
+    const rgbcct in = convert<double>(value);
+    return std::max({fabs(in.color.r - reference.color.r), fabs(in.color.g - reference.color.g),
+                     fabs(in.color.b - reference.color.b), fabs(in.ww - reference.ww), fabs(in.cw - reference.cw)});
+}
+
+/// Hue in degrees, saturation and value as fractions and the white temperature in units of the temperature range,
+/// so all components count the same
+template <typename T>
+double difference(const hsvcctT<T>& value, const hsvcct& reference)
+{
+    const hsvcct in = convert<double>(value);
+    double hue = 0;
+    if (reference.color.s > 0.001)
+    {
+        // Hue is undefined for grey, and 0 and 360 degrees are the same
+        hue = fabs(in.color.h - reference.color.h);
+        hue = std::min(hue, 360 - hue) / 360;
+    }
+    return std::max({hue, fabs(in.color.s - reference.color.s), fabs(in.color.v - reference.color.v),
+                     fabs(in.whiteTemp - reference.whiteTemp) / (COLD_TEMPERATURE - WARM_TEMPERATURE),
+                     fabs(in.whiteValue - reference.whiteValue)});
+}
+
+/// Runs convert over all values RUNS times
+/// @return Million conversions per second
+template <typename Convert>
+double throughput(size_t values, Convert convert)
+{
+    auto start = std::chrono::steady_clock::now();
+    for (int run = 0; run < RUNS; ++run)
+    {
+        convert();
+    }
+    double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    return RUNS * values / seconds / 1e6;
+}
+
+void print(const char* name, double error, double speed)
+{
+    printf("%-26s max error %10.3g %10.2f M/s\n", name, error, speed);
+}
+
+/// hsv2rgb in all variants
+/// @return largest error of a double variant
+template <typename T>
+double checkHsv2Rgb(const char* name, const std::vector<hsvcct>& in, const std::vector<rgbcct>& reference)
+{
+    std::vector<hsvcctT<T>> input;
+    for (const hsvcct& value : in)
+    {
+        input.push_back(convert<T>(value));
+    }
+    std::vector<rgbcctT<T>> out(in.size());
+
+    double speed = throughput(in.size(), [&]() {
+        ColorConverter::hsv2rgb(input.data(), out.data(), in.size());
+        sink = toDouble(out[in.size() / 2].color.r);
+    });
+
+    double error = 0;
+    for (size_t i = 0; i < in.size(); ++i)
+    {
+        error = std::max(error, difference(out[i], reference[i]));
+    }
+    print(name, error, speed);
+    return error;
+}
+
+template <typename T>
+double checkRgb2Hsv(const char* name, const std::vector<rgbcct>& in, const std::vector<hsvcct>& reference)
+{
+    std::vector<rgbcctT<T>> input;
+    for (const rgbcct& value : in)
+    {
+        input.push_back(convert<T>(value));
+    }
+    std::vector<hsvcctT<T>> out(in.size());
+
+    double speed = throughput(in.size(), [&]() {
+        ColorConverter::rgb2hsv(input.data(), out.data(), in.size());
+        sink = toDouble(out[in.size() / 2].color.h);
+    });
+
+    double error = 0;
+    for (size_t i = 0; i < in.size(); ++i)
+    {
+        error = std::max(error, difference(out[i], reference[i]));
+    }
+    print(name, error, speed);
+    return error;
+}
+
+} // namespace
+
+int main(int argc, char** argv)
+{
+    const size_t values = argc > 1 ? strtoul(argv[1], nullptr, 10) : 4096;
+    if (values == 0)
+    {
+        fprintf(stderr, "usage: %s [VALUES]\n", argv[0]);
+        return 2;
+    }
+
+    std::mt19937 random(1);
+    std::uniform_real_distribution<double> fraction(0, 1);
+    std::uniform_real_distribution<double> hue(0, 360);
+    std::uniform_real_distribution<double> temperature(WARM_TEMPERATURE, COLD_TEMPERATURE);
+
+    std::vector<hsvcct> hsvColors;
+    std::vector<rgbcct> rgbColors;
+    for (size_t i = 0; i < values; ++i)
+    {
+        hsvColors.push_back(hsvcct{{hue(random), fraction(random), fraction(random)}, temperature(random), fraction(random)});
+        rgbColors.push_back(rgbcct{{fraction(random), fraction(random), fraction(random)},
+                                   0.01 + fraction(random), 0.01 + fraction(random)});
+    }
+
+    // Accuracy is measured against the old implementation, errors are in fractions of full scale
+    const double ROUNDING = 1e-9;
+    bool ok = true;
+
+    std::vector<rgbcct> rgbReference(values);
+    double speed = throughput(values, [&]() {
+        for (size_t i = 0; i < values; ++i)
+        {
+            rgbReference[i] = baseline::hsv2rgb(hsvColors[i]);
+        }
+        sink = rgbReference[values / 2].color.r;
+    });
+    print("hsv2rgb baseline", 0, speed);
+
+    std::vector<rgbcct> single(values);
+    speed = throughput(values, [&]() {
+        for (size_t i = 0; i < values; ++i)
+        {
+            single[i] = ColorConverter::hsv2rgb(hsvColors[i]);
+        }
+        sink = single[values / 2].color.r;
+    });
+    double error = 0;
+    for (size_t i = 0; i < values; ++i)
+    {
+        error = std::max(error, difference(single[i], rgbReference[i]));
+    }
+    print("hsv2rgb double", error, speed);
+    ok &= error < ROUNDING;
+
+    ok &= checkHsv2Rgb<double>("hsv2rgb double batch", hsvColors, rgbReference) < ROUNDING;
+    checkHsv2Rgb<float>("hsv2rgb float batch", hsvColors, rgbReference);
+    checkHsv2Rgb<Q16>("hsv2rgb Q16 batch", hsvColors, rgbReference);
+
+    std::vector<hsvcct> hsvReference(values);
+    speed = throughput(values, [&]() {
+        for (size_t i = 0; i < values; ++i)
+        {
+            hsvReference[i] = baseline::rgb2hsv(rgbColors[i]);
+        }
+        sink = hsvReference[values / 2].color.h;
+    });
+    print("rgb2hsv baseline", 0, speed);
+
+    std::vector<hsvcct> singleHsv(values);
+    speed = throughput(values, [&]() {
+        for (size_t i = 0; i < values; ++i)
+        {
+            singleHsv[i] = ColorConverter::rgb2hsv(rgbColors[i]);
+        }
+        sink = singleHsv[values / 2].color.h;
+    });
+    error = 0;
+    for (size_t i = 0; i < values; ++i)
+    {
+        error = std::max(error, difference(singleHsv[i], hsvReference[i]));
+    }
+    print("rgb2hsv double", error, speed);
+    ok &= error < ROUNDING;
+
+    ok &= checkRgb2Hsv<double>("rgb2hsv double batch", rgbColors, hsvReference) < ROUNDING;
+    checkRgb2Hsv<float>("rgb2hsv float batch", rgbColors, hsvReference);
+    checkRgb2Hsv<Q16>("rgb2hsv Q16 batch", rgbColors, hsvReference);
+
+    if (!ok)
+    {
+        fprintf(stderr, "the double conversions differ from the old implementation\n");
+        return 1;
+    }
+    return 0;
+}
@@ -0,0 +1,147 @@
+// Host side check and benchmark of the temporal dithering (main/animation/colors/TemporalDither.h).
+//
+// Build: g++ -std=gnu++20 -O2 -Imain tools/dither_bench.cpp main/animation/colors/{ColorConverter,LightTable}.cpp -o dither_bench
+//
+// Usage: dither_bench [LEDS] [OUTPUT_FREQUENCY]
+// Runs the dithered output path of main.cpp for LEDS LEDs (600 by default): one set() per rendered frame at 50 Hz
+// and OUTPUT_FREQUENCY / 50 refreshes (200 Hz by default) of next8BitWWBRG() packed into a GRBWC wire buffer.
+// Prints the CPU time per pixel and per second next to the time the refreshes take on the wire, and the largest
+// difference between the average dithered output and the 16 bit target. Fails if the average is off by more than
+// one 8 bit step divided by the frames it was averaged over.
+// The CPU numbers are for the host, an ESP32 at 240 MHz is roughly 10 - 20 times slower.
+
+#include "animation/colors/TemporalDither.h"
+#include "led_driver/WireFormat.h"
+
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <random>
+#include <vector>
+
+namespace
+{
+
+const size_t MAX_LEDS = 4096;
+const double FREQUENCY = 50; // main.cpp, rendered frames [Hz]
+
+// One LED is 40 bit of 1.25 us, the strip latches after a 300 us reset (LEDDriver.cpp)
+const double LED_WIRE_TIME = 8 * WireFormat::GRBWC::BYTES_PER_LED * 1.25e-6; // [s]
+const double RESET_TIME = 300e-6; // [s]
+
+const int FRAMES = 500;
+
+/// Keeps the optimizer from dropping the output
+volatile uint8_t sink;
+
+} // namespace
+
+int main(int argc, char** argv)
+{
+    const size_t leds = argc > 1 ? strtoul(argv[1], nullptr, 10) : 600;
+    const double outputFrequency = argc > 2 ? strtod(argv[2], nullptr) : 200;
+    const int outputFramesPerStep = outputFrequency / FREQUENCY;
+    if (leds == 0 || leds > MAX_LEDS || outputFramesPerStep < 1)
+    {
+        fprintf(stderr, "usage: %s [LEDS (1 - %zu)] [OUTPUT_FREQUENCY (>= %.0f)]\n", argv[0], MAX_LEDS, FREQUENCY);
+        return 2;
+    }
+
+    static TemporalDither<MAX_LEDS> dither;
+    static LightTable table;
+    std::vector<uint8_t> buffer(leds * WireFormat::GRBWC::BYTES_PER_LED);
+
+    // Dim colors, where dithering matters. Every rendered frame gets new ones like a fading light would.
+    std::mt19937 random(1);
+    std::uniform_real_distribution<double> dim(0, 0.2);
+    std::vector<ColorConverter::rgbcct> colors(leds * FRAMES);
+    for (ColorConverter::rgbcct& color : colors)
+    {
+        color = ColorConverter::rgbcct(ColorConverter::rgb(dim(random), dim(random), dim(random)), dim(random), dim(random));
+    }
+
+    double setTime = 0;
+    double outputTime = 0;
+    for (int frame = 0; frame < FRAMES; ++frame)
+    {
+        auto start = std::chrono::steady_clock::now();
+        for (size_t i = 0; i < leds; ++i)
+        {
+            dither.set(i, table, colors[frame * leds + i]);
+        }
+        auto set = std::chrono::steady_clock::now();
+        for (int output = 0; output < outputFramesPerStep; ++output)
+        {
+            for (size_t i = 0; i < leds; ++i)
+            {
+                WireFormat::pack<WireFormat::GRBWC>(&buffer[i * WireFormat::GRBWC::BYTES_PER_LED], dither.next8BitWWBRG(i));
+            }
+            sink = buffer[leds / 2];
+        }
+        auto end = std::chrono::steady_clock::now();
+
+        setTime += std::chrono::duration<double>(set - start).count();
+        outputTime += std::chrono::duration<double>(end - set).count();
+    }
+
+    const double setPerPixel = setTime / FRAMES / leds;
+    const double outputPerPixel = outputTime / FRAMES / outputFramesPerStep / leds;
+    const double cpuPerSecond = (setPerPixel * FREQUENCY + outputPerPixel * outputFrequency) * leds;
+    const double wireTime = leds * LED_WIRE_TIME + RESET_TIME;
+    const size_t maxLeds = (1 / outputFrequency - RESET_TIME) / LED_WIRE_TIME + 1e-9;
+
+    printf("%zu LEDs, %.0f Hz output (%d refreshes per rendered frame)\n", leds, outputFrequency, outputFramesPerStep);
+    printf("set             %8.2f ns per pixel\n", setPerPixel * 1e9);
+    printf("next + pack     %8.2f ns per pixel and refresh\n", outputPerPixel * 1e9);
+    printf("CPU             %8.2f ms per second (host)\n", cpuPerSecond * 1e3);
+    printf("wire            %8.2f ms per refresh, output period %.2f ms\n", wireTime * 1e3, 1e3 / outputFrequency);
+    printf("max LEDs        %8zu at %.0f Hz\n", maxLeds, outputFrequency);
+    if (wireTime > 1 / outputFrequency)
+    {
+        printf("%zu LEDs do not fit into the output period, the strip is refreshed at %.0f Hz at most\n",
+               leds, 1 / wireTime);
+    }
+
+    // Accuracy: hold one frame and average the output over many refreshes
+    const int AVERAGED = 256;
+    for (size_t i = 0; i < leds; ++i)
+    {
+        dither.set(i, table, colors[i]);
+    }
+    std::vector<uint32_t> sums(leds * LightTable::CHANNEL_COUNT, 0);
+    for (int output = 0; output < AVERAGED; ++output)
+    {
+        for (size_t i = 0; i < leds; ++i)
+        {
+            const uint64_t value = dither.next8BitWWBRG(i);
+            sums[i * LightTable::CHANNEL_COUNT + LightTable::GREEN] += value & 0xFF;
+            sums[i * LightTable::CHANNEL_COUNT + LightTable::RED]   += (value >> 8) & 0xFF;
+            sums[i * LightTable::CHANNEL_COUNT + LightTable::BLUE]  += (value >> 16) & 0xFF;
+            sums[i * LightTable::CHANNEL_COUNT + LightTable::WARM]  += (value >> 24) & 0xFF;
+            sums[i * LightTable::CHANNEL_COUNT + LightTable::COLD]  += (value >> 32) & 0xFF;
+        }
+    }
+
+    double error = 0;
+    for (size_t i = 0; i < leds; ++i)
+    {
+        const ColorConverter::rgbcct& color = colors[i];
+        const float intensities[LightTable::CHANNEL_COUNT] = {float(color.color.r), float(color.color.g), float(color.color.b),
+                                                              float(color.ww), float(color.cw)};
+        for (size_t channel = 0; channel < LightTable::CHANNEL_COUNT; ++channel)
+        {
+            const double target = table.lookup16(LightTable::Channel(channel), intensities[channel]) / 256.0;
+            const double average = double(sums[i * LightTable::CHANNEL_COUNT + channel]) / AVERAGED;
+            error = std::fmax(error, std::fabs(average - target));
+        }
+    }
+    printf("average error   %8.4f 8 bit steps over %d refreshes\n", error, AVERAGED);
+
+    if (error > 1.0 / AVERAGED + 1e-9)
+    {
+        fprintf(stderr, "the dithered average does not match the 16 bit target\n");
+        return 1;
+    }
+    return 0;
+}
@@ -0,0 +1,258 @@
+// Host side encoder, decoder and benchmark for streamed frames (main/connect/FrameCodec.h).
+//
+// Build: g++ -std=gnu++20 -O2 -Imain tools/frame_codec.cpp main/connect/FrameCodec.cpp -o frame_codec
+//
+// A session is a recording of raw wire format frames (LEDS * STRIDE bytes each), concatenated.
+// An encoded stream is a sequence of records: uint16 frameId, uint16 baseId, uint16 payloadSize, payload.
+// Records are what goes into LEDProtocol message 0x10D after the channel byte.
+//
+// Usage:
+//   frame_codec synth  LEDS STRIDE FRAMES              > session.bin   Synthetic session (fades, chases, solid fills)
+//   frame_codec encode LEDS STRIDE [KEYFRAME_INTERVAL] < session.bin > stream.bin
+//   frame_codec decode LEDS STRIDE                     < stream.bin  > session.bin
+//   frame_codec bench  LEDS STRIDE session.bin...                      Compression ratio and decode throughput
+//
+// encode and bench assume every frame was acknowledged before the next one is sent, so each frame is coded
+// against the previous one. Frames whose payload exceeds FrameStreamBase::MAX_PAYLOAD are counted as too big.
+
+#include "connect/FrameCodec.h"
+#include "connect/FrameStream.h"
+
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <vector>
+
+namespace
+{
+
+const size_t MAX_PAYLOAD = FrameStreamBase::MAX_PAYLOAD;
+const uint16_t NO_FRAME = FrameStreamBase::NO_FRAME;
+
+std::vector<uint8_t> readAll(FILE* file)
+{
+    std::vector<uint8_t> data;
+    uint8_t buffer[4096];
+    size_t read;
+    while ((read = fread(buffer, 1, sizeof(buffer), file)) > 0)
+    {
+        data.insert(data.end(), buffer, buffer + read);
+    }
+    return data;
+}
+
+void writeRecord(uint16_t frameId, uint16_t baseId, const uint8_t* payload, uint16_t size)
+{
+    fwrite(&frameId, sizeof(frameId), 1, stdout);
+    fwrite(&baseId, sizeof(baseId), 1, stdout);
+    fwrite(&size, sizeof(size), 1, stdout);
+    fwrite(payload, 1, size, stdout);
+}
+
+int synth(size_t leds, size_t stride, size_t frames)
+{
+    std::vector<uint8_t> frame(leds * stride);
+    for (size_t f = 0; f < frames; ++f)
+    {
+        const size_t scene = (f / 200) % 3;
+        for (size_t i = 0; i < leds; ++i)
+        {
+            uint8_t* led = &frame[i * stride];
+            memset(led, 0, stride);
+            if (scene == 0)
+            {
+                // Slow fade of the whole strip
+                led[0] = led[1] = 128 + 127 * sin(f * 0.05);
+            }
+            else if (scene == 1)
+            {
+                // Blinker chase over a solid background
+                const size_t head = f % leds;
+                led[1] = 40;
+                if (i <= head && head - i < leds / 8)
+                {
+                    led[0] = 120;
+                    led[1] = 255;
+                }
+            }
+            else
+            {
+                // Solid white with a color change every second
+                led[stride - 1] = (f / 50) % 2 ? 255 : 100;
+            }
+        }
+        fwrite(frame.data(), 1, frame.size(), stdout);
+    }
+    return 0;
+}
+
+int encode(size_t leds, size_t stride, size_t keyframeInterval)
+{
+    const size_t frameSize = leds * stride;
+    std::vector<uint8_t> session = readAll(stdin);
+    std::vector<uint8_t> payload(MAX_PAYLOAD);
+
+    const uint8_t* previous = nullptr;
+    size_t tooBig = 0;
+    for (size_t f = 0; (f + 1) * frameSize <= session.size(); ++f)
+    {
+        const uint8_t* frame = &session[f * frameSize];
+        const bool keyframe = previous == nullptr || (keyframeInterval > 0 && f % keyframeInterval == 0);
+        const uint16_t frameId = f % NO_FRAME;
+
+        size_t size = 0;
+        if (!FrameCodec::encode(frame, keyframe ? nullptr : previous, frameSize, stride, payload.data(), payload.size(), size))
+        {
+            // The receiver keeps its reference, so the next frame is coded against the same one
+            ++tooBig;
+            continue;
+        }
+
+        writeRecord(frameId, keyframe ? NO_FRAME : (f - 1) % NO_FRAME, payload.data(), size);
+        previous = frame;
+    }
+
+    if (tooBig > 0)
+    {
+        fprintf(stderr, "%zu frames did not fit into %zu bytes and were dropped\n", tooBig, MAX_PAYLOAD);
+    }
+    return 0;
+}
+
+int decode(size_t leds, size_t stride)
+{
+    const size_t frameSize = leds * stride;
+    std::vector<uint8_t> stream = readAll(stdin);
+    std::vector<uint8_t> reference(frameSize);
+    std::vector<uint8_t> out(frameSize);
+
+    size_t offset = 0;
+    while (offset + 6 <= stream.size())
+    {
+        uint16_t frameId, baseId, size;
+        memcpy(&frameId, &stream[offset], 2);
+        memcpy(&baseId, &stream[offset + 2], 2);
+        memcpy(&size, &stream[offset + 4], 2);
+        offset += 6;
+
+        if (offset + size > stream.size() || !FrameCodec::validate(&stream[offset], size, frameSize, stride))
+        {
+            fprintf(stderr, "frame %u is malformed\n", frameId);
+            return 1;
+        }
+        if (baseId == NO_FRAME)
+        {
+            std::fill(reference.begin(), reference.end(), 0);
+        }
+        FrameCodec::decode(&stream[offset], size, reference.data(), out.data(), frameSize, stride);
+        fwrite(out.data(), 1, frameSize, stdout);
+        offset += size;
+    }
+    return 0;
+}
+
+int bench(size_t leds, size_t stride, int fileCount, char** files)
+{
+    const size_t frameSize = leds * stride;
+    printf("%-24s %8s %12s %12s %8s %8s %8s %12s\n", "session", "frames", "raw bytes", "coded bytes", "ratio", "max", "too big", "decode MB/s");
+
+    for (int file = 0; file < fileCount; ++file)
+    {
+        FILE* input = fopen(files[file], "rb");
+        if (!input)
+        {
+            fprintf(stderr, "cannot open %s\n", files[file]);
+            return 1;
+        }
+        std::vector<uint8_t> session = readAll(input);
+        fclose(input);
+
+        const size_t frames = session.size() / frameSize;
+        std::vector<std::vector<uint8_t>> payloads;
+        std::vector<bool> keyframes;
+        std::vector<uint8_t> payload(frameSize * 2 + 16);
+        size_t coded = 0;
+        size_t largest = 0;
+        size_t tooBig = 0;
+        for (size_t f = 0; f < frames; ++f)
+        {
+            const uint8_t* previous = f > 0 ? &session[(f - 1) * frameSize] : nullptr;
+            size_t size = 0;
+            FrameCodec::encode(&session[f * frameSize], previous, frameSize, stride, payload.data(), payload.size(), size);
+            payloads.emplace_back(payload.begin(), payload.begin() + size);
+            keyframes.push_back(previous == nullptr);
+            coded += size;
+            largest = size > largest ? size : largest;
+            tooBig += size > MAX_PAYLOAD;
+        }
+
+        std::vector<uint8_t> reference(frameSize);
+        std::vector<uint8_t> out(frameSize);
+        const int RUNS = 20;
+        const auto start = std::chrono::steady_clock::now();
+        for (int run = 0; run < RUNS; ++run)
+        {
+            for (size_t f = 0; f < frames; ++f)
+            {
+                if (keyframes[f])
+                {
+                    std::fill(reference.begin(), reference.end(), 0);
+                }
+                FrameCodec::decode(payloads[f].data(), payloads[f].size(), reference.data(), out.data(), frameSize, stride);
+            }
+        }
+        const double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+        if (frames > 0 && memcmp(out.data(), &session[(frames - 1) * frameSize], frameSize) != 0)
+        {
+            fprintf(stderr, "%s: decoded frames do not match the session\n", files[file]);
+            return 1;
+        }
+
+        printf("%-24s %8zu %12zu %12zu %8.1f %8zu %8zu %12.0f\n", files[file], frames, frames * frameSize, coded,
+               coded > 0 ? static_cast<double>(frames * frameSize) / coded : 0.0, largest, tooBig,
+               RUNS * frames * frameSize / seconds / 1e6);
+    }
+    return 0;
+}
+
+} // namespace
+
+int main(int argc, char** argv)
+{
+    if (argc < 4)
+    {
+        fprintf(stderr, "usage: %s synth|encode|decode|bench LEDS STRIDE ...\n", argv[0]);
+        return 2;
+    }
+
+    const size_t leds = strtoul(argv[2], nullptr, 10);
+    const size_t stride = strtoul(argv[3], nullptr, 10);
+    if (leds == 0 || stride == 0)
+    {
+        fprintf(stderr, "LEDS and STRIDE must be greater than 0\n");
+        return 2;
+    }
+
+    if (strcmp(argv[1], "synth") == 0 && argc == 5)
+    {
+        return synth(leds, stride, strtoul(argv[4], nullptr, 10));
+    }
+    if (strcmp(argv[1], "encode") == 0)
+    {
+        return encode(leds, stride, argc > 4 ? strtoul(argv[4], nullptr, 10) : 0);
+    }
+    if (strcmp(argv[1], "decode") == 0)
+    {
+        return decode(leds, stride);
+    }
+    if (strcmp(argv[1], "bench") == 0 && argc > 4)
+    {
+        return bench(leds, stride, argc - 4, &argv[4]);
+    }
+
+    fprintf(stderr, "unknown command or missing arguments\n");
+    return 2;
+}
@@ -0,0 +1,21 @@
+// Host stand-in for the ESP-IDF logging macros, so firmware sources build into host tools.
+// Logs go to stderr when HOST_LOG is defined, otherwise they are dropped.
+
+#ifndef HOST_ESP_LOG_H
+#define HOST_ESP_LOG_H
+
+#include <stdio.h>
+
+#ifdef HOST_LOG
+#define HOST_LOG_PRINT(level, tag, format, ...) fprintf(stderr, level " (%s) " format "\n", tag, ##__VA_ARGS__)
+#else
+#define HOST_LOG_PRINT(level, tag, format, ...) do { if (0) fprintf(stderr, format, ##__VA_ARGS__); } while (0)
+#endif
+
+#define ESP_LOGE(tag, format, ...) HOST_LOG_PRINT("E", tag, format, ##__VA_ARGS__)
+#define ESP_LOGW(tag, format, ...) HOST_LOG_PRINT("W", tag, format, ##__VA_ARGS__)
+#define ESP_LOGI(tag, format, ...) HOST_LOG_PRINT("I", tag, format, ##__VA_ARGS__)
+#define ESP_LOGD(tag, format, ...) HOST_LOG_PRINT("D", tag, format, ##__VA_ARGS__)
+#define ESP_LOGV(tag, format, ...) HOST_LOG_PRINT("V", tag, format, ##__VA_ARGS__)
+
+#endif // HOST_ESP_LOG_H
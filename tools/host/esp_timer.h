@@ -0,0 +1,16 @@
+// Host stand-in for esp_timer_get_time(), so firmware sources build into host tools.
+
+#ifndef HOST_ESP_TIMER_H
+#define HOST_ESP_TIMER_H
+
+#include <stdint.h>
+
+#include <chrono>
+
+/// Microseconds since an arbitrary point, like the time since boot on the device
+inline int64_t esp_timer_get_time()
+{
+    return std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+#endif // HOST_ESP_TIMER_H
@@ -0,0 +1,159 @@
+// Host side benchmark of frame interpolation against full rendering (main/led_driver/FrameInterpolator.h).
+//
+// Build: g++ -std=gnu++20 -O2 -Imain tools/interpolate_bench.cpp main/animation/CarLight.cpp main/animation/effects/Effect.cpp main/animation/parallel/ParallelFor.cpp main/animation/filters/*.cpp main/animation/colors/{ColorConverter,LightTable}.cpp -pthread -o interpolate_bench
+//
+// Usage: interpolate_bench [KEYFRAME_FREQUENCY]
+// Plays the same animation (fade in, color change, brake, blinker, fade out) on two lights of 2000 LEDs:
+// one rendered for every output frame at 200 Hz, the other rendered at KEYFRAME_FREQUENCY (50 Hz by default)
+// and blended up to 200 Hz like main.cpp does with INTERPOLATE_FRAMES.
+// Prints the CPU time per second of output of both and how far the blended frames are from the rendered ones.
+// Slow fades blend almost exactly, the large errors come from edges that move along the strip (turn on, blinker).
+// Interpolation shows every moment later than full rendering (see FrameInterpolator.h), the quality numbers compare
+// against the rendered frame of the same moment so they only count the error of the blend.
+
+#include "animation/CarLight.h"
+#include "animation/colors/LightTable.h"
+#include "led_driver/FrameInterpolator.h"
+#include "led_driver/WireFormat.h"
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <vector>
+
+namespace
+{
+
+const size_t LEDS = 2000;
+const double OUTPUT_FREQUENCY = 200; // [Hz]
+const double DURATION = 6; // [s]
+
+/// Differences above this many 8 bit steps are counted as visible
+const int VISIBLE_ERROR = 4;
+
+typedef WireFormat::GRBWC Format;
+const size_t FRAME_SIZE = LEDS * Format::BYTES_PER_LED;
+typedef FrameInterpolator<FRAME_SIZE> Interpolator;
+
+/// Commands of the animation at the given time
+void animate(CarLightBase& light, double time, double period)
+{
+    auto at = [&](double when) { return time <= when && when < time + period; };
+
+    if (at(0))
+    {
+        light.turnOn();
+    }
+    if (at(1))
+    {
+        light.setColor(0.1, 0.4, 1);
+    }
+    if (at(2))
+    {
+        light.turnOnBrake();
+    }
+    if (at(3))
+    {
+        light.turnOffBrake();
+        light.turnOnLeft();
+    }
+    if (at(5))
+    {
+        light.turnOffBlinker();
+        light.turnOff();
+    }
+}
+
+void render(const CarLightBase& light, const LightTable& table, uint8_t* frame)
+{
+    const ColorConverter::rgbcct* pixels = light.getPixels();
+    for (size_t i = 0; i < LEDS; ++i)
+    {
+        WireFormat::pack<Format>(&frame[i * Format::BYTES_PER_LED], table.to8BitWWBRG(pixels[i]));
+    }
+}
+
+} // namespace
+
+int main(int argc, char** argv)
+{
+    const double keyframeFrequency = argc > 1 ? strtod(argv[1], nullptr) : 50;
+    const int outputFramesPerKeyframe = OUTPUT_FREQUENCY / keyframeFrequency + 0.5;
+    if (outputFramesPerKeyframe < 1 || OUTPUT_FREQUENCY / outputFramesPerKeyframe != keyframeFrequency)
+    {
+        fprintf(stderr, "usage: %s [KEYFRAME_FREQUENCY], %.0f Hz must be a multiple of it\n", argv[0], OUTPUT_FREQUENCY);
+        return 2;
+    }
+
+    const double outputPeriod = 1 / OUTPUT_FREQUENCY;
+    const double keyframePeriod = outputFramesPerKeyframe * outputPeriod;
+    const size_t outputFrames = DURATION * OUTPUT_FREQUENCY;
+
+    const ColorConverter::rgbcct color(ColorConverter::rgb(1, 0.2, 0), 0.2, 0.3);
+    static CarLight<LEDS> full(outputPeriod, color);
+    static CarLight<LEDS> keyframed(keyframePeriod, color);
+    static LightTable table;
+    static Interpolator interpolator;
+
+    // Every output frame, rendered in full. Frame n shows the light at time (n + 1) * outputPeriod.
+    std::vector<uint8_t> rendered(outputFrames * FRAME_SIZE);
+    double fullSeconds = 0;
+    for (size_t n = 0; n < outputFrames; ++n)
+    {
+        animate(full, n * outputPeriod, outputPeriod);
+        const auto start = std::chrono::steady_clock::now();
+        full.step();
+        render(full, table, &rendered[n * FRAME_SIZE]);
+        fullSeconds += std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    }
+
+    // Blended output. The blends after keyframe k move from the light at time k * keyframePeriod to (k + 1) * keyframePeriod,
+    // so blend f shows the moment of rendered frame k * outputFramesPerKeyframe + f.
+    std::vector<uint8_t> blended(FRAME_SIZE);
+    double interpolatedSeconds = 0;
+    double errorSum = 0;
+    int maxError = 0;
+    size_t compared = 0;
+    size_t visible = 0;
+    for (size_t k = 0; k * outputFramesPerKeyframe < outputFrames; ++k)
+    {
+        animate(keyframed, k * keyframePeriod, keyframePeriod);
+        auto start = std::chrono::steady_clock::now();
+        keyframed.step();
+        render(keyframed, table, interpolator.nextKeyframe());
+        interpolator.pushKeyframe();
+        interpolatedSeconds += std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+        for (int f = 0; f < outputFramesPerKeyframe; ++f)
+        {
+            start = std::chrono::steady_clock::now();
+            interpolator.blend(blended.data(), (f + 1) * Interpolator::PHASE_ONE / outputFramesPerKeyframe);
+            interpolatedSeconds += std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+            // The light starts off, so blending from the empty buffer before the first keyframe is right
+            const size_t n = k * outputFramesPerKeyframe + f;
+            if (n >= outputFrames)
+            {
+                continue;
+            }
+            const uint8_t* reference = &rendered[n * FRAME_SIZE];
+            for (size_t i = 0; i < FRAME_SIZE; ++i)
+            {
+                const int error = abs(int(blended[i]) - int(reference[i]));
+                errorSum += error;
+                maxError = error > maxError ? error : maxError;
+                visible += error > VISIBLE_ERROR;
+            }
+            compared += FRAME_SIZE;
+        }
+    }
+
+    printf("%zu LEDs, %.0f Hz output, keyframes at %.0f Hz\n", LEDS, OUTPUT_FREQUENCY, keyframeFrequency);
+    printf("full render     %8.2f ms CPU per second\n", fullSeconds / DURATION * 1e3);
+    printf("interpolated    %8.2f ms CPU per second (%.1fx less)\n", interpolatedSeconds / DURATION * 1e3,
+           fullSeconds / interpolatedSeconds);
+    printf("latency         %8.2f ms more than full render\n", (keyframePeriod - outputPeriod) * 1e3);
+    printf("error           %8.3f mean, %d max (8 bit steps), %.2f %% of the values off by more than %d\n",
+           compared ? errorSum / compared : 0.0, maxError, compared ? 100.0 * visible / compared : 0.0, VISIBLE_ERROR);
+    return 0;
+}
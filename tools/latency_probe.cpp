@@ -0,0 +1,335 @@
+// Measures command-to-photon latency with tagged commands (LEDProtocol 0x110, main/connect/LatencyProbe.h).
+//
+// Build: g++ -std=gnu++20 -O2 -Imain tools/latency_probe.cpp main/connect/LatencyProbe.cpp -pthread -o latency_probe
+//
+// Usage:
+//   latency_probe device HOST [PORT] [RATE] [COUNT] [COMMAND]   Probe a light (port 8002 by default)
+//   latency_probe loopback [RATE] [COUNT] [COMMAND]             Probe a stand-in on 127.0.0.1
+// RATE is in probes per second (10), COUNT the number of probes (200).
+// COMMAND is an optional message in hex (ID, channel, fields of main/connect/MessageSchema.h) that the probes wrap,
+// e.g. 080100000001 turns channel 0 on.
+//
+// The stand-in runs the firmware's LatencyProbe behind a UDP socket and renders at 50 Hz with a simulated
+// transmission of 1 ms, so the tool and the echo format can be checked without hardware.
+// Prints percentiles of every stage. Network is the round trip minus the time spent on the device.
+// Probes sent while the previous one was still in flight on the device are echoed untagged and count as lost.
+
+#include "connect/LatencyProbe.h"
+#include "connect/MessageSchema.h"
+
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <map>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace
+{
+
+const uint16_t DEFAULT_PORT = 8002;
+
+int64_t nowMicros()
+{
+    return std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+bool parseHex(const char* text, std::vector<uint8_t>& bytes)
+{
+    const size_t length = strlen(text);
+    if (length % 2 != 0)
+    {
+        return false;
+    }
+    for (size_t i = 0; i < length; i += 2)
+    {
+        char byte[3] = {text[i], text[i + 1], 0};
+        char* end;
+        bytes.push_back(static_cast<uint8_t>(strtoul(byte, &end, 16)));
+        if (*end != 0)
+        {
+            return false;
+        }
+    }
+    return true;
+}
+
+/// Firmware stand-in: a network thread feeding the probe and a render thread at FREQUENCY
+class StandIn
+{
+public:
+    static const int FREQUENCY = 50; // [Hz]
+    static const int TRANSMIT_MICROS = 1000;
+
+    StandIn() : sock(socket(AF_INET, SOCK_DGRAM, 0)), running(true), senderLength(0)
+    {
+        sockaddr_in address = {};
+        address.sin_family = AF_INET;
+        address.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+        address.sin_port = 0;
+        bind(sock, reinterpret_cast<sockaddr*>(&address), sizeof(address));
+
+        socklen_t length = sizeof(address);
+        getsockname(sock, reinterpret_cast<sockaddr*>(&address), &length);
+        port = ntohs(address.sin_port);
+
+        timeval timeout = {0, 100000};
+        setsockopt(sock, SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof(timeout));
+
+        probe.echoHandler = [this](const uint8_t* buffer, size_t size)
+        {
+            std::lock_guard<std::mutex> lock(senderMutex);
+            sendto(sock, buffer, size, 0, reinterpret_cast<sockaddr*>(&sender), senderLength);
+        };
+
+        network = std::thread(&StandIn::networkLoop, this);
+        render = std::thread(&StandIn::renderLoop, this);
+    }
+
+    ~StandIn()
+    {
+        running = false;
+        network.join();
+        render.join();
+        close(sock);
+    }
+
+    uint16_t getPort() const { return port; }
+
+private:
+    void networkLoop()
+    {
+        uint8_t buffer[512];
+        while (running)
+        {
+            sockaddr_in from;
+            socklen_t fromLength = sizeof(from);
+            const ssize_t received = recvfrom(sock, buffer, sizeof(buffer), 0, reinterpret_cast<sockaddr*>(&from), &fromLength);
+            if (received < static_cast<ssize_t>(sizeof(uint32_t)))
+            {
+                continue;
+            }
+            const int64_t time = nowMicros();
+            {
+                std::lock_guard<std::mutex> lock(senderMutex);
+                sender = from;
+                senderLength = fromLength;
+            }
+
+            uint32_t id;
+            MessageSchema::LatencyProbeMessage message;
+            memcpy(&id, buffer, sizeof(id));
+            if (id == MessageSchema::LatencyProbeMessage::ID && message.decode(&buffer[sizeof(uint32_t)], received - sizeof(uint32_t)) &&
+                probe.begin(message.tag, time))
+            {
+                // Executing the wrapped command is left out, the stand-in has no light
+                probe.applied(nowMicros());
+            }
+        }
+    }
+
+    void renderLoop()
+    {
+        auto wake = std::chrono::steady_clock::now();
+        while (running)
+        {
+            probe.beginFrame();
+            if (probe.rendered(nowMicros()))
+            {
+                std::this_thread::sleep_for(std::chrono::microseconds(TRANSMIT_MICROS));
+                probe.transmitted(nowMicros());
+            }
+
+            wake += std::chrono::microseconds(1000000 / FREQUENCY);
+            std::this_thread::sleep_until(wake);
+        }
+    }
+
+    int sock;
+    uint16_t port;
+    std::atomic<bool> running;
+    LatencyProbe probe;
+
+    std::mutex senderMutex;
+    sockaddr_in sender;
+    socklen_t senderLength;
+
+    std::thread network;
+    std::thread render;
+};
+
+struct Sample
+{
+    int64_t received;   // Time from received to applied
+    int64_t applied;    // Time from applied to rendered
+    int64_t rendered;   // Time from rendered to transmitted
+    int64_t device;     // Time from received to transmitted
+    int64_t network;    // Round trip minus device
+    int64_t roundTrip;
+};
+
+void printPercentiles(const char* name, std::vector<int64_t> values)
+{
+    if (values.empty())
+    {
+        return;
+    }
+    std::sort(values.begin(), values.end());
+    auto at = [&](double p) { return values[std::min(values.size() - 1, static_cast<size_t>(p * values.size()))]; };
+    printf("%-12s %8.2f %8.2f %8.2f %8.2f %8.2f\n", name, at(0.0) / 1000.0, at(0.5) / 1000.0, at(0.9) / 1000.0,
+           at(0.99) / 1000.0, values.back() / 1000.0);
+}
+
+int run(const sockaddr_in& target, double rate, size_t count, const std::vector<uint8_t>& command)
+{
+    const int sock = socket(AF_INET, SOCK_DGRAM, 0);
+    timeval timeout = {0, 100000};
+    setsockopt(sock, SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof(timeout));
+
+    std::mutex mutex;
+    std::map<uint32_t, int64_t> sent;
+    std::vector<Sample> samples;
+    std::atomic<bool> sending(true);
+
+    std::thread receiver([&]()
+    {
+        uint8_t buffer[512];
+        int64_t lastSend = nowMicros();
+        while (sending || nowMicros() - lastSend < 1000000)
+        {
+            const ssize_t received = recv(sock, buffer, sizeof(buffer), 0);
+            const int64_t time = nowMicros();
+            if (sending)
+            {
+                lastSend = time;
+            }
+
+            uint32_t id;
+            MessageSchema::LatencyEchoReply echo;
+            if (received < static_cast<ssize_t>(sizeof(uint32_t)))
+            {
+                continue;
+            }
+            memcpy(&id, buffer, sizeof(id));
+            if (id != MessageSchema::LatencyEchoReply::ID || !echo.decode(&buffer[sizeof(uint32_t)], received - sizeof(uint32_t)))
+            {
+                continue;
+            }
+
+            std::lock_guard<std::mutex> lock(mutex);
+            auto probe = sent.find(echo.tag);
+            if (probe == sent.end())
+            {
+                continue;
+            }
+
+            Sample sample;
+            sample.received = echo.applied - echo.received;
+            sample.applied = echo.rendered - echo.applied;
+            sample.rendered = echo.transmitted - echo.rendered;
+            sample.device = echo.transmitted - echo.received;
+            sample.roundTrip = time - probe->second;
+            sample.network = sample.roundTrip - sample.device;
+            samples.push_back(sample);
+            sent.erase(probe);
+        }
+    });
+
+    MessageSchema::LatencyProbeMessage probe = {};
+    probe.command = command.data();
+    probe.commandSize = command.size();
+    std::vector<uint8_t> message(probe.getSize());
+
+    auto wake = std::chrono::steady_clock::now();
+    for (uint32_t tag = 1; tag <= count; ++tag)
+    {
+        probe.tag = tag;
+        probe.encode(message.data(), message.size());
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            sent[tag] = nowMicros();
+        }
+        sendto(sock, message.data(), message.size(), 0, reinterpret_cast<const sockaddr*>(&target), sizeof(target));
+
+        wake += std::chrono::microseconds(static_cast<int64_t>(1000000 / rate));
+        std::this_thread::sleep_until(wake);
+    }
+    sending = false;
+    receiver.join();
+    close(sock);
+
+    std::vector<int64_t> stages[6];
+    for (const Sample& sample : samples)
+    {
+        stages[0].push_back(sample.received);
+        stages[1].push_back(sample.applied);
+        stages[2].push_back(sample.rendered);
+        stages[3].push_back(sample.device);
+        stages[4].push_back(sample.network);
+        stages[5].push_back(sample.roundTrip);
+    }
+
+    printf("%zu probes, %zu echoed, %zu lost\n", count, samples.size(), count - samples.size());
+    printf("%-12s %8s %8s %8s %8s %8s   [ms]\n", "stage", "min", "p50", "p90", "p99", "max");
+    printPercentiles("parse", stages[0]);
+    printPercentiles("frame wait", stages[1]);
+    printPercentiles("transmit", stages[2]);
+    printPercentiles("device", stages[3]);
+    printPercentiles("network", stages[4]);
+    printPercentiles("round trip", stages[5]);
+
+    return samples.empty() ? 1 : 0;
+}
+
+} // namespace
+
+int main(int argc, char** argv)
+{
+    const bool loopback = argc >= 2 && strcmp(argv[1], "loopback") == 0;
+    const bool device = argc >= 3 && strcmp(argv[1], "device") == 0;
+    if (!loopback && !device)
+    {
+        fprintf(stderr, "usage: %s device HOST [PORT] [RATE] [COUNT] [COMMAND] | loopback [RATE] [COUNT] [COMMAND]\n", argv[0]);
+        return 2;
+    }
+
+    // Arguments after the target
+    char** options = loopback ? &argv[2] : &argv[4];
+    const int optionCount = loopback ? argc - 2 : argc - 4;
+
+    sockaddr_in target = {};
+    target.sin_family = AF_INET;
+    target.sin_port = htons(device && argc > 3 ? atoi(argv[3]) : DEFAULT_PORT);
+    if (inet_pton(AF_INET, loopback ? "127.0.0.1" : argv[2], &target.sin_addr) != 1)
+    {
+        fprintf(stderr, "HOST must be an IPv4 address\n");
+        return 2;
+    }
+
+    const double rate = optionCount > 0 ? atof(options[0]) : 10;
+    const size_t count = optionCount > 1 ? strtoul(options[1], nullptr, 10) : 200;
+    std::vector<uint8_t> command;
+    if (rate <= 0 || count == 0 || (optionCount > 2 && !parseHex(options[2], command)))
+    {
+        fprintf(stderr, "RATE and COUNT must be greater than 0, COMMAND must be hex\n");
+        return 2;
+    }
+
+    if (loopback)
+    {
+        StandIn standIn;
+        target.sin_port = htons(standIn.getPort());
+        return run(target, rate, count, command);
+    }
+    return run(target, rate, count, command);
+}
@@ -0,0 +1,252 @@
+// Command line control of a light through the host client (tools/client/LEDClient.h).
+//
+// Build: g++ -std=gnu++20 -O2 -Imain -Itools/client tools/led_ctl.cpp tools/client/LEDClient.cpp -o led_ctl
+//
+// Usage: led_ctl [-g GROUPS] [-n NODES] [-s SEGMENT] HOST COMMAND...
+//   -g GROUPS      Only lights in any of these groups (bit mask, e.g. 0x3), see main/connect/NodeAddress.h
+//   -n NODES       Only lights with these node IDs (bit mask, e.g. 0x5 for nodes 0 and 2)
+//   -s SEGMENT     Only this segment of the light (1 = first), see main/animation/SegmentedLight.h
+//   color R G B    Base color [0, 1]
+//   dim X          Color brightness [0, 1]
+//   white X        White brightness [0, 1]
+//   temp K         White temperature [Kelvin]
+//   filter T [R]   Pixel filter time constant T [seconds] and response R: onepole, critical or butterworth
+//                  (the light's default, critical, without R)
+//   on | off
+//   status         Prints the state of the light
+// All commands of one call go out together, e.g. "led_ctl 192.168.0.83 color 1 0 0 dim 0.5 on" is a single datagram.
+// HOST may be the multicast group of a fleet, "led_ctl -g 0x2 239.255.0.1 off" turns off every light in group 1.
+
+#include "LEDClient.h"
+
+#include "connect/LightStatus.h"
+
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+
+namespace
+{
+
+uint16_t toUnit16(const char* text)
+{
+    const double value = atof(text);
+    return static_cast<uint16_t>((value < 0 ? 0 : (value > 1 ? 1 : value)) * 0xFFFF + 0.5);
+}
+
+template <typename T>
+T take(const uint8_t*& data)
+{
+    T value;
+    memcpy(&value, data, sizeof(T));
+    data += sizeof(T);
+    return value;
+}
+
+/// Prints a serialized LightStatus::Channel
+void printChannel(const uint8_t*& data)
+{
+    const uint8_t flags = take<uint8_t>(data);
+    const double red = take<uint16_t>(data) / 65535.0;
+    const double green = take<uint16_t>(data) / 65535.0;
+    const double blue = take<uint16_t>(data) / 65535.0;
+    const double colorBrightness = take<uint16_t>(data) / 65535.0;
+    const double whiteBrightness = take<uint16_t>(data) / 65535.0;
+    const unsigned temperature = take<uint16_t>(data);
+    printf("%s, color %.3f %.3f %.3f dim %.3f, white %.3f at %u K, flags 0x%02x\n",
+           flags & LightStatus::ON ? "on" : "off", red, green, blue, colorBrightness, whiteBrightness, temperature, flags);
+}
+
+/// Prints a serialized LightStatus
+void printStatus(const MessageSchema::StatusReply& reply)
+{
+    const uint8_t* data = reply.status;
+    const uint8_t* end = reply.status + reply.statusSize;
+    if (reply.statusSize < sizeof(uint8_t) + sizeof(uint32_t) + 2 * sizeof(uint8_t) || take<uint8_t>(data) != LightStatus::VERSION)
+    {
+        printf("unknown status format\n");
+        return;
+    }
+
+    const char* MODES[] = {"rendered", "indexed", "stream", "clip"};
+    const uint32_t frame = take<uint32_t>(data);
+    const uint8_t mode = take<uint8_t>(data);
+    printf("frame %u, mode %s\n", frame, mode < 4 ? MODES[mode] : "unknown");
+
+    const uint8_t channels = take<uint8_t>(data);
+    for (uint8_t i = 0; i < channels && end - data >= static_cast<ptrdiff_t>(LightStatus::CHANNEL_SIZE); ++i)
+    {
+        printf("channel %u: ", i);
+        printChannel(data);
+    }
+
+    if (end - data >= static_cast<ptrdiff_t>(sizeof(uint8_t)))
+    {
+        const uint8_t strips = take<uint8_t>(data);
+        for (uint8_t i = 0; i < strips && end - data >= static_cast<ptrdiff_t>(LightStatus::STRIP_SIZE); ++i)
+        {
+            const unsigned first = take<uint16_t>(data);
+            const unsigned count = take<uint16_t>(data);
+            printf("strip %u: LEDs %u to %u\n", i, first, first + count - 1);
+        }
+    }
+
+    if (end - data >= static_cast<ptrdiff_t>(sizeof(uint8_t) + sizeof(uint32_t)))
+    {
+        const char* QUALITIES[] = {"full", "no filters", "spans", "half rate"};
+        const uint8_t quality = take<uint8_t>(data);
+        const uint32_t changes = take<uint32_t>(data);
+        printf("quality %s (%u changes)\n", quality < 4 ? QUALITIES[quality] : "unknown", changes);
+    }
+
+    if (end - data >= static_cast<ptrdiff_t>(sizeof(uint8_t)))
+    {
+        const uint8_t segments = take<uint8_t>(data);
+        for (uint8_t i = 0; i < segments && end - data >= static_cast<ptrdiff_t>(LightStatus::SEGMENT_SIZE); ++i)
+        {
+            const unsigned first = take<uint16_t>(data);
+            const unsigned count = take<uint16_t>(data);
+            printf("segment %u: pixels %u to %u, ", i + 1, first, first + count - 1);
+            printChannel(data);
+        }
+    }
+}
+
+} // namespace
+
+int main(int argc, char** argv)
+{
+    uint32_t groups = 0;
+    uint64_t nodes = 0;
+    uint8_t segment = 0;
+    int first = 1;
+    while (first + 1 < argc && (strcmp(argv[first], "-g") == 0 || strcmp(argv[first], "-n") == 0 || strcmp(argv[first], "-s") == 0))
+    {
+        if (argv[first][1] == 'g')
+        {
+            groups = strtoul(argv[first + 1], nullptr, 0);
+        }
+        else if (argv[first][1] == 'n')
+        {
+            nodes = strtoull(argv[first + 1], nullptr, 0);
+        }
+        else
+        {
+            segment = atoi(argv[first + 1]);
+        }
+        first += 2;
+    }
+
+    if (argc - first < 2)
+    {
+        fprintf(stderr, "usage: %s [-g GROUPS] [-n NODES] [-s SEGMENT] HOST color R G B | dim X | white X | temp K | filter T [R] | on | off | status ...\n", argv[0]);
+        return 2;
+    }
+
+    LEDClient client(argv[first]);
+    if (!client.isOpen())
+    {
+        fprintf(stderr, "HOST must be an IPv4 address\n");
+        return 2;
+    }
+    client.setAddress(groups, nodes);
+    client.setSegment(segment);
+
+    bool queryStatus = false;
+    for (int i = first + 1; i < argc; ++i)
+    {
+        const char* command = argv[i];
+        const int arguments = argc - i - 1;
+        if (strcmp(command, "color") == 0 && arguments >= 3)
+        {
+            MessageSchema::ColorMessage message = {};
+            message.red = toUnit16(argv[i + 1]);
+            message.green = toUnit16(argv[i + 2]);
+            message.blue = toUnit16(argv[i + 3]);
+            client.queue(message);
+            i += 3;
+        }
+        else if ((strcmp(command, "dim") == 0 || strcmp(command, "white") == 0) && arguments >= 1)
+        {
+            if (command[0] == 'd')
+            {
+                MessageSchema::DimMessage message = {};
+                message.dim = toUnit16(argv[i + 1]);
+                client.queue(message);
+            }
+            else
+            {
+                MessageSchema::WhiteDimMessage message = {};
+                message.dim = toUnit16(argv[i + 1]);
+                client.queue(message);
+            }
+            i += 1;
+        }
+        else if (strcmp(command, "temp") == 0 && arguments >= 1)
+        {
+            MessageSchema::WhiteTemperatureMessage message = {};
+            message.temperature = atoi(argv[i + 1]);
+            client.queue(message);
+            i += 1;
+        }
+        else if (strcmp(command, "filter") == 0 && arguments >= 1)
+        {
+            // The response is optional, the next argument may as well be the next command
+            const char* RESPONSES[] = {"onepole", "critical", "butterworth"};
+            uint8_t response = 0;
+            bool named = false;
+            for (uint8_t r = 0; r < 3 && arguments >= 2; ++r)
+            {
+                if (strcmp(argv[i + 2], RESPONSES[r]) == 0)
+                {
+                    response = r;
+                    named = true;
+                }
+            }
+
+            // The light takes resistance * capacitance as time constant, and its default response without one
+            MessageSchema::SetFilterValuesMessage message = {};
+            message.capacitance = atof(argv[i + 1]);
+            message.resistance = 1;
+            message.response = &response;
+            message.responseSize = named ? sizeof(response) : 0;
+            client.queue(message);
+            i += named ? 2 : 1;
+        }
+        else if (strcmp(command, "on") == 0 || strcmp(command, "off") == 0)
+        {
+            MessageSchema::TurnOnOffMessage message = {};
+            message.on = strcmp(command, "on") == 0;
+            client.queue(message);
+        }
+        else if (strcmp(command, "status") == 0)
+        {
+            queryStatus = true;
+        }
+        else
+        {
+            fprintf(stderr, "unknown command or missing arguments: %s\n", command);
+            return 2;
+        }
+    }
+
+    // The query goes last, after all changes. It is about the whole light, not a segment.
+    if (queryStatus)
+    {
+        client.setSegment(0);
+        client.queue(MessageSchema::StatusQueryMessage{});
+    }
+    client.flush();
+
+    if (queryStatus)
+    {
+        MessageSchema::StatusReply reply;
+        if (!client.receive(reply, 1000))
+        {
+            fprintf(stderr, "no status received\n");
+            return 1;
+        }
+        printStatus(reply);
+    }
+    return 0;
+}
@@ -0,0 +1,97 @@
+// Host side check and benchmark of the parallel CarLight pixel loop (main/animation/parallel/ParallelFor.h).
+//
+// Build: g++ -std=gnu++20 -O2 -Imain tools/parallel_render.cpp main/animation/CarLight.cpp main/animation/effects/Effect.cpp main/animation/parallel/ParallelFor.cpp main/animation/filters/*.cpp main/animation/colors/ColorConverter.cpp -pthread -o parallel_render
+//
+// Usage: parallel_render
+// Checks that the split covers every range exactly once, renders the same light serially and split across
+// two threads through on, blinker and brake animations, fails if any pixel differs and prints both render times.
+// The speedup needs two free cores on the host.
+
+#include "animation/CarLight.h"
+
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+
+namespace
+{
+
+const size_t PIXELS = 4000;
+const int STEPS = 500;
+
+bool checkSplit()
+{
+    const size_t counts[] = {0, 1, 7, 8, 9, 17, 255, 256, 2000, 2001};
+    const size_t aligns[] = {1, ParallelFor::ALIGN};
+    for (size_t count : counts)
+    {
+        for (size_t align : aligns)
+        {
+            size_t previousEnd = 0;
+            for (size_t part = 0; part < ParallelFor::PARTS; ++part)
+            {
+                size_t begin, end;
+                ParallelFor::split(count, ParallelFor::PARTS, part, align, begin, end);
+                if (begin != previousEnd || end < begin || (part + 1 < ParallelFor::PARTS && end % align != 0))
+                {
+                    fprintf(stderr, "split of %zu items (align %zu) is wrong in part %zu: [%zu, %zu)\n", count, align, part, begin, end);
+                    return false;
+                }
+                previousEnd = end;
+            }
+            if (previousEnd != count)
+            {
+                fprintf(stderr, "split of %zu items (align %zu) ends at %zu\n", count, align, previousEnd);
+                return false;
+            }
+        }
+    }
+    return true;
+}
+
+} // namespace
+
+int main()
+{
+    if (!checkSplit())
+    {
+        return 1;
+    }
+
+    const ColorConverter::rgbcct color(ColorConverter::rgb(1, 0.2, 0), 0.2, 0.3);
+    static CarLight<PIXELS> serial(0.02, color);
+    static CarLight<PIXELS> parallel(0.02, color);
+    ParallelFor parallelFor(1, 1);
+    parallel.setParallel(&parallelFor);
+
+    CarLightBase* lights[] = {&serial, &parallel};
+    double seconds[2] = {};
+    for (int step = 0; step < STEPS; ++step)
+    {
+        for (size_t l = 0; l < 2; ++l)
+        {
+            if (step == 0)
+            {
+                lights[l]->turnOn();
+                lights[l]->turnOnLeft();
+            }
+            if (step == STEPS / 2)
+            {
+                lights[l]->turnOnBrake();
+            }
+
+            const auto start = std::chrono::steady_clock::now();
+            lights[l]->step();
+            seconds[l] += std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+        }
+
+        if (memcmp(serial.getPixels(), parallel.getPixels(), PIXELS * sizeof(ColorConverter::rgbcct)) != 0)
+        {
+            fprintf(stderr, "parallel render differs from serial render in step %d\n", step);
+            return 1;
+        }
+    }
+
+    printf("%zu pixels: serial %.1f us/step, parallel %.1f us/step\n", PIXELS, seconds[0] / STEPS * 1e6, seconds[1] / STEPS * 1e6);
+    return 0;
+}
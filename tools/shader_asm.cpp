@@ -0,0 +1,292 @@
+// Host side assembler and benchmark for PixelShader programs (main/animation/shader/PixelShader.h).
+//
+// Build: g++ -std=gnu++20 -O2 -Imain tools/shader_asm.cpp main/animation/shader/PixelShader.cpp main/animation/colors/ColorConverter.cpp -o shader_asm
+//
+// Usage: shader_asm [--hex] [--bench PIXELS] < program.asm > program.bin
+//   --hex          Print the program as hex instead of writing raw bytes
+//   --bench PIXELS Run the program on PIXELS pixels in both modes and print the throughput instead.
+//                  Fails if the two modes compute different pixels.
+//
+// Assembly syntax, one instruction per line, ';' starts a comment:
+//   <opcode> <dst> [<a> [<b>]]
+// Opcodes are the names of PixelShader::Opcode in lower case. Operands are registers (r0 - r15 or the input names
+// index, position, time, red, green, blue, warm, cold, brightness) or number literals, which become constants.
+// Example (moving sine wave over the strip):
+//   mul r9 position 3       ; three waves over the strip
+//   add r9 r9 time
+//   sin r9 r9
+//   mul r9 r9 0.5
+//   add r9 r9 0.5
+//   mul red red r9
+
+#include "animation/shader/PixelShader.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <vector>
+
+namespace
+{
+
+const char* OPCODE_NAMES[PixelShader::OPCODE_COUNT] =
+{
+    "end", "mov", "add", "sub", "mul", "div", "min", "max", "mad", "mix", "fract", "abs", "sin", "step"
+};
+
+const char* REGISTER_NAMES[] =
+{
+    "index", "position", "time", "red", "green", "blue", "warm", "cold", "brightness"
+};
+
+struct Assembler
+{
+    std::vector<float> constants;
+    std::vector<PixelShader::Instruction> instructions;
+
+    bool operand(const std::string& token, uint8_t& out)
+    {
+        for (size_t i = 0; i < sizeof(REGISTER_NAMES) / sizeof(REGISTER_NAMES[0]); ++i)
+        {
+            if (token == REGISTER_NAMES[i])
+            {
+                out = i;
+                return true;
+            }
+        }
+
+        if (token.size() > 1 && (token[0] == 'r' || token[0] == 'R'))
+        {
+            char* end = nullptr;
+            long index = strtol(token.c_str() + 1, &end, 10);
+            if (*end == '\0' && index >= 0 && index < PixelShader::REGISTER_COUNT)
+            {
+                out = index;
+                return true;
+            }
+        }
+
+        char* end = nullptr;
+        float value = strtof(token.c_str(), &end);
+        if (end == token.c_str() || *end != '\0')
+        {
+            return false;
+        }
+
+        for (size_t k = 0; k < constants.size(); ++k)
+        {
+            if (constants[k] == value)
+            {
+                out = PixelShader::REGISTER_COUNT + k;
+                return true;
+            }
+        }
+        if (constants.size() >= PixelShader::MAX_CONSTANTS)
+        {
+            return false;
+        }
+        constants.push_back(value);
+        out = PixelShader::REGISTER_COUNT + constants.size() - 1;
+        return true;
+    }
+
+    bool line(const std::string& text, int lineNumber)
+    {
+        std::istringstream stream(text.substr(0, text.find(';')));
+        std::string mnemonic;
+        if (!(stream >> mnemonic))
+        {
+            return true;
+        }
+
+        PixelShader::Instruction instruction = {};
+        bool found = false;
+        for (size_t op = 0; op < PixelShader::OPCODE_COUNT; ++op)
+        {
+            if (mnemonic == OPCODE_NAMES[op])
+            {
+                instruction.opcode = op;
+                found = true;
+            }
+        }
+        if (!found)
+        {
+            fprintf(stderr, "line %d: unknown opcode '%s'\n", lineNumber, mnemonic.c_str());
+            return false;
+        }
+
+        uint8_t* operands[] = {&instruction.dst, &instruction.a, &instruction.b};
+        std::string token;
+        for (size_t i = 0; i < 3 && stream >> token; ++i)
+        {
+            if (!operand(token, *operands[i]) || (i == 0 && *operands[i] >= PixelShader::REGISTER_COUNT))
+            {
+                fprintf(stderr, "line %d: invalid operand '%s'\n", lineNumber, token.c_str());
+                return false;
+            }
+        }
+
+        if (instruction.opcode != PixelShader::END)
+        {
+            instructions.push_back(instruction);
+        }
+        return true;
+    }
+
+    std::vector<uint8_t> binary() const
+    {
+        std::vector<uint8_t> out;
+        out.push_back(constants.size());
+        const uint8_t* constantBytes = reinterpret_cast<const uint8_t*>(constants.data());
+        out.insert(out.end(), constantBytes, constantBytes + constants.size() * sizeof(float));
+        out.push_back(instructions.size());
+        for (const PixelShader::Instruction& instruction : instructions)
+        {
+            out.push_back(instruction.opcode);
+            out.push_back(instruction.dst);
+            out.push_back(instruction.a);
+            out.push_back(instruction.b);
+        }
+        return out;
+    }
+};
+
+/// Runs a few frames of the program in both modes on the same input
+/// @return largest difference of a pixel value between the modes
+float compareModes(const std::vector<uint8_t>& program, size_t pixels)
+{
+    static PixelShader shader;
+    std::vector<ColorConverter::rgbcct> results[2];
+
+    for (int batched = 0; batched < 2; ++batched)
+    {
+        std::vector<ColorConverter::rgbcct>& colors = results[batched];
+        for (size_t i = 0; i < pixels; ++i)
+        {
+            float x = float(i) / pixels;
+            colors.push_back(ColorConverter::rgbcct(ColorConverter::rgb(x, 1 - x, 0.5), x * x, 0.3));
+        }
+
+        shader.load(program.data(), program.size());
+        for (int frame = 0; frame < 3; ++frame)
+        {
+            shader.run(colors.data(), pixels, 0.02, 0.8f, batched);
+        }
+    }
+
+    float difference = 0;
+    for (size_t i = 0; i < pixels; ++i)
+    {
+        const ColorConverter::rgbcct& a = results[0][i];
+        const ColorConverter::rgbcct& b = results[1][i];
+        difference = std::max({difference, fabsf(a.color.r - b.color.r), fabsf(a.color.g - b.color.g),
+                               fabsf(a.color.b - b.color.b), fabsf(a.ww - b.ww), fabsf(a.cw - b.cw)});
+    }
+    return difference;
+}
+
+/// @return false if the modes compute different pixels
+bool benchmark(const std::vector<uint8_t>& program, size_t pixels)
+{
+    const float difference = compareModes(program, pixels);
+    if (difference != 0)
+    {
+        fprintf(stderr, "pixel by pixel and batched mode differ by up to %g\n", difference);
+        return false;
+    }
+
+    static PixelShader shader;
+    std::vector<ColorConverter::rgbcct> colors(pixels, ColorConverter::rgbcct(ColorConverter::rgb(0.5, 0.2, 0.8), 0.1, 0.3));
+
+    for (int batched = 0; batched < 2; ++batched)
+    {
+        shader.load(program.data(), program.size());
+        shader.run(colors.data(), pixels, 0, 1.0f, batched);
+
+        const int RUNS = 2000;
+        auto start = std::chrono::steady_clock::now();
+        for (int run = 0; run < RUNS; ++run)
+        {
+            shader.run(colors.data(), pixels, 0.02, 1.0f, batched);
+        }
+        double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+        printf("%-16s %8.2f Mpixels/s\n", batched ? "batched" : "pixel by pixel", RUNS * pixels / seconds / 1e6);
+    }
+    return true;
+}
+
+} // namespace
+
+int main(int argc, char** argv)
+{
+    bool hex = false;
+    size_t benchPixels = 0;
+    for (int i = 1; i < argc; ++i)
+    {
+        if (strcmp(argv[i], "--hex") == 0)
+        {
+            hex = true;
+        }
+        else if (strcmp(argv[i], "--bench") == 0 && i + 1 < argc)
+        {
+            benchPixels = strtoul(argv[++i], nullptr, 10);
+        }
+        else
+        {
+            fprintf(stderr, "usage: %s [--hex] [--bench PIXELS] < program.asm\n", argv[0]);
+            return 2;
+        }
+    }
+
+    Assembler assembler;
+    std::string text;
+    for (int lineNumber = 1; std::getline(std::cin, text); ++lineNumber)
+    {
+        if (!assembler.line(text, lineNumber))
+        {
+            return 1;
+        }
+    }
+    if (assembler.instructions.size() > PixelShader::MAX_INSTRUCTIONS)
+    {
+        fprintf(stderr, "program has %zu instructions, maximum is %zu\n", assembler.instructions.size(), PixelShader::MAX_INSTRUCTIONS);
+        return 1;
+    }
+
+    std::vector<uint8_t> program = assembler.binary();
+    PixelShader::Program check;
+    if (!PixelShader::parse(program.data(), program.size(), check))
+    {
+        fprintf(stderr, "assembled program does not validate\n");
+        return 1;
+    }
+
+    if (benchPixels > 0)
+    {
+        if (!benchmark(program, benchPixels))
+        {
+            return 1;
+        }
+    }
+    else if (hex)
+    {
+        for (uint8_t byte : program)
+        {
+            printf("%02x", byte);
+        }
+        printf("\n");
+    }
+    else
+    {
+        fwrite(program.data(), 1, program.size(), stdout);
+    }
+
+    return 0;
+}
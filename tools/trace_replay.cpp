@@ -0,0 +1,331 @@
+// Fetches, synthesizes and replays traces of received messages (main/connect/TraceRecorder.h).
+//
+// Build: g++ -std=gnu++20 -O2 -Imain -Itools/host tools/trace_replay.cpp main/connect/{LEDProtocol,FrameStream,FrameCodec,LatencyProbe,LightStatus,NodeAddress,TraceRecorder}.cpp
+//            main/animation/{CarLight,SegmentedLight,effects/Effect,timeline/Timeline,shader/PixelShader,clip/ClipPlayer,parallel/ParallelFor}.cpp
+//            main/animation/colors/{ColorConverter,LightTable,Palette}.cpp main/animation/filters/*.cpp -pthread -o trace_replay
+// Add -DTRACE_LEDS=N if the light does not have the 20 LEDs of main.cpp.
+//
+// Usage:
+//   trace_replay fetch HOST [PORT]          > trace.bin   Dumps the trace of a light (port 8002 by default)
+//   trace_replay synth FRAMES [SEED]        > trace.bin   Random color, brightness, temperature and on/off commands
+//   trace_replay replay trace.bin [FRAMES]  > hashes.txt  One line per frame: index and FNV-1a hash of the output
+//
+// replay runs every message through LEDProtocol::parse before the frame it arrived in and renders the frame like
+// the rendered path of main.cpp (timeline, CarLight, shader, LightTable) at 50 Hz. The hash covers the 8 bit output
+// values of all LEDs before dithering. It keeps rendering FRAMES frames (default: until the last message plus 2 s).
+// Replay starts from the boot defaults of main.cpp, so record from boot (RECORD_TRACE) for an exact reproduction.
+// Diff the hashes against a golden file for regression tests. Throughput numbers go to stderr.
+
+#include "animation/IndexedFrame.h"
+#include "animation/SegmentedLight.h"
+#include "animation/colors/LightTable.h"
+#include "animation/colors/Palette.h"
+#include "animation/shader/PixelShader.h"
+#include "animation/timeline/Timeline.h"
+#include "connect/LEDProtocol.h"
+#include "connect/MessageSchema.h"
+#include "connect/TraceRecorder.h"
+
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <random>
+#include <vector>
+
+#ifndef TRACE_LEDS
+#define TRACE_LEDS 20
+#endif
+
+namespace
+{
+
+const size_t LEDS = TRACE_LEDS;
+const double PERIOD = 1 / 50.0; // main.cpp FREQUENCY
+const uint16_t DEFAULT_PORT = 8002;
+constexpr LightSegment SEGMENTS[] = {{0, LEDS}};
+
+struct Record
+{
+    uint32_t frame;
+    std::vector<uint8_t> message;
+};
+
+std::vector<uint8_t> readAll(FILE* file)
+{
+    std::vector<uint8_t> data;
+    uint8_t buffer[4096];
+    size_t read;
+    while ((read = fread(buffer, 1, sizeof(buffer), file)) > 0)
+    {
+        data.insert(data.end(), buffer, buffer + read);
+    }
+    return data;
+}
+
+bool parseTrace(const std::vector<uint8_t>& data, std::vector<Record>& records)
+{
+    size_t offset = 0;
+    while (offset < data.size())
+    {
+        if (data.size() - offset < TraceRecorderBase::RECORD_HEADER_SIZE)
+        {
+            return false;
+        }
+        Record record;
+        uint16_t size;
+        memcpy(&record.frame, &data[offset], sizeof(uint32_t));
+        memcpy(&size, &data[offset + sizeof(uint32_t)], sizeof(uint16_t));
+        offset += TraceRecorderBase::RECORD_HEADER_SIZE;
+        if (data.size() - offset < size)
+        {
+            return false;
+        }
+        record.message.assign(&data[offset], &data[offset] + size);
+        offset += size;
+        records.push_back(record);
+    }
+    return true;
+}
+
+void writeRecord(uint32_t frame, const std::vector<uint8_t>& message)
+{
+    const uint16_t size = message.size();
+    fwrite(&frame, sizeof(frame), 1, stdout);
+    fwrite(&size, sizeof(size), 1, stdout);
+    fwrite(message.data(), 1, message.size(), stdout);
+}
+
+template <typename Message>
+std::vector<uint8_t> encode(const Message& message)
+{
+    std::vector<uint8_t> buffer(message.getSize());
+    message.encode(buffer.data(), buffer.size());
+    return buffer;
+}
+
+int fetch(const char* host, uint16_t port)
+{
+    sockaddr_in target = {};
+    target.sin_family = AF_INET;
+    target.sin_port = htons(port);
+    if (inet_pton(AF_INET, host, &target.sin_addr) != 1)
+    {
+        fprintf(stderr, "HOST must be an IPv4 address\n");
+        return 2;
+    }
+
+    const int sock = socket(AF_INET, SOCK_DGRAM, 0);
+    timeval timeout = {1, 0};
+    setsockopt(sock, SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof(timeout));
+
+    MessageSchema::TraceMessage dump = {};
+    dump.command = TraceRecorderBase::DUMP;
+    const std::vector<uint8_t> request = encode(dump);
+    sendto(sock, request.data(), request.size(), 0, reinterpret_cast<sockaddr*>(&target), sizeof(target));
+
+    std::vector<std::vector<uint8_t>> chunks;
+    std::vector<bool> received;
+    size_t missing = 1;
+    uint8_t buffer[sizeof(uint32_t) + MessageSchema::TraceChunkReply::FIXED_SIZE + TraceRecorderBase::DUMP_CHUNK];
+    ssize_t size;
+    while (missing > 0 && (size = recv(sock, buffer, sizeof(buffer), 0)) >= static_cast<ssize_t>(sizeof(uint32_t)))
+    {
+        uint32_t messageId;
+        memcpy(&messageId, buffer, sizeof(uint32_t));
+        MessageSchema::TraceChunkReply reply;
+        if (messageId != MessageSchema::TraceChunkReply::ID || !reply.decode(&buffer[sizeof(uint32_t)], size - sizeof(uint32_t)) ||
+            reply.chunk >= reply.chunkCount)
+        {
+            continue;
+        }
+        if (chunks.empty())
+        {
+            chunks.resize(reply.chunkCount);
+            received.resize(reply.chunkCount, false);
+            missing = reply.chunkCount;
+        }
+        if (reply.chunk < chunks.size() && !received[reply.chunk])
+        {
+            chunks[reply.chunk].assign(reply.data, reply.data + reply.dataSize);
+            received[reply.chunk] = true;
+            --missing;
+        }
+    }
+    close(sock);
+
+    if (chunks.empty() || missing > 0)
+    {
+        fprintf(stderr, "%zu of %zu chunks missing, try again\n", chunks.empty() ? 1 : missing, chunks.empty() ? 1 : chunks.size());
+        return 1;
+    }
+
+    size_t total = 0;
+    for (const std::vector<uint8_t>& chunk : chunks)
+    {
+        fwrite(chunk.data(), 1, chunk.size(), stdout);
+        total += chunk.size();
+    }
+    fprintf(stderr, "%zu bytes in %zu chunks\n", total, chunks.size());
+    return 0;
+}
+
+int synth(uint32_t frames, unsigned seed)
+{
+    std::mt19937 random(seed);
+    std::uniform_real_distribution<double> unit(0, 1);
+
+    for (uint32_t frame = 0; frame < frames; ++frame)
+    {
+        // About one command every 5 frames, sometimes several in the same frame
+        while (unit(random) < 0.2)
+        {
+            const double kind = unit(random);
+            if (kind < 0.35)
+            {
+                MessageSchema::ColorMessage message = {};
+                message.red = unit(random) * 0xFFFF;
+                message.green = unit(random) * 0xFFFF;
+                message.blue = unit(random) * 0xFFFF;
+                writeRecord(frame, encode(message));
+            }
+            else if (kind < 0.6)
+            {
+                MessageSchema::DimMessage message = {};
+                message.dim = unit(random) * 0xFFFF;
+                writeRecord(frame, encode(message));
+            }
+            else if (kind < 0.75)
+            {
+                MessageSchema::WhiteDimMessage message = {};
+                message.dim = unit(random) * 0xFFFF;
+                writeRecord(frame, encode(message));
+            }
+            else if (kind < 0.9)
+            {
+                MessageSchema::WhiteTemperatureMessage message = {};
+                message.temperature = ColorConverter::WARM_TEMPERATURE + unit(random) * (ColorConverter::COLD_TEMPERATURE - ColorConverter::WARM_TEMPERATURE);
+                writeRecord(frame, encode(message));
+            }
+            else
+            {
+                MessageSchema::TurnOnOffMessage message = {};
+                message.on = unit(random) < 0.7;
+                writeRecord(frame, encode(message));
+            }
+        }
+    }
+    return 0;
+}
+
+uint64_t fnv1a(uint64_t hash, const void* data, size_t size)
+{
+    const uint8_t* bytes = static_cast<const uint8_t*>(data);
+    for (size_t i = 0; i < size; ++i)
+    {
+        hash = (hash ^ bytes[i]) * 0x100000001B3ULL;
+    }
+    return hash;
+}
+
+int replay(const char* path, uint32_t frames)
+{
+    FILE* file = fopen(path, "rb");
+    if (!file)
+    {
+        fprintf(stderr, "cannot open %s\n", path);
+        return 2;
+    }
+    std::vector<Record> records;
+    const bool valid = parseTrace(readAll(file), records);
+    fclose(file);
+    if (!valid)
+    {
+        fprintf(stderr, "%s is truncated, replaying %zu complete records\n", path, records.size());
+    }
+
+    if (frames == 0)
+    {
+        frames = (records.empty() ? 0 : records.back().frame) + 2 / PERIOD;
+    }
+
+    // Same setup as main.cpp
+    ColorConverter::hsvcct color(ColorConverter::hsv(0, 0, 0), 4000, 1);
+    static SegmentedLight<LEDS, SEGMENTS> light(PERIOD, ColorConverter::hsv2rgb(color));
+    static Timeline timeline;
+    static PixelShader shader;
+    static Palette palette;
+    static IndexedFrame<1> indexedFrame;
+    static LightTable lightTable;
+    LEDProtocol protocol(&light.getSegment(0), &timeline, &shader, &palette, &indexedFrame);
+    protocol.setSegments(light.getSegments(), light.getSegmentCount());
+    bool shaded = false;
+
+    typedef std::chrono::steady_clock Clock;
+    Clock::duration parseTime = Clock::duration::zero();
+    Clock::duration renderTime = Clock::duration::zero();
+
+    size_t next = 0;
+    for (uint32_t frame = 0; frame < frames; ++frame)
+    {
+        const Clock::time_point parseStart = Clock::now();
+        for (; next < records.size() && records[next].frame <= frame; ++next)
+        {
+            protocol.parse(records[next].message.data(), records[next].message.size());
+        }
+
+        const Clock::time_point renderStart = Clock::now();
+        timeline.step(PERIOD, light.getSegments(), light.getSegmentCount());
+        light.step(!shaded && !shader.isActive());
+        ColorConverter::rgbcct* colors = light.getPixels();
+        shader.run(colors, LEDS, PERIOD, light.getSegment(0).getColorBrightness());
+        shaded = shader.isActive();
+
+        uint64_t hash = 0xCBF29CE484222325ULL;
+        for (size_t i = 0; i < LEDS; ++i)
+        {
+            const uint64_t value = lightTable.to8BitWWBRG(colors[i]);
+            hash = fnv1a(hash, &value, 5);
+        }
+        const Clock::time_point renderEnd = Clock::now();
+
+        parseTime += renderStart - parseStart;
+        renderTime += renderEnd - renderStart;
+        printf("%u %016llx\n", frame, static_cast<unsigned long long>(hash));
+    }
+
+    const double parseSeconds = std::chrono::duration<double>(parseTime).count();
+    const double renderSeconds = std::chrono::duration<double>(renderTime).count();
+    fprintf(stderr, "%u frames of %zu LEDs, %zu messages\n", frames, LEDS, next);
+    fprintf(stderr, "parse  %8.3f ms total, %8.2f us per message\n", parseSeconds * 1000, next ? parseSeconds * 1e6 / next : 0.0);
+    fprintf(stderr, "render %8.3f ms total, %8.2f us per frame, %.0f frames/s (%.1fx real time)\n", renderSeconds * 1000,
+            frames ? renderSeconds * 1e6 / frames : 0.0, frames / (parseSeconds + renderSeconds),
+            frames * PERIOD / (parseSeconds + renderSeconds));
+    return 0;
+}
+
+} // namespace
+
+int main(int argc, char** argv)
+{
+    if (argc >= 3 && strcmp(argv[1], "fetch") == 0)
+    {
+        return fetch(argv[2], argc > 3 ? atoi(argv[3]) : DEFAULT_PORT);
+    }
+    if (argc >= 3 && strcmp(argv[1], "synth") == 0)
+    {
+        return synth(strtoul(argv[2], nullptr, 10), argc > 3 ? strtoul(argv[3], nullptr, 10) : 1);
+    }
+    if (argc >= 3 && strcmp(argv[1], "replay") == 0)
+    {
+        return replay(argv[2], argc > 3 ? strtoul(argv[3], nullptr, 10) : 0);
+    }
+
+    fprintf(stderr, "usage: %s fetch HOST [PORT] | synth FRAMES [SEED] | replay TRACE [FRAMES]\n", argv[0]);
+    return 2;
+}